@@ -0,0 +1,50 @@
+#include "alloc_stats.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+static std::atomic<uint64_t> s_AllocCount = 0;
+static std::atomic<uint64_t> s_AllocBytes = 0;
+
+AllocStats AllocStatsGet()
+{
+	AllocStats stats;
+	stats.count = s_AllocCount.load(std::memory_order_relaxed);
+	stats.bytes = s_AllocBytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void* AllocStatsMalloc(size_t size)
+{
+	s_AllocCount.fetch_add(1, std::memory_order_relaxed);
+	s_AllocBytes.fetch_add(size, std::memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+void AllocStatsFree(void* ptr)
+{
+	free(ptr);
+}
+
+// Replacements of the global (non-aligned) operator new & delete; array and nothrow
+// forms go through these by default
+void* operator new(size_t size)
+{
+	s_AllocCount.fetch_add(1, std::memory_order_relaxed);
+	s_AllocBytes.fetch_add(size, std::memory_order_relaxed);
+	void* ptr = malloc(size ? size : 1);
+	if (ptr == nullptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Counts of heap allocations made through operator new and AllocStatsMalloc (on all threads), e.g.
+// to check that a code path does not allocate. Libraries are included when they allocate through
+// AllocStatsMalloc (zstd contexts of compression_helpers); plain malloc calls are not.
+struct AllocStats
+{
+	uint64_t count = 0;
+	uint64_t bytes = 0;
+};
+
+AllocStats AllocStatsGet();
+void* AllocStatsMalloc(size_t size);
+void AllocStatsFree(void* ptr);
@@ -0,0 +1,220 @@
+#include "bench_report.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+BenchStats BenchCalcStats(const std::vector<double>& samples)
+{
+	BenchStats stats;
+	const size_t count = samples.size();
+	if (count == 0)
+		return stats;
+	std::vector<double> sorted = samples;
+	std::sort(sorted.begin(), sorted.end());
+	stats.min = sorted[0];
+	stats.median = (count & 1) ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) * 0.5;
+	if (count > 1)
+	{
+		double mean = 0;
+		for (double v : sorted)
+			mean += v;
+		mean /= count;
+		double sumSq = 0;
+		for (double v : sorted)
+			sumSq += (v - mean) * (v - mean);
+		stats.stddev = sqrt(sumSq / (count - 1));
+	}
+	return stats;
+}
+
+static void WriteJsonString(FILE* f, const std::string& str)
+{
+	fputc('"', f);
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if ((unsigned char)c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+static void WriteJsonStats(FILE* f, const char* name, const BenchStats& stats)
+{
+	fprintf(f, "\"%s\": {\"median\": %.6f, \"min\": %.6f, \"stddev\": %.6f}", name, stats.median, stats.min, stats.stddev);
+}
+
+static void WriteJsonCounters(FILE* f, const char* name, const SysInfoPerfCounters& counters)
+{
+	fprintf(f, "\"%s\": {\"cycles\": %llu, \"instructions\": %llu, \"cacheMisses\": %llu, \"branchMisses\": %llu}", name,
+		(unsigned long long)counters.cycles, (unsigned long long)counters.instructions, (unsigned long long)counters.cacheMisses, (unsigned long long)counters.branchMisses);
+}
+
+// speeds are in GB/s of compressor input, based on median time
+static double CalcSpeed(size_t size, double time)
+{
+	return time > 0 ? size / time / (1024.0 * 1024.0 * 1024.0) : 0;
+}
+
+bool BenchWriteJson(const char* path, const BenchRunInfo& info, const std::vector<BenchResult>& results)
+{
+	FILE* f = fopen(path, "wb");
+	if (f == nullptr)
+	{
+		printf("ERROR: failed to write results to %s\n", path);
+		return false;
+	}
+	fprintf(f, "{\n  \"cpu\": ");
+	WriteJsonString(f, info.cpu);
+	fprintf(f, ",\n  \"compiler\": ");
+	WriteJsonString(f, info.compiler);
+	const SysInfoCpuDetails& cpu = info.cpuDetails;
+	fprintf(f, ",\n  \"cpuCores\": %i, \"cpuThreads\": %i, \"cacheL1D\": %zu, \"cacheL2\": %zu, \"cacheL3\": %zu", cpu.coreCount, cpu.threadCount, cpu.cacheL1D, cpu.cacheL2, cpu.cacheL3);
+	fprintf(f, ",\n  \"runs\": %i,\n  \"files\": [", info.runs);
+	for (size_t i = 0; i < info.files.size(); ++i)
+	{
+		if (i != 0)
+			fprintf(f, ", ");
+		WriteJsonString(f, info.files[i]);
+	}
+	fprintf(f, "],\n  \"results\": [\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchResult& res = results[i];
+		const BenchStats cmpStats = BenchCalcStats(res.cmpTimes);
+		const BenchStats decStats = BenchCalcStats(res.decTimes);
+		fprintf(f, "    {\"order\": ");
+		WriteJsonString(f, res.order);
+		fprintf(f, ", \"profile\": ");
+		WriteJsonString(f, res.profile);
+		fprintf(f, ", \"name\": ");
+		WriteJsonString(f, res.name);
+		fprintf(f, ", \"codec\": ");
+		WriteJsonString(f, res.codec);
+		fprintf(f, ", \"filter\": ");
+		WriteJsonString(f, res.filter);
+		fprintf(f, ", \"blockSize\": %zu, \"threads\": %i, \"level\": %i,\n", res.blockSize, res.threads, res.level);
+		fprintf(f, "     \"fullSize\": %zu, \"packedSize\": %zu, \"compressedSize\": %zu, \"ratio\": %.4f,\n", res.fullSize, res.packedSize, res.compressedSize,
+			res.compressedSize ? double(res.packedSize) / res.compressedSize : 0.0);
+		fprintf(f, "     ");
+		WriteJsonStats(f, "compressTime", cmpStats);
+		fprintf(f, ", ");
+		WriteJsonStats(f, "decompressTime", decStats);
+		fprintf(f, ",\n     \"compressGBs\": %.4f, \"decompressGBs\": %.4f", CalcSpeed(res.packedSize, cmpStats.median), CalcSpeed(res.packedSize, decStats.median));
+		fprintf(f, ", \"decompressAllocs\": %.1f, \"decompressAllocBytes\": %.0f", res.decAllocs, res.decAllocBytes);
+		if (!res.fusedTimes.empty())
+		{
+			// fused decode speed is of the unpacked data it writes
+			const BenchStats fusedStats = BenchCalcStats(res.fusedTimes);
+			fprintf(f, ",\n     ");
+			WriteJsonStats(f, "fusedDecodeTime", fusedStats);
+			fprintf(f, ", \"fusedDecodeGBs\": %.4f", CalcSpeed(res.fullSize, fusedStats.median));
+			const BenchStats separateStats = BenchCalcStats(res.separateTimes);
+			fprintf(f, ",\n     ");
+			WriteJsonStats(f, "separateDecodeTime", separateStats);
+			fprintf(f, ", \"separateDecodeGBs\": %.4f", CalcSpeed(res.fullSize, separateStats.median));
+		}
+		if (res.hasCounters)
+		{
+			fprintf(f, ",\n     ");
+			WriteJsonCounters(f, "compressCounters", res.cmpCounters);
+			fprintf(f, ", ");
+			WriteJsonCounters(f, "decompressCounters", res.decCounters);
+		}
+		if (res.tuned)
+		{
+			fprintf(f, ",\n     \"file\": ");
+			WriteJsonString(f, res.file);
+			fprintf(f, ", \"pareto\": %s, \"chosen\": %s", res.pareto ? "true" : "false", res.chosen ? "true" : "false");
+		}
+		fprintf(f, "}%s\n", i + 1 < results.size() ? "," : "");
+	}
+	fprintf(f, "  ]\n}\n");
+	const bool ok = ferror(f) == 0;
+	fclose(f);
+	if (!ok)
+		printf("ERROR: failed to write results to %s\n", path);
+	return ok;
+}
+
+// quoted only when needed
+static void WriteCsvString(FILE* f, const std::string& str)
+{
+	if (str.find_first_of(",\"\n") == std::string::npos)
+	{
+		fprintf(f, "%s,", str.c_str());
+		return;
+	}
+	fputc('"', f);
+	for (char c : str)
+	{
+		if (c == '"')
+			fputc('"', f);
+		fputc(c, f);
+	}
+	fprintf(f, "\",");
+}
+
+bool BenchWriteCsv(const char* path, const std::vector<BenchResult>& results)
+{
+	FILE* f = fopen(path, "wb");
+	if (f == nullptr)
+	{
+		printf("ERROR: failed to write results to %s\n", path);
+		return false;
+	}
+	fprintf(f, "order,profile,name,codec,filter,block_size,threads,level,full_size,packed_size,compressed_size,ratio,"
+		"ctime_median,ctime_min,ctime_stddev,dtime_median,dtime_min,dtime_stddev,cspeed_gbs,dspeed_gbs,"
+		"c_cycles,c_instructions,c_cache_misses,c_branch_misses,d_cycles,d_instructions,d_cache_misses,d_branch_misses,file,pareto,chosen,d_allocs,d_alloc_bytes,ftime_median,ftime_min,ftime_stddev,fspeed_gbs,stime_median,stime_min,stime_stddev,sspeed_gbs\n");
+	for (const BenchResult& res : results)
+	{
+		const BenchStats cmpStats = BenchCalcStats(res.cmpTimes);
+		const BenchStats decStats = BenchCalcStats(res.decTimes);
+		WriteCsvString(f, res.order);
+		WriteCsvString(f, res.profile);
+		WriteCsvString(f, res.name);
+		WriteCsvString(f, res.codec);
+		WriteCsvString(f, res.filter);
+		fprintf(f, "%zu,%i,%i,%zu,%zu,%zu,%.4f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.4f,%.4f",
+			res.blockSize, res.threads, res.level, res.fullSize, res.packedSize, res.compressedSize,
+			res.compressedSize ? double(res.packedSize) / res.compressedSize : 0.0,
+			cmpStats.median, cmpStats.min, cmpStats.stddev, decStats.median, decStats.min, decStats.stddev,
+			CalcSpeed(res.packedSize, cmpStats.median), CalcSpeed(res.packedSize, decStats.median));
+		// counter columns are empty when not recorded
+		for (const SysInfoPerfCounters* pc : { &res.cmpCounters, &res.decCounters })
+		{
+			if (res.hasCounters)
+				fprintf(f, ",%llu,%llu,%llu,%llu", (unsigned long long)pc->cycles, (unsigned long long)pc->instructions, (unsigned long long)pc->cacheMisses, (unsigned long long)pc->branchMisses);
+			else
+				fprintf(f, ",,,,");
+		}
+		// as are auto-tune columns when not tuning
+		fprintf(f, ",");
+		if (res.tuned)
+		{
+			WriteCsvString(f, res.file);
+			fprintf(f, "%i,%i", res.pareto, res.chosen);
+		}
+		else
+			fprintf(f, ",,");
+		fprintf(f, ",%.1f,%.0f", res.decAllocs, res.decAllocBytes);
+		if (!res.fusedTimes.empty())
+		{
+			const BenchStats fusedStats = BenchCalcStats(res.fusedTimes);
+			const BenchStats separateStats = BenchCalcStats(res.separateTimes);
+			fprintf(f, ",%.6f,%.6f,%.6f,%.4f", fusedStats.median, fusedStats.min, fusedStats.stddev, CalcSpeed(res.fullSize, fusedStats.median));
+			fprintf(f, ",%.6f,%.6f,%.6f,%.4f\n", separateStats.median, separateStats.min, separateStats.stddev, CalcSpeed(res.fullSize, separateStats.median));
+		}
+		else
+			fprintf(f, ",,,,,,,,\n");
+	}
+	const bool ok = ferror(f) == 0;
+	fclose(f);
+	if (!ok)
+		printf("ERROR: failed to write results to %s\n", path);
+	return ok;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "systeminfo.h"
+
+// Machine readable benchmark results (JSON / CSV), for diffing between runs.
+
+struct BenchStats
+{
+	double median = 0;
+	double min = 0;
+	double stddev = 0;
+};
+
+// Median, min and (sample) standard deviation of measurements
+BenchStats BenchCalcStats(const std::vector<double>& samples);
+
+// One compressor configuration at one level, on all test files
+struct BenchResult
+{
+	std::string order; // spatial order
+	std::string profile; // quantization profile
+	std::string name; // full configuration name, as in the printed table
+	std::string codec;
+	std::string filter;
+	size_t blockSize = 0; // 0: whole data is one block
+	int threads = 1;
+	int level = 0;
+	size_t fullSize = 0; // unpacked data size
+	size_t packedSize = 0; // compressor input size
+	size_t compressedSize = 0;
+	std::vector<double> cmpTimes; // seconds, each run
+	std::vector<double> decTimes;
+	bool hasCounters = false;
+	SysInfoPerfCounters cmpCounters; // sums over all runs
+	SysInfoPerfCounters decCounters;
+	double decAllocs = 0; // heap allocations per decode (average over files & runs)
+	double decAllocBytes = 0;
+	std::vector<double> fusedTimes; // fused decode into splats, each run; empty when not measured
+	std::vector<double> separateTimes; // decode into splats in separate passes, each run; measured along with fusedTimes
+
+	// Auto-tune mode measures each file on its own, on a sample of it
+	bool tuned = false;
+	std::string file;
+	bool pareto = false; // on the size vs decode speed Pareto frontier
+	bool chosen = false; // picked for the decode speed constraint
+};
+
+struct BenchRunInfo
+{
+	std::string cpu;
+	std::string compiler;
+	SysInfoCpuDetails cpuDetails;
+	std::vector<std::string> files;
+	int runs = 1;
+};
+
+bool BenchWriteJson(const char* path, const BenchRunInfo& info, const std::vector<BenchResult>& results);
+bool BenchWriteCsv(const char* path, const std::vector<BenchResult>& results);
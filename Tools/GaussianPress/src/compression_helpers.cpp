@@ -2,10 +2,15 @@
 
 #include <meshoptimizer.h>
 #include <string.h>
+#define ZSTD_STATIC_LINKING_ONLY // custom allocators
 #include <zstd.h>
+#include <zdict.h>
 #include <lz4.h>
 #include <lz4hc.h>
 #include <stdio.h>
+#include <algorithm>
+#include "rans.h"
+#include "alloc_stats.h"
 
 size_t compress_meshopt_vertex_attribute_bound(size_t vertexCount, size_t vertexSize)
 {
@@ -29,6 +34,7 @@ size_t compress_calc_bound(size_t srcSize, CompressionFormat format)
 	{
 	case kCompressionZstd: return ZSTD_compressBound(srcSize);
 	case kCompressionLZ4: return LZ4_compressBound(int(srcSize));
+	case kCompressionRans: return RansCompressBound(srcSize);
 	default: return 0;
 	}	
 }
@@ -36,24 +42,117 @@ size_t compress_data(const void* src, size_t srcSize, void* dst, size_t dstSize,
 {
 	if (srcSize == 0)
 		return 0;
+	size_t res = 0; // zero is an error for all of them, since there is input
 	switch (format)
 	{
-	case kCompressionZstd: return ZSTD_compress(dst, dstSize, src, srcSize, level);
+	case kCompressionZstd:
+		res = ZSTD_compress(dst, dstSize, src, srcSize, level);
+		return ZSTD_isError(res) ? kCompressionError : res;
 	case kCompressionLZ4:
 		if (level > 0)
-			return LZ4_compress_HC((const char*)src, (char*)dst, (int)srcSize, (int)dstSize, level);
-		return LZ4_compress_fast((const char*)src, (char*)dst, (int)srcSize, (int)dstSize, (level > 0 ? level : -level) * 10);
-	default: return 0;
+			res = std::max(LZ4_compress_HC((const char*)src, (char*)dst, (int)srcSize, (int)dstSize, level), 0);
+		else
+			res = std::max(LZ4_compress_fast((const char*)src, (char*)dst, (int)srcSize, (int)dstSize, (level > 0 ? level : -level) * 10), 0);
+		break;
+	case kCompressionRans: res = RansCompress((const uint8_t*)src, srcSize, (uint8_t*)dst, dstSize); break;
+	default: break;
 	}
+	return res != 0 ? res : kCompressionError;
 }
 size_t decompress_data(const void* src, size_t srcSize, void* dst, size_t dstSize, CompressionFormat format)
 {
 	if (srcSize == 0)
-		return 0;
+		return dstSize == 0 ? 0 : kCompressionError;
+	size_t res = 0;
 	switch (format)
 	{
-	case kCompressionZstd: return ZSTD_decompress(dst, dstSize, src, srcSize);
-	case kCompressionLZ4: return LZ4_decompress_safe((const char*)src, (char*)dst, (int)srcSize, (int)dstSize);
-	default: return 0;
-	}	
+	case kCompressionZstd:
+		res = ZSTD_decompress(dst, dstSize, src, srcSize);
+		return ZSTD_isError(res) ? kCompressionError : res;
+	case kCompressionLZ4:
+	{
+		const int size = LZ4_decompress_safe((const char*)src, (char*)dst, (int)srcSize, (int)dstSize);
+		return size >= 0 ? size_t(size) : kCompressionError;
+	}
+	case kCompressionRans:
+		res = RansDecompress((const uint8_t*)src, srcSize, (uint8_t*)dst, dstSize);
+		return res == dstSize ? res : kCompressionError;
+	default: return kCompressionError;
+	}
+}
+
+
+static void* ZstdAlloc(void*, size_t size)
+{
+	return AllocStatsMalloc(size);
+}
+static void ZstdFree(void*, void* ptr)
+{
+	AllocStatsFree(ptr);
+}
+static const ZSTD_customMem kZstdMem = { ZstdAlloc, ZstdFree, nullptr };
+
+ZSTD_CCtx_s* zstd_create_cctx()
+{
+	return ZSTD_createCCtx_advanced(kZstdMem);
+}
+ZSTD_DCtx_s* zstd_create_dctx()
+{
+	return ZSTD_createDCtx_advanced(kZstdMem);
+}
+void zstd_free_cctx(ZSTD_CCtx_s* cctx)
+{
+	ZSTD_freeCCtx(cctx);
+}
+void zstd_free_dctx(ZSTD_DCtx_s* dctx)
+{
+	ZSTD_freeDCtx(dctx);
+}
+
+size_t zstd_train_dictionary(const void* samples, const size_t* sampleSizes, size_t sampleCount, void* dict, size_t dictCapacity)
+{
+	size_t res = ZDICT_trainFromBuffer(dict, dictCapacity, samples, sampleSizes, unsigned(sampleCount));
+	return ZDICT_isError(res) ? 0 : res;
+}
+ZSTD_CDict_s* zstd_create_cdict(const void* dict, size_t dictSize, int level)
+{
+	// like ZSTD_createCDict, which has no custom allocator variant
+	ZSTD_CCtx_params* params = ZSTD_createCCtxParams();
+	ZSTD_CCtxParams_setParameter(params, ZSTD_c_compressionLevel, level);
+	ZSTD_CDict* cdict = ZSTD_createCDict_advanced2(dict, dictSize, ZSTD_dlm_byCopy, ZSTD_dct_auto, params, kZstdMem);
+	ZSTD_freeCCtxParams(params);
+	return cdict;
+}
+ZSTD_DDict_s* zstd_create_ddict(const void* dict, size_t dictSize)
+{
+	return ZSTD_createDDict_advanced(dict, dictSize, ZSTD_dlm_byCopy, ZSTD_dct_auto, kZstdMem);
+}
+void zstd_free_cdict(ZSTD_CDict_s* cdict)
+{
+	ZSTD_freeCDict(cdict);
+}
+void zstd_free_ddict(ZSTD_DDict_s* ddict)
+{
+	ZSTD_freeDDict(ddict);
+}
+
+size_t compress_zstd_ctx(ZSTD_CCtx_s* cctx, const void* src, size_t srcSize, void* dst, size_t dstSize, int level, int workerCount, const ZSTD_CDict_s* cdict)
+{
+	if (srcSize == 0)
+		return 0;
+	ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level); // cdict has its own level, that one wins
+	if (workerCount > 0 && ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, workerCount)))
+		return kCompressionError;
+	if (cdict)
+		ZSTD_CCtx_refCDict(cctx, cdict);
+	size_t res = ZSTD_compress2(cctx, dst, dstSize, src, srcSize);
+	return ZSTD_isError(res) ? kCompressionError : res;
+}
+size_t decompress_zstd_ctx(ZSTD_DCtx_s* dctx, const void* src, size_t srcSize, void* dst, size_t dstSize, const ZSTD_DDict_s* ddict)
+{
+	if (srcSize == 0)
+		return dstSize == 0 ? 0 : kCompressionError;
+	size_t res = ddict ? ZSTD_decompress_usingDDict(dctx, dst, dstSize, src, srcSize, ddict) : ZSTD_decompressDCtx(dctx, dst, dstSize, src, srcSize);
+	return ZSTD_isError(res) ? kCompressionError : res;
 }
@@ -13,8 +13,33 @@ enum CompressionFormat
 {
 	kCompressionZstd = 0,
 	kCompressionLZ4,
+	kCompressionRans, // in-house interleaved rANS, see rans.h
 	kCompressionCount
 };
+// compress_data & decompress_data return the output size, or kCompressionError when the codec
+// fails (e.g. corrupt data, or output that does not fit); zero sized input gives zero.
+const size_t kCompressionError = ~size_t(0);
 size_t compress_calc_bound(size_t srcSize, CompressionFormat format);
 size_t compress_data(const void* src, size_t srcSize, void* dst, size_t dstSize, CompressionFormat format, int level);
 size_t decompress_data(const void* src, size_t srcSize, void* dst, size_t dstSize, CompressionFormat format);
+
+// zstd with compression & decompression contexts that the caller owns and reuses between calls
+// (one per thread that runs at once), instead of the one-shot functions making new ones each time.
+// Optionally with a digested dictionary (cdict/ddict; can be null), and with workerCount > 0
+// compression runs on that many zstd worker threads. These return kCompressionError on failure. All their memory
+// comes from AllocStatsMalloc, so it shows up in AllocStats.
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+ZSTD_CCtx_s* zstd_create_cctx();
+ZSTD_DCtx_s* zstd_create_dctx();
+void zstd_free_cctx(ZSTD_CCtx_s* cctx);
+void zstd_free_dctx(ZSTD_DCtx_s* dctx);
+size_t zstd_train_dictionary(const void* samples, const size_t* sampleSizes, size_t sampleCount, void* dict, size_t dictCapacity);
+ZSTD_CDict_s* zstd_create_cdict(const void* dict, size_t dictSize, int level);
+ZSTD_DDict_s* zstd_create_ddict(const void* dict, size_t dictSize);
+void zstd_free_cdict(ZSTD_CDict_s* cdict);
+void zstd_free_ddict(ZSTD_DDict_s* ddict);
+size_t compress_zstd_ctx(ZSTD_CCtx_s* cctx, const void* src, size_t srcSize, void* dst, size_t dstSize, int level, int workerCount, const ZSTD_CDict_s* cdict);
+size_t decompress_zstd_ctx(ZSTD_DCtx_s* dctx, const void* src, size_t srcSize, void* dst, size_t dstSize, const ZSTD_DDict_s* ddict);
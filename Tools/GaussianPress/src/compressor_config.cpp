@@ -0,0 +1,304 @@
+#include "compressor_config.h"
+#include "filters.h"
+#include "parallel.h"
+#include "stream_split.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+FilterDesc g_FilterByteDelta = { "-bd", kContainerFilterByteDelta, Filter_ByteDelta, UnFilter_ByteDelta };
+FilterDesc g_FilterByteDelta16 = { "-bd16", kContainerFilterByteDelta, Filter_ByteDelta16, UnFilter_ByteDelta16 };
+FilterDesc g_FilterByteDelta32 = { "-bd32", kContainerFilterByteDelta, Filter_ByteDelta32, UnFilter_ByteDelta32 };
+FilterDesc g_FilterByteDelta64 = { "-bd64", kContainerFilterByteDelta, Filter_ByteDelta64, UnFilter_ByteDelta64 };
+FilterDesc g_FilterWordDelta = { "-wd", kContainerFilterWordDelta, Filter_WordDelta, UnFilter_WordDelta };
+FilterDesc g_FilterXorDelta = { "-xor", kContainerFilterXorDelta, Filter_XorDelta, UnFilter_XorDelta };
+FilterDesc g_FilterBitShuffle = { "-bshuf", kContainerFilterBitShuffle, Filter_BitShuffle, UnFilter_BitShuffle };
+FilterDesc g_FilterPredict = { "-pred", kContainerFilterPredict, Filter_Predict, UnFilter_Predict };
+FilterDesc g_FilterAuto = { "-auto", kContainerFilterAuto };
+// Filters the auto filter tries
+static FilterDesc* const g_AutoFilterCandidates[] = { nullptr, &g_FilterByteDelta, &g_FilterWordDelta, &g_FilterXorDelta, &g_FilterBitShuffle, &g_FilterPredict };
+
+FilterDesc* FindFilter(ContainerFilter id)
+{
+	switch (id)
+	{
+	case kContainerFilterByteDelta: return &g_FilterByteDelta;
+	case kContainerFilterWordDelta: return &g_FilterWordDelta;
+	case kContainerFilterXorDelta: return &g_FilterXorDelta;
+	case kContainerFilterBitShuffle: return &g_FilterBitShuffle;
+	case kContainerFilterPredict: return &g_FilterPredict;
+	case kContainerFilterAuto: return &g_FilterAuto;
+	default: return nullptr;
+	}
+}
+
+ContainerHeader CompressorConfig::MakeContainerHeader(int level, size_t elemCount, size_t elemStride, size_t blockElemCount, size_t boundsChunkElems) const
+{
+	ContainerHeader header;
+	header.elemCount = elemCount;
+	header.elemStride = uint32_t(elemStride);
+	header.codecKind = uint8_t(cmp->GetKind());
+	header.codecFormat = uint8_t(cmp->GetFormat());
+	header.filter = uint8_t(filter ? filter->id : kContainerFilterNone);
+	header.level = level;
+	header.blockElemCount = uint32_t(blockElemCount);
+	header.blockCount = uint32_t((elemCount + blockElemCount - 1) / blockElemCount);
+	const size_t boundsSets = boundsChunkElems ? (elemCount + boundsChunkElems - 1) / boundsChunkElems : 1;
+	header.boundsCount = uint32_t(boundsSets * kFullVertexFloats);
+	header.boundsChunkElems = uint32_t(boundsChunkElems);
+	header.attributeCount = kPackAttributeCount;
+	return header;
+}
+
+uint8_t* CompressorConfig::FilterCompressBlock(const FilterDesc* blockFilter, int level, const uint8_t* src, size_t elemCount, size_t elemStride, uint8_t* filterBuffer, size_t& outCompressedSize) const
+{
+	const uint8_t* cmpSrc = src;
+	if (blockFilter)
+	{
+		TraceZone zone("FilterBlock");
+		blockFilter->filterFunc(src, filterBuffer, elemStride, elemCount);
+		cmpSrc = filterBuffer;
+	}
+	TraceZone zone("CompressBlock");
+	return cmp->Compress(level, cmpSrc, elemCount, elemStride, outCompressedSize);
+}
+
+uint8_t* CompressorConfig::CompressBlock(int level, const uint8_t* src, size_t elemCount, size_t elemStride, uint8_t* filterBuffer, size_t& outCompressedSize, ContainerBlock& outBlock) const
+{
+	uint8_t* compressed;
+	outBlock.filter = filter ? filter->id : kContainerFilterNone;
+	if (filter != &g_FilterAuto)
+		compressed = FilterCompressBlock(filter, level, src, elemCount, elemStride, filterBuffer, outCompressedSize);
+	else
+	{
+		compressed = nullptr;
+		for (const FilterDesc* candidate : g_AutoFilterCandidates)
+		{
+			size_t size = 0;
+			uint8_t* res = FilterCompressBlock(candidate, level, src, elemCount, elemStride, filterBuffer, size);
+			if (compressed == nullptr || size < outCompressedSize)
+			{
+				delete[] compressed;
+				compressed = res;
+				outCompressedSize = size;
+				outBlock.filter = candidate ? candidate->id : kContainerFilterNone;
+			}
+			else
+				delete[] res;
+		}
+	}
+	// blocks the codec failed on (kCompressionError size) are stored too
+	outBlock.flags = 0;
+	const size_t rawSize = elemCount * elemStride;
+	if (outCompressedSize >= rawSize)
+	{
+		delete[] compressed;
+		compressed = new uint8_t[rawSize];
+		memcpy(compressed, src, rawSize);
+		outCompressedSize = rawSize;
+		outBlock.flags = kContainerBlockStored;
+	}
+	return compressed;
+}
+
+void CompressorConfig::TrainDictionary(int level, const uint8_t* src, size_t elemCount, size_t elemStride, size_t blockElems)
+{
+	TraceZone zone("TrainDictionary");
+	const size_t kSampleSize = 4 * 1024;
+	const size_t kSampleBudget = 100 * 16 * 1024;
+	const size_t blockCount = (elemCount + blockElems - 1) / blockElems;
+	const size_t blockSize = blockElems * elemStride;
+	const size_t sampleBlocks = std::min(blockCount, std::max<size_t>(kSampleBudget / blockSize, 1));
+	std::vector<uint8_t> samples;
+	std::vector<size_t> sampleSizes;
+	const FilterDesc* trainFilter = filter != &g_FilterAuto ? filter : nullptr;
+	std::vector<uint8_t> filterBuffer(trainFilter ? blockSize : 0);
+	for (size_t i = 0; i < sampleBlocks; ++i)
+	{
+		const size_t blockIndex = i * blockCount / sampleBlocks;
+		const size_t start = blockIndex * blockElems;
+		const size_t count = std::min(blockElems, elemCount - start);
+		const uint8_t* data = src + start * elemStride;
+		if (trainFilter)
+		{
+			trainFilter->filterFunc(data, filterBuffer.data(), elemStride, count);
+			data = filterBuffer.data();
+		}
+		const size_t size = count * elemStride;
+		samples.insert(samples.end(), data, data + size);
+		for (size_t offset = 0; offset < size; offset += kSampleSize)
+			sampleSizes.push_back(std::min(kSampleSize, size - offset));
+	}
+	if (!cmp->TrainDictionary(level, samples.data(), sampleSizes.data(), sampleSizes.size()))
+		printf("WARN: failed to train compression dictionary on %zi samples, compressing without one\n", sampleSizes.size());
+}
+
+size_t CompressorConfig::CalcDecodeScratchSize(const ContainerHeader& header) const
+{
+	const size_t blockElems = header.blockElemCount;
+	size_t size = ScratchArenaAllocSize(cmp->GetDecompressScratchSize(blockElems, header.elemStride));
+	if (filter)
+		size += ScratchArenaAllocSize(blockElems * header.elemStride);
+	return size;
+}
+
+bool CompressorConfig::DecompressBlock(const uint8_t* compressed, size_t compressedSize, const ContainerBlock& block, size_t elemCount, size_t elemStride, ScratchArena& scratch, uint8_t* dst) const
+{
+	const size_t size = elemCount * elemStride;
+	if (block.flags & kContainerBlockStored)
+	{
+		if (compressedSize != size)
+			return false;
+		memcpy(dst, compressed, size);
+		return true;
+	}
+	const FilterDesc* blockFilter = filter ? FindFilter(ContainerFilter(block.filter)) : nullptr;
+	uint8_t* filterBuffer = blockFilter ? scratch.Alloc(size) : nullptr;
+	{
+		TraceZone zone("DecompressBlock");
+		if (cmp->Decompress(compressed, compressedSize, blockFilter ? filterBuffer : dst, elemCount, elemStride, scratch.Alloc(cmp->GetDecompressScratchSize(elemCount, elemStride))) != size)
+			return false;
+	}
+	if (blockFilter)
+	{
+		TraceZone zone("UnfilterBlock");
+		blockFilter->unfilterFunc(filterBuffer, dst, elemStride, elemCount);
+	}
+	return true;
+}
+
+bool CompressorConfig::DecompressContainerBlock(const ContainerInfo& info, size_t blockIndex, ScratchArena& scratch, uint8_t* dst) const
+{
+	const ContainerBlock& block = info.blocks[blockIndex];
+	scratch.Reset();
+	return DecompressBlock(info.data + block.offset, block.size, block, block.elemCount, info.header.elemStride, scratch, dst);
+}
+
+uint8_t* CompressorConfig::Compress(const TestFile& tf, int level, size_t& outCompressedSize)
+{
+	if (IsStreamSplit())
+		return CompressStreams(tf, outCompressedSize);
+	TraceZone zone("Compress", tf.title);
+	const size_t blockElems = GetBlockElemCount(tf.vertexCount, tf.vertexStride);
+	ContainerHeader header = MakeContainerHeader(level, tf.vertexCount, tf.vertexStride, blockElems, tf.quantChunkSize);
+	header.codebookCount = uint32_t(tf.shCodebook.GetSize());
+	header.codebookDim = uint32_t(tf.shCodebook.GetDim());
+	const size_t blockCount = header.blockCount;
+	const int threads = int(std::min<size_t>(threadCount, blockCount));
+	const uint8_t* srcData = tf.fileData.data();
+	if (cmp->UsesDictionary())
+		TrainDictionary(level, srcData, tf.vertexCount, tf.vertexStride, blockElems);
+	const std::vector<uint8_t>& dictionary = cmp->GetDictionary();
+	header.dictionarySize = uint32_t(dictionary.size());
+
+	// filter & compress each block independently, possibly on multiple threads
+	std::vector<std::vector<uint8_t>> filterBuffers(filter ? threads : 0);
+	std::vector<uint8_t*> blockCmp(blockCount);
+	std::vector<ContainerBlock> blocks(blockCount);
+	ParallelFor(threads, blockCount, [&](size_t blockIndex, int threadIndex)
+	{
+		const size_t start = blockIndex * blockElems;
+		const size_t count = std::min(blockElems, tf.vertexCount - start);
+		uint8_t* filterBuffer = nullptr;
+		if (filter)
+		{
+			filterBuffers[threadIndex].resize(blockElems * tf.vertexStride);
+			filterBuffer = filterBuffers[threadIndex].data();
+		}
+		size_t cmpSize = 0;
+		blockCmp[blockIndex] = CompressBlock(level, srcData + start * tf.vertexStride, count, tf.vertexStride, filterBuffer, cmpSize, blocks[blockIndex]);
+		blocks[blockIndex].size = uint32_t(cmpSize);
+		blocks[blockIndex].elemCount = uint32_t(count);
+	});
+
+	outCompressedSize = LayoutContainerBlocks(header, blocks);
+	uint8_t* compressed = new uint8_t[outCompressedSize];
+	WriteContainer(compressed, header, tf, tf.packLayout, dictionary, blocks, blockCmp);
+	return compressed;
+}
+
+size_t CompressorConfig::LayoutContainerBlocks(const ContainerHeader& header, std::vector<ContainerBlock>& blocks)
+{
+	size_t cmpOffset = ContainerCalcPrefixSize(header);
+	for (ContainerBlock& block : blocks)
+	{
+		block.offset = cmpOffset;
+		cmpOffset += block.size;
+	}
+	return cmpOffset;
+}
+
+void CompressorConfig::WriteContainer(uint8_t* dst, const ContainerHeader& header, const TestFile& tf, const PackLayout& layout, const std::vector<uint8_t>& dictionary, const std::vector<ContainerBlock>& blocks, std::vector<uint8_t*>& blockCmp)
+{
+	const FullVertex* boundsMin = tf.quantChunkSize ? tf.chunkMin.data() : &tf.valMin;
+	const FullVertex* boundsMax = tf.quantChunkSize ? tf.chunkMax.data() : &tf.valMax;
+	ContainerWritePrefix(dst, header, (const float*)boundsMin, (const float*)boundsMax, layout.bits, tf.shCodebook.entries.data(), dictionary.data(), blocks.data());
+	for (size_t ib = 0; ib < blocks.size(); ++ib)
+	{
+		memcpy(dst + blocks[ib].offset, blockCmp[ib], blocks[ib].size);
+		delete[] blockCmp[ib];
+		blockCmp[ib] = nullptr;
+	}
+}
+
+bool CompressorConfig::Decompress(const TestFile& tf, const uint8_t* compressed, size_t compressedSize, uint8_t* dst, ScratchArenas& arenas)
+{
+	if (IsStreamSplit())
+		return DecompressStreams(tf, compressed, compressedSize, kStreamMaskAll, dst, arenas) != 0;
+	TraceZone zone("Decompress", tf.title);
+	ContainerInfo info;
+	if (!ContainerParse(compressed, compressedSize, info))
+		return false;
+	const ContainerHeader& header = info.header;
+	if (!MatchesContainer(header) || header.elemCount != tf.vertexCount || header.elemStride != tf.vertexStride)
+	{
+		printf("ERROR: compressed data does not match %s (%llu items of %u bytes)\n", tf.title, (unsigned long long)header.elemCount, header.elemStride);
+		return false;
+	}
+	if (!cmp->SetDictionary(info.dictionary, header.dictionarySize))
+	{
+		printf("ERROR: failed to load %u byte compression dictionary for %s\n", header.dictionarySize, tf.title);
+		return false;
+	}
+
+	// each block location is in the table, so they can be decompressed independently
+	const size_t blockCount = header.blockCount;
+	const size_t blockElems = header.blockElemCount;
+	const int threads = int(std::min<size_t>(threadCount, blockCount));
+	arenas.Prepare(threads, CalcDecodeScratchSize(header));
+	std::atomic<bool> ok = true;
+	ParallelFor(threads, blockCount, [&](size_t blockIndex, int threadIndex)
+	{
+		if (!DecompressContainerBlock(info, blockIndex, arenas.Get(threadIndex), dst + blockIndex * blockElems * header.elemStride))
+			ok = false;
+	});
+	if (!ok)
+	{
+		printf("ERROR: blocks of %s did not decompress to their size in the block table\n", tf.title);
+		return false;
+	}
+	return true;
+}
+
+std::string GetConfigLevelName(const CompressorConfig& config, size_t levelCount, int level)
+{
+	std::string name = config.GetName();
+	if (levelCount == 1)
+		return name;
+	char buf[20];
+	snprintf(buf, sizeof(buf), level < 0 ? "_n%i" : "_%i", abs(level));
+	return name + buf;
+}
+
+void GatherSampleRuns(const uint8_t* data, size_t elemCount, size_t elemStride, size_t sampleElems, size_t runCount, uint8_t* dst)
+{
+	const size_t runElems = (sampleElems + runCount - 1) / runCount;
+	for (size_t offset = 0; offset < sampleElems; offset += runElems)
+	{
+		const size_t start = offset * elemCount / sampleElems;
+		memcpy(dst + offset * elemStride, data + start * elemStride, std::min(runElems, sampleElems - offset) * elemStride);
+	}
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "compressors.h"
+#include "container.h"
+#include "scratch_arena.h"
+#include "splat_data.h"
+
+struct FilterDesc
+{
+	const char* name = nullptr;
+	ContainerFilter id = kContainerFilterNone; // what gets stored in compressed data
+	void (*filterFunc)(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems) = nullptr;
+	void (*unfilterFunc)(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems) = nullptr;
+};
+
+extern FilterDesc g_FilterByteDelta;
+extern FilterDesc g_FilterByteDelta16;
+extern FilterDesc g_FilterByteDelta32;
+extern FilterDesc g_FilterByteDelta64;
+extern FilterDesc g_FilterWordDelta;
+extern FilterDesc g_FilterXorDelta;
+extern FilterDesc g_FilterBitShuffle;
+extern FilterDesc g_FilterPredict;
+// Tries each of a set of candidate filters on each block, and keeps whichever compresses smallest
+extern FilterDesc g_FilterAuto;
+
+// Filter to decode data that was compressed with a given ContainerFilter
+FilterDesc* FindFilter(ContainerFilter id);
+
+enum BlockSize
+{
+	kBSizeNone,
+	kBSize64k,
+	kBSize256k,
+	kBSize1M,
+	kBSize4M,
+	kBSize16M,
+	kBSize64M,
+	kBSizeCount
+};
+static const size_t kBlockSizeToActualSize[] =
+{
+	0,
+	64 * 1024,
+	256 * 1024,
+	1024 * 1024,
+	4 * 1024 * 1024,
+	16 * 1024 * 1024,
+	64 * 1024 * 1024,
+};
+static_assert(sizeof(kBlockSizeToActualSize)/sizeof(kBlockSizeToActualSize[0]) == kBSizeCount, "block size table size mismatch");
+static const char* kBlockSizeName[] =
+{
+	"",
+	"-64k",
+	"-256k",
+	"-1M",
+	"-4M",
+	"-16M",
+	"-64M",
+};
+static_assert(sizeof(kBlockSizeName) / sizeof(kBlockSizeName[0]) == kBSizeCount, "block size name table size mismatch");
+
+struct CompressorConfig
+{
+	Compressor* cmp;
+	FilterDesc* filter;
+	BlockSize blockSizeEnum = kBSizeNone;
+	int threadCount = 1; // blocks are filtered & (de)compressed on this many threads (zstd-mt: its worker threads)
+	std::vector<int> levels; // levels to test; compressor's own set when empty
+
+	// Stream-split mode when not empty (cmp & filter are null then): packed records are split into
+	// attribute streams, and each stream is compressed with whichever of these candidates (and their
+	// levels) makes a sample of it smallest. Blocks of all streams are spread over threadCount threads.
+	std::vector<CompressorConfig> streamCandidates;
+
+	bool IsStreamSplit() const { return !streamCandidates.empty(); }
+
+	std::vector<int> GetLevels() const
+	{
+		if (IsStreamSplit())
+			return {0};
+		return levels.empty() ? cmp->GetLevels() : levels;
+	}
+
+	std::string GetCodecName() const
+	{
+		if (IsStreamSplit())
+			return "split";
+		char buf[100];
+		cmp->PrintName(sizeof(buf), buf);
+		return buf;
+	}
+
+	std::string GetName() const
+	{
+		char buf[100];
+		std::string res = GetCodecName();
+		if (filter != nullptr)
+			res += filter->name;
+		res += kBlockSizeName[blockSizeEnum];
+		if (threadCount > 1)
+		{
+			snprintf(buf, sizeof(buf), "-t%i", threadCount);
+			res += buf;
+		}
+		return res;
+	}
+
+	// Items per container block; whole data is one block when not using blocks
+	size_t GetBlockElemCount(size_t elemCount, size_t elemStride) const
+	{
+		if (blockSizeEnum == kBSizeNone)
+			return std::max<size_t>(elemCount, 1);
+		return std::max<size_t>(kBlockSizeToActualSize[blockSizeEnum] / elemStride, 1);
+	}
+
+	ContainerHeader MakeContainerHeader(int level, size_t elemCount, size_t elemStride, size_t blockElemCount, size_t boundsChunkElems = 0) const;
+
+	// Whether container data was written with this compressor & filter
+	bool MatchesContainer(const ContainerHeader& header) const
+	{
+		return header.codecKind == cmp->GetKind() && header.codecFormat == cmp->GetFormat() && header.filter == (filter ? filter->id : kContainerFilterNone);
+	}
+
+	// Filter (into filterBuffer, if there is a filter) and compress one block of data with the given filter
+	uint8_t* FilterCompressBlock(const FilterDesc* blockFilter, int level, const uint8_t* src, size_t elemCount, size_t elemStride, uint8_t* filterBuffer, size_t& outCompressedSize) const;
+
+	// Filter (into filterBuffer, if there is a filter) and compress one block of data; outBlock gets
+	// the flags and filter used. With the auto filter, each candidate filter is tried and the smallest
+	// result is kept. If that does not make it smaller, the block is stored as is (kContainerBlockStored).
+	uint8_t* CompressBlock(int level, const uint8_t* src, size_t elemCount, size_t elemStride, uint8_t* filterBuffer, size_t& outCompressedSize, ContainerBlock& outBlock) const;
+
+	// Dictionary is trained on whole (filtered) blocks spread evenly over the data, cut into
+	// small samples; ~100x the dictionary size in total. With the auto filter, on unfiltered blocks.
+	void TrainDictionary(int level, const uint8_t* src, size_t elemCount, size_t elemStride, size_t blockElems);
+
+	// Scratch memory DecompressBlock needs for blocks of this container: filter buffer & compressor scratch
+	size_t CalcDecodeScratchSize(const ContainerHeader& header) const;
+
+	// Decompress (into a filter buffer, if the block has a filter) and unfilter one block of data.
+	// Scratch memory is allocated from the arena; reserve CalcDecodeScratchSize in it to not allocate.
+	// False when the block does not decode to exactly elemCount items (corrupt data).
+	bool DecompressBlock(const uint8_t* compressed, size_t compressedSize, const ContainerBlock& block, size_t elemCount, size_t elemStride, ScratchArena& scratch, uint8_t* dst) const;
+
+	// Decode any single block of a parsed container; dst is where the block items start. Resets scratch.
+	bool DecompressContainerBlock(const ContainerInfo& info, size_t blockIndex, ScratchArena& scratch, uint8_t* dst) const;
+
+	// Produces a container (see container.h) of the packed file data, with valMin/valMax
+	// (or chunkMin/chunkMax when using chunked quantization) as the bounds, and SH codebook if used.
+	// In stream-split mode, stream-split data of such containers.
+	uint8_t* Compress(const TestFile& tf, int level, size_t& outCompressedSize);
+
+	// Lays out the blocks in order after the header & block table; returns whole container size
+	static size_t LayoutContainerBlocks(const ContainerHeader& header, std::vector<ContainerBlock>& blocks);
+
+	// Writes container prefix (with bounds & codebook of the file) and block payloads, which get deleted
+	static void WriteContainer(uint8_t* dst, const ContainerHeader& header, const TestFile& tf, const PackLayout& layout, const std::vector<uint8_t>& dictionary, const std::vector<ContainerBlock>& blocks, std::vector<uint8_t*>& blockCmp);
+
+	// Decodes into dst, which holds the whole packed file data; scratch memory comes from the arenas
+	// (sized from the container header), so once they have grown this does not allocate per block
+	bool Decompress(const TestFile& tf, const uint8_t* compressed, size_t compressedSize, uint8_t* dst, ScratchArenas& arenas);
+
+	// Stream-split mode; see stream_split.h
+	uint8_t* CompressStreams(const TestFile& tf, size_t& outCompressedSize) const;
+	// Decodes streams in streamMask (others are skipped) into records of the file's layout minus the
+	// attributes of skipped streams (see BuildReducedLayout); returns size of those records, or 0 on failure.
+	// Decoded streams are in the shared arena until they are merged.
+	size_t DecompressStreams(const TestFile& tf, const uint8_t* compressed, size_t compressedSize, uint32_t streamMask, uint8_t* dst, ScratchArenas& arenas) const;
+	// Decodes all the way into unlinearized splats (not stream-split data); see the definition
+	bool DecompressFused(const TestFile& tf, const uint8_t* compressed, size_t compressedSize, FullVertex* dst, ScratchArenas& arenas);
+};
+
+// Config name, with level (_nX for negative ones) when the config has several levels
+std::string GetConfigLevelName(const CompressorConfig& config, size_t levelCount, int level);
+// Copies sampleElems items (at most elemCount) into dst, as runCount runs of items spread evenly over the data
+void GatherSampleRuns(const uint8_t* data, size_t elemCount, size_t elemStride, size_t sampleElems, size_t runCount, uint8_t* dst);
@@ -1,5 +1,6 @@
 #include "compressors.h"
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include <string>
@@ -29,15 +30,16 @@ uint8_t* GenericCompressor::Compress(int level, const void* data, size_t itemCou
     return cmp;
 }
 
-void GenericCompressor::Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride)
+size_t GenericCompressor::Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride, uint8_t* /*scratch*/)
 {
     size_t dataSize = itemCount * itemStride;
-    decompress_data(cmp, cmpSize, data, dataSize, m_Format);
+    return decompress_data(cmp, cmpSize, data, dataSize, m_Format);
 }
 
 static const char* kCompressionFormatNames[] = {
     "zstd",
     "lz4",
+    "rans",
 };
 static_assert(sizeof(kCompressionFormatNames) / sizeof(kCompressionFormatNames[0]) == kCompressionCount);
 
@@ -60,43 +62,94 @@ static uint8_t* CompressGeneric(CompressionFormat format, int level, uint8_t* da
     }
     size_t bound = compress_calc_bound(dataSize, format);
     uint8_t* cmp = new uint8_t[bound + 4];
-    *(uint32_t*)cmp = uint32_t(dataSize); // store orig size at start
-    outSize = compress_data(data, dataSize, cmp + 4, bound, format, level) + 4;
+    const uint32_t origSize = uint32_t(dataSize);
+    memcpy(cmp, &origSize, sizeof(origSize)); // store orig size at start
+    outSize = compress_data(data, dataSize, cmp + 4, bound, format, level);
+    if (outSize != kCompressionError)
+        outSize += 4;
     delete[] data;
     return cmp;
 }
 
-static uint8_t* DecompressGeneric(CompressionFormat format, const uint8_t* cmp, size_t cmpSize, size_t& outSize)
+// Decompresses into dst (of dstCapacity bytes), or returns cmp itself when there is no format;
+// null when the data is corrupt
+static const uint8_t* DecompressGeneric(CompressionFormat format, const uint8_t* cmp, size_t cmpSize, uint8_t* dst, size_t dstCapacity, size_t& outSize)
 {
+    outSize = 0;
     if (format == kCompressionCount)
     {
         outSize = cmpSize;
-        return (uint8_t*)cmp;
+        return cmp;
     }
-    uint32_t decSize = *(uint32_t*)cmp; // fetch orig size from start
-    uint8_t* decomp = new uint8_t[decSize];
-    outSize = decompress_data(cmp + 4, cmpSize - 4, decomp, decSize, format);
-    return decomp;
+    uint32_t decSize = 0;
+    if (cmpSize < sizeof(decSize))
+        return nullptr;
+    memcpy(&decSize, cmp, sizeof(decSize)); // fetch orig size from start
+    if (decSize > dstCapacity || decompress_data(cmp + 4, cmpSize - 4, dst, decSize, format) != decSize)
+        return nullptr;
+    outSize = decSize;
+    return dst;
+}
+
+// meshopt vertex codec needs item size to be a multiple of 4 (packed records are often not),
+// so items get padded with zeros up to that
+static size_t CalcMeshOptStride(size_t itemStride)
+{
+    return (itemStride + 3) & ~size_t(3);
 }
 
 uint8_t* MeshOptCompressor::Compress(int level, const void* data, size_t itemCount, size_t itemStride, size_t& outSize)
 {
-    size_t dataSize = itemCount * itemStride;
-    size_t moBound = compress_meshopt_vertex_attribute_bound(itemCount, itemStride);
+    const size_t moStride = CalcMeshOptStride(itemStride);
+    std::vector<uint8_t> padded;
+    if (moStride != itemStride)
+    {
+        padded.resize(itemCount * moStride);
+        for (size_t i = 0; i < itemCount; ++i)
+            memcpy(padded.data() + i * moStride, (const uint8_t*)data + i * itemStride, itemStride);
+        data = padded.data();
+    }
+    size_t moBound = compress_meshopt_vertex_attribute_bound(itemCount, moStride);
     uint8_t* moCmp = new uint8_t[moBound];
-    size_t moSize = compress_meshopt_vertex_attribute(data, itemCount, itemStride, moCmp, moBound);
+    size_t moSize = compress_meshopt_vertex_attribute(data, itemCount, moStride, moCmp, moBound);
+    if (moSize == 0 && itemCount != 0)
+    {
+        outSize = kCompressionError;
+        return moCmp;
+    }
     return CompressGeneric(m_Format, level, moCmp, moSize, outSize);
 }
 
-void MeshOptCompressor::Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride)
+// scratch: meshopt data (when there is a second stage format), then padded items (when padding)
+size_t MeshOptCompressor::GetDecompressScratchSize(size_t itemCount, size_t itemStride) const
 {
-    size_t dataSize = itemCount * itemStride;
+    const size_t moStride = CalcMeshOptStride(itemStride);
+    size_t size = 0;
+    if (m_Format != kCompressionCount)
+        size += compress_meshopt_vertex_attribute_bound(itemCount, moStride);
+    if (moStride != itemStride)
+        size += itemCount * moStride;
+    return size;
+}
 
+size_t MeshOptCompressor::Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride, uint8_t* scratch)
+{
+    const size_t moStride = CalcMeshOptStride(itemStride);
+    const size_t moBound = m_Format != kCompressionCount ? compress_meshopt_vertex_attribute_bound(itemCount, moStride) : 0;
     size_t decompSize;
-    uint8_t* decomp = DecompressGeneric(m_Format, cmp, cmpSize, decompSize);
+    const uint8_t* decomp = DecompressGeneric(m_Format, cmp, cmpSize, scratch, moBound, decompSize);
+    if (decomp == nullptr)
+        return 0;
 
-    decompress_meshopt_vertex_attribute(decomp, decompSize, itemCount, itemStride, data);
-    if (decomp != cmp) delete[] decomp;
+    // meshopt decoder returns 0 on success
+    if (moStride == itemStride)
+        return decompress_meshopt_vertex_attribute(decomp, decompSize, itemCount, itemStride, data) == 0 ? itemCount * itemStride : 0;
+    uint8_t* padded = scratch + moBound;
+    if (decompress_meshopt_vertex_attribute(decomp, decompSize, itemCount, moStride, padded) != 0)
+        return 0;
+    for (size_t i = 0; i < itemCount; ++i)
+        memcpy((uint8_t*)data + i * itemStride, padded + i * moStride, itemStride);
+    return itemCount * itemStride;
 }
 
 std::vector<int> MeshOptCompressor::GetLevels() const
@@ -111,3 +164,101 @@ void MeshOptCompressor::PrintName(size_t bufSize, char* buf) const
     else
         snprintf(buf, bufSize, "meshopt-%s", kCompressionFormatNames[m_Format]);
 }
+
+ZstdCompressor::~ZstdCompressor()
+{
+    zstd_free_cdict(m_CDict);
+    zstd_free_ddict(m_DDict);
+    for (ZSTD_CCtx_s* cctx : m_FreeCCtx)
+        zstd_free_cctx(cctx);
+    for (ZSTD_DCtx_s* dctx : m_FreeDCtx)
+        zstd_free_dctx(dctx);
+}
+
+// Takes a free context, or makes a new one when all are in use
+template<typename T>
+static T* AcquireContext(std::mutex& mutex, std::vector<T*>& freeList, T* (*create)())
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeList.empty())
+        {
+            T* ctx = freeList.back();
+            freeList.pop_back();
+            return ctx;
+        }
+    }
+    return create();
+}
+
+template<typename T>
+static void ReleaseContext(std::mutex& mutex, std::vector<T*>& freeList, T* ctx)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    freeList.push_back(ctx);
+}
+
+uint8_t* ZstdCompressor::Compress(int level, const void* data, size_t itemCount, size_t itemStride, size_t& outSize)
+{
+    size_t dataSize = itemCount * itemStride;
+    size_t bound = compress_calc_bound(dataSize, kCompressionZstd);
+    uint8_t* cmp = new uint8_t[bound];
+    ZSTD_CCtx_s* cctx = AcquireContext(m_ContextMutex, m_FreeCCtx, zstd_create_cctx);
+    outSize = compress_zstd_ctx(cctx, data, dataSize, cmp, bound, level, m_WorkerCount, m_CDict);
+    ReleaseContext(m_ContextMutex, m_FreeCCtx, cctx);
+    return cmp;
+}
+
+size_t ZstdCompressor::Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride, uint8_t* /*scratch*/)
+{
+    size_t dataSize = itemCount * itemStride;
+    ZSTD_DCtx_s* dctx = AcquireContext(m_ContextMutex, m_FreeDCtx, zstd_create_dctx);
+    const size_t res = decompress_zstd_ctx(dctx, cmp, cmpSize, data, dataSize, m_DDict);
+    ReleaseContext(m_ContextMutex, m_FreeDCtx, dctx);
+    return res;
+}
+
+std::vector<int> ZstdCompressor::GetLevels() const
+{
+    return GetGenericLevelRange(kCompressionZstd);
+}
+
+void ZstdCompressor::PrintName(size_t bufSize, char* buf) const
+{
+    static const char* kModeNames[] = { "ctx", "dict", "mt" };
+    snprintf(buf, bufSize, "zstd-%s", kModeNames[m_Mode]);
+}
+
+bool ZstdCompressor::TrainDictionary(int level, const uint8_t* samples, const size_t* sampleSizes, size_t sampleCount)
+{
+    const size_t kDictionaryCapacity = 16 * 1024;
+    std::vector<uint8_t> dict(kDictionaryCapacity);
+    size_t dictSize = zstd_train_dictionary(samples, sampleSizes, sampleCount, dict.data(), dict.size());
+    dict.resize(dictSize);
+    if (!SetDictionary(dict.data(), dict.size()))
+        return false;
+    zstd_free_cdict(m_CDict);
+    m_CDict = dictSize ? zstd_create_cdict(m_Dictionary.data(), m_Dictionary.size(), level) : nullptr;
+    return dictSize != 0;
+}
+
+bool ZstdCompressor::SetDictionary(const uint8_t* data, size_t size)
+{
+    m_Dictionary.assign(data, data + size);
+    zstd_free_ddict(m_DDict);
+    m_DDict = size ? zstd_create_ddict(data, size) : nullptr;
+    return size == 0 || m_DDict != nullptr;
+}
+
+Compressor* CreateCompressor(CompressorKind kind, CompressionFormat format)
+{
+    if (format < 0 || format > kCompressionCount)
+        return nullptr;
+    switch (kind)
+    {
+    case kCompressorGeneric: return format == kCompressionCount ? nullptr : new GenericCompressor(format);
+    case kCompressorMeshOpt: return new MeshOptCompressor(format);
+    case kCompressorZstd: return format == kCompressionZstd ? new ZstdCompressor(kZstdContexts) : nullptr;
+    default: return nullptr;
+    }
+}
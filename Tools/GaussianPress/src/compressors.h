@@ -1,22 +1,47 @@
 #pragma once
 #include "compression_helpers.h"
 #include <stddef.h>
+#include <mutex>
 #include <vector>
 
+// Stored in compressed data containers; do not renumber
+enum CompressorKind
+{
+	kCompressorGeneric = 0,
+	kCompressorMeshOpt,
+	kCompressorZstd,
+	kCompressorKindCount
+};
+
 struct Compressor
 {
 	virtual ~Compressor() {}
+	virtual CompressorKind GetKind() const = 0;
+	virtual CompressionFormat GetFormat() const = 0;
+	// outSize is kCompressionError when the codec fails; the returned buffer is the caller's to delete either way
 	virtual uint8_t* Compress(int level, const void* data, size_t itemCount, size_t itemStride, size_t& outSize) = 0;
-	virtual void Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride) = 0;
+	// scratch is GetDecompressScratchSize bytes of caller-owned memory; Decompress does not allocate.
+	// Returns the number of bytes decoded, which is itemCount * itemStride unless the data is corrupt.
+	virtual size_t Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride, uint8_t* scratch) = 0;
+	virtual size_t GetDecompressScratchSize(size_t /*itemCount*/, size_t /*itemStride*/) const { return 0; }
 	virtual std::vector<int> GetLevels() const { return {0}; }
 	virtual void PrintName(size_t bufSize, char* buf) const = 0;
+
+	// Compressors that use a dictionary train it on samples of the data before Compress calls.
+	// The dictionary is stored along with compressed data, and set again before Decompress calls.
+	virtual bool UsesDictionary() const { return false; }
+	virtual bool TrainDictionary(int /*level*/, const uint8_t* /*samples*/, const size_t* /*sampleSizes*/, size_t /*sampleCount*/) { return false; }
+	virtual bool SetDictionary(const uint8_t* /*data*/, size_t size) { return size == 0; }
+	virtual const std::vector<uint8_t>& GetDictionary() const { static const std::vector<uint8_t> kEmpty; return kEmpty; }
 };
 
 struct GenericCompressor : public Compressor
 {
 	GenericCompressor(CompressionFormat format) : m_Format(format) {}
+	virtual CompressorKind GetKind() const { return kCompressorGeneric; }
+	virtual CompressionFormat GetFormat() const { return m_Format; }
 	virtual uint8_t* Compress(int level, const void* data, size_t itemCount, size_t itemStride, size_t& outSize);
-	virtual void Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride);
+	virtual size_t Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride, uint8_t* scratch);
 	virtual std::vector<int> GetLevels() const;
 	virtual void PrintName(size_t bufSize, char* buf) const;
 	CompressionFormat m_Format;
@@ -25,9 +50,52 @@ struct GenericCompressor : public Compressor
 struct MeshOptCompressor : public Compressor
 {
 	MeshOptCompressor(CompressionFormat format) : m_Format(format) {}
+	virtual CompressorKind GetKind() const { return kCompressorMeshOpt; }
+	virtual CompressionFormat GetFormat() const { return m_Format; }
 	virtual uint8_t* Compress(int level, const void* data, size_t itemCount, size_t itemStride, size_t& outSize);
-	virtual void Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride);
+	virtual size_t Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride, uint8_t* scratch);
+	virtual size_t GetDecompressScratchSize(size_t itemCount, size_t itemStride) const;
 	virtual std::vector<int> GetLevels() const;
 	virtual void PrintName(size_t bufSize, char* buf) const;
 	CompressionFormat m_Format;
 };
+
+enum ZstdMode
+{
+	kZstdContexts, // one context per thread, reused between calls
+	kZstdDictionary, // same, with a dictionary trained on samples of the data
+	kZstdWorkers, // zstd's own worker threads; for compressing whole data in one go
+};
+
+// zstd through compression_helpers' contexts, which the compressor keeps for reuse by all later
+// calls (on any thread); output is regular zstd frames, so any mode decompresses with any other
+// (given the dictionary, if one was used)
+struct ZstdCompressor : public Compressor
+{
+	ZstdCompressor(ZstdMode mode, int workerCount = 0) : m_Mode(mode), m_WorkerCount(workerCount) {}
+	virtual ~ZstdCompressor();
+	virtual CompressorKind GetKind() const { return kCompressorZstd; }
+	virtual CompressionFormat GetFormat() const { return kCompressionZstd; }
+	virtual uint8_t* Compress(int level, const void* data, size_t itemCount, size_t itemStride, size_t& outSize);
+	virtual size_t Decompress(const uint8_t* cmp, size_t cmpSize, void* data, size_t itemCount, size_t itemStride, uint8_t* scratch);
+	virtual std::vector<int> GetLevels() const;
+	virtual void PrintName(size_t bufSize, char* buf) const;
+	virtual bool UsesDictionary() const { return m_Mode == kZstdDictionary; }
+	virtual bool TrainDictionary(int level, const uint8_t* samples, const size_t* sampleSizes, size_t sampleCount);
+	virtual bool SetDictionary(const uint8_t* data, size_t size);
+	virtual const std::vector<uint8_t>& GetDictionary() const { return m_Dictionary; }
+
+	ZstdMode m_Mode;
+	int m_WorkerCount;
+	std::vector<uint8_t> m_Dictionary;
+	ZSTD_CDict_s* m_CDict = nullptr; // only after training
+	ZSTD_DDict_s* m_DDict = nullptr;
+
+	// contexts not in use right now; there are as many as calls ran at once so far
+	std::mutex m_ContextMutex;
+	std::vector<ZSTD_CCtx_s*> m_FreeCCtx;
+	std::vector<ZSTD_DCtx_s*> m_FreeDCtx;
+};
+
+// Creates compressor from IDs stored in a container; returns null for unknown ones
+Compressor* CreateCompressor(CompressorKind kind, CompressionFormat format);
@@ -0,0 +1,213 @@
+#include "container.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// attribute bits are padded so that the block table is 8 byte aligned
+static size_t CalcAttributeBitsSize(uint32_t attributeCount)
+{
+	return (size_t(attributeCount) + 7) & ~size_t(7);
+}
+
+// same for the codebook
+static size_t CalcCodebookSize(const ContainerHeader& header)
+{
+	return (size_t(header.codebookCount) * header.codebookDim * sizeof(float) + 7) & ~size_t(7);
+}
+
+// and the dictionary
+static size_t CalcDictionarySize(const ContainerHeader& header)
+{
+	return (size_t(header.dictionarySize) + 7) & ~size_t(7);
+}
+
+size_t ContainerCalcPrefixSize(const ContainerHeader& header)
+{
+	return sizeof(ContainerHeader) + size_t(header.boundsCount) * sizeof(float) * 2 + CalcAttributeBitsSize(header.attributeCount) + CalcCodebookSize(header) +
+		CalcDictionarySize(header) + size_t(header.blockCount) * sizeof(ContainerBlock);
+}
+
+void ContainerWritePrefix(uint8_t* dst, const ContainerHeader& header, const float* boundsMin, const float* boundsMax, const uint8_t* attributeBits, const float* codebook, const uint8_t* dictionary, const ContainerBlock* blocks)
+{
+	memcpy(dst, &header, sizeof(header));
+	dst += sizeof(header);
+	memcpy(dst, boundsMin, header.boundsCount * sizeof(float));
+	dst += header.boundsCount * sizeof(float);
+	memcpy(dst, boundsMax, header.boundsCount * sizeof(float));
+	dst += header.boundsCount * sizeof(float);
+	const size_t bitsSize = CalcAttributeBitsSize(header.attributeCount);
+	memset(dst, 0, bitsSize);
+	memcpy(dst, attributeBits, header.attributeCount);
+	dst += bitsSize;
+	const size_t codebookSize = CalcCodebookSize(header);
+	memset(dst, 0, codebookSize);
+	memcpy(dst, codebook, size_t(header.codebookCount) * header.codebookDim * sizeof(float));
+	dst += codebookSize;
+	const size_t dictionarySize = CalcDictionarySize(header);
+	memset(dst, 0, dictionarySize);
+	memcpy(dst, dictionary, header.dictionarySize);
+	dst += dictionarySize;
+	memcpy(dst, blocks, header.blockCount * sizeof(ContainerBlock));
+}
+
+static bool CheckBlockFilter(const ContainerHeader& header, const ContainerBlock& block, uint32_t index)
+{
+	const bool ok = header.filter == kContainerFilterAuto ? block.filter < kContainerFilterAuto : block.filter == header.filter;
+	if (!ok)
+		printf("ERROR: container block %u has filter %u, header filter is %u\n", index, block.filter, header.filter);
+	return ok;
+}
+
+static bool CheckHeader(const uint8_t* data, size_t dataSize, ContainerHeader& header)
+{
+	if (dataSize < sizeof(ContainerHeader))
+	{
+		printf("ERROR: container is too small (%zi bytes)\n", dataSize);
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != kContainerMagic)
+	{
+		printf("ERROR: container has wrong magic (0x%08x)\n", header.magic);
+		return false;
+	}
+	if (header.version != kContainerVersion)
+	{
+		printf("ERROR: container version %u is not supported (expected %u)\n", header.version, kContainerVersion);
+		return false;
+	}
+	if (dataSize < ContainerCalcPrefixSize(header))
+	{
+		printf("ERROR: container is truncated, %u blocks do not fit into %zi bytes\n", header.blockCount, dataSize);
+		return false;
+	}
+	return true;
+}
+
+// Blocks have to be within the data and add up to the header item count
+static bool CheckBlocks(const ContainerHeader& header, const ContainerBlock* blocks, size_t dataSize)
+{
+	uint64_t totalElems = 0;
+	for (uint32_t i = 0; i < header.blockCount; ++i)
+	{
+		const ContainerBlock& block = blocks[i];
+		if (block.offset > dataSize || block.size > dataSize - block.offset)
+		{
+			printf("ERROR: container block %u (offset %llu size %u) is outside of data (%zi bytes)\n", i, (unsigned long long)block.offset, block.size, dataSize);
+			return false;
+		}
+		// all blocks except the last one are full, so that item N is always in block N/blockElemCount
+		const bool isLast = i == header.blockCount - 1;
+		if (block.elemCount > header.blockElemCount || (!isLast && block.elemCount != header.blockElemCount))
+		{
+			printf("ERROR: container block %u has %u items, expected %u\n", i, block.elemCount, header.blockElemCount);
+			return false;
+		}
+		if (!CheckBlockFilter(header, block, i))
+			return false;
+		totalElems += block.elemCount;
+	}
+	if (totalElems != header.elemCount)
+	{
+		printf("ERROR: container blocks have %llu items, header says %llu\n", (unsigned long long)totalElems, (unsigned long long)header.elemCount);
+		return false;
+	}
+	return true;
+}
+
+bool ContainerParse(const uint8_t* data, size_t dataSize, ContainerInfo& info)
+{
+	if (!CheckHeader(data, dataSize, info.header))
+		return false;
+	const ContainerHeader& header = info.header;
+	const uint8_t* ptr = data + sizeof(ContainerHeader);
+	info.boundsMin = (const float*)ptr;
+	ptr += header.boundsCount * sizeof(float);
+	info.boundsMax = (const float*)ptr;
+	ptr += header.boundsCount * sizeof(float);
+	info.attributeBits = ptr;
+	ptr += CalcAttributeBitsSize(header.attributeCount);
+	info.codebook = (const float*)ptr;
+	ptr += CalcCodebookSize(header);
+	info.dictionary = ptr;
+	ptr += CalcDictionarySize(header);
+	info.blocks = (const ContainerBlock*)ptr;
+	info.data = data;
+	info.dataSize = dataSize;
+	return CheckBlocks(header, info.blocks, dataSize);
+}
+
+bool ContainerParsePrefix(const uint8_t* data, size_t dataSize, size_t fileSize, ContainerHeader& header, std::vector<float>& boundsMin, std::vector<float>& boundsMax, std::vector<uint8_t>& attributeBits, std::vector<float>& codebook, std::vector<uint8_t>& dictionary, std::vector<ContainerBlock>& blocks)
+{
+	if (!CheckHeader(data, dataSize, header))
+		return false;
+	const uint8_t* ptr = data + sizeof(ContainerHeader);
+	boundsMin.resize(header.boundsCount);
+	boundsMax.resize(header.boundsCount);
+	attributeBits.resize(header.attributeCount);
+	codebook.resize(size_t(header.codebookCount) * header.codebookDim);
+	dictionary.resize(header.dictionarySize);
+	blocks.resize(header.blockCount);
+	memcpy(boundsMin.data(), ptr, header.boundsCount * sizeof(float));
+	ptr += header.boundsCount * sizeof(float);
+	memcpy(boundsMax.data(), ptr, header.boundsCount * sizeof(float));
+	ptr += header.boundsCount * sizeof(float);
+	memcpy(attributeBits.data(), ptr, header.attributeCount);
+	ptr += CalcAttributeBitsSize(header.attributeCount);
+	memcpy(codebook.data(), ptr, codebook.size() * sizeof(float));
+	ptr += CalcCodebookSize(header);
+	memcpy(dictionary.data(), ptr, dictionary.size());
+	ptr += CalcDictionarySize(header);
+	memcpy(blocks.data(), ptr, header.blockCount * sizeof(ContainerBlock));
+	return CheckBlocks(header, blocks.data(), fileSize);
+}
+
+size_t ContainerCalcStreamsPrefixSize(uint32_t streamCount)
+{
+	return sizeof(ContainerStreamsHeader) + size_t(streamCount) * sizeof(ContainerStream);
+}
+
+void ContainerWriteStreamsPrefix(uint8_t* dst, const ContainerStreamsHeader& header, const ContainerStream* streams)
+{
+	memcpy(dst, &header, sizeof(header));
+	memcpy(dst + sizeof(header), streams, header.streamCount * sizeof(ContainerStream));
+}
+
+bool ContainerParseStreams(const uint8_t* data, size_t dataSize, ContainerStreamsInfo& info)
+{
+	if (dataSize < sizeof(ContainerStreamsHeader))
+	{
+		printf("ERROR: stream-split data is too small (%zi bytes)\n", dataSize);
+		return false;
+	}
+	ContainerStreamsHeader& header = info.header;
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != kContainerStreamsMagic)
+	{
+		printf("ERROR: stream-split data has wrong magic (0x%08x)\n", header.magic);
+		return false;
+	}
+	if (header.version != kContainerVersion)
+	{
+		printf("ERROR: stream-split data version %u is not supported (expected %u)\n", header.version, kContainerVersion);
+		return false;
+	}
+	if (dataSize < ContainerCalcStreamsPrefixSize(header.streamCount))
+	{
+		printf("ERROR: stream-split data is truncated, %u streams do not fit into %zi bytes\n", header.streamCount, dataSize);
+		return false;
+	}
+	info.streams = (const ContainerStream*)(data + sizeof(header));
+	info.data = data;
+	info.dataSize = dataSize;
+	for (uint32_t i = 0; i < header.streamCount; ++i)
+	{
+		const ContainerStream& stream = info.streams[i];
+		if (stream.offset > dataSize || stream.size > dataSize - stream.offset)
+		{
+			printf("ERROR: stream %u (offset %llu size %llu) is outside of data (%zi bytes)\n", i, (unsigned long long)stream.offset, (unsigned long long)stream.size, dataSize);
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// GaussianPress compressed data container. All little endian:
+//
+//   ContainerHeader
+//   float boundsMin[boundsCount]     quantization bounds of the packed data
+//   float boundsMax[boundsCount]
+//   uint8_t attributeBits[attributeCount]   bits each attribute is quantized to; padded to multiple of 8 bytes
+//   float codebook[codebookCount * codebookDim]   vector quantization codebook; padded to multiple of 8 bytes
+//   uint8_t dictionary[dictionarySize]   compressor dictionary (e.g. zstd); padded to multiple of 8 bytes
+//   ContainerBlock blocks[blockCount]
+//   block payloads, at offsets given in the block table (relative to start of container)
+//
+// Each block holds a whole number of items and is filtered + compressed independently,
+// so any block can be located via the table and decoded on its own (e.g. in parallel).
+//
+// Stream-split data has the packed records split into attribute streams (position, color, SH etc.),
+// each stream a whole container as above, with its own codec, filter and level, and attribute bits
+// of just the attributes in that stream:
+//
+//   ContainerStreamsHeader
+//   ContainerStream streams[streamCount]
+//   stream containers, at offsets given in the stream table (relative to start of data)
+//
+// so that a decoder can read just the streams it needs (e.g. skip SH for a preview).
+
+const uint32_t kContainerMagic = 0x5A505347; // "GSPZ"
+const uint32_t kContainerVersion = 9; // 2: added attribute bits, 3: added codebook, 4: added dictionary, 5: added rans format, 6: added stream-split data, 7: added meshopt filter attributes, 8: added block filters, 9: 32-lane rans
+const uint32_t kContainerStreamsMagic = 0x53535347; // "GSSS"
+
+enum ContainerFilter
+{
+	kContainerFilterNone = 0,
+	kContainerFilterByteDelta,
+	kContainerFilterWordDelta,
+	kContainerFilterXorDelta,
+	kContainerFilterBitShuffle,
+	kContainerFilterPredict,
+	kContainerFilterAuto, // header only: each block has its own filter
+	kContainerFilterCount
+};
+
+enum ContainerBlockFlags
+{
+	kContainerBlockStored = 1 << 0, // block data was not compressible, stored as is (no filter either)
+};
+
+struct ContainerHeader
+{
+	uint32_t magic = kContainerMagic;
+	uint32_t version = kContainerVersion;
+	uint64_t elemCount = 0; // total number of items
+	uint32_t elemStride = 0; // size of each item in bytes
+	uint8_t codecKind = 0; // CompressorKind
+	uint8_t codecFormat = 0; // CompressionFormat
+	uint8_t filter = 0; // ContainerFilter
+	uint8_t reserved0 = 0;
+	int32_t level = 0; // compression level used, informative
+	uint32_t blockElemCount = 0; // items in each block (except last one which can have less)
+	uint32_t blockCount = 0;
+	uint32_t boundsCount = 0; // floats in each of boundsMin / boundsMax
+	uint32_t boundsChunkElems = 0; // 0: one set of bounds for all items; otherwise separate bounds for each chunk of this many items
+	uint32_t attributeCount = 0; // entries in attributeBits
+	uint32_t codebookCount = 0; // entries in the codebook (0: no codebook)
+	uint32_t codebookDim = 0; // floats in each codebook entry
+	uint32_t dictionarySize = 0; // bytes of compressor dictionary (0: none)
+	uint32_t reserved1 = 0;
+};
+static_assert(sizeof(ContainerHeader) == 64, "container header size mismatch");
+
+struct ContainerBlock
+{
+	uint64_t offset = 0; // from start of container
+	uint32_t size = 0; // compressed size
+	uint32_t elemCount = 0; // items in this block
+	uint32_t flags = 0; // ContainerBlockFlags
+	uint32_t filter = 0; // ContainerFilter the block was filtered with: header filter, or any but kContainerFilterAuto when that is the header filter
+};
+static_assert(sizeof(ContainerBlock) == 24, "container block size mismatch");
+
+struct ContainerStreamsHeader
+{
+	uint32_t magic = kContainerStreamsMagic;
+	uint32_t version = kContainerVersion;
+	uint32_t streamCount = 0;
+	uint32_t reserved = 0;
+};
+static_assert(sizeof(ContainerStreamsHeader) == 16, "container streams header size mismatch");
+
+struct ContainerStream
+{
+	uint64_t offset = 0; // from start of data
+	uint64_t size = 0; // of the stream container
+	uint32_t kind = 0; // which attributes are in the stream; defined by the application
+	uint32_t reserved = 0;
+};
+static_assert(sizeof(ContainerStream) == 24, "container stream size mismatch");
+
+// Parsed view into container data in memory (pointers point into the data).
+struct ContainerInfo
+{
+	ContainerHeader header;
+	const float* boundsMin = nullptr;
+	const float* boundsMax = nullptr;
+	const uint8_t* attributeBits = nullptr;
+	const float* codebook = nullptr;
+	const uint8_t* dictionary = nullptr;
+	const ContainerBlock* blocks = nullptr;
+	const uint8_t* data = nullptr;
+	size_t dataSize = 0;
+};
+
+// Parsed view into stream-split data in memory; each stream can be parsed with ContainerParse.
+struct ContainerStreamsInfo
+{
+	ContainerStreamsHeader header;
+	const ContainerStream* streams = nullptr;
+	const uint8_t* data = nullptr;
+	size_t dataSize = 0;
+};
+
+// Size of everything before the first block payload
+size_t ContainerCalcPrefixSize(const ContainerHeader& header);
+
+// Write header, bounds, attribute bits, codebook, dictionary and block table into dst (at least ContainerCalcPrefixSize bytes)
+void ContainerWritePrefix(uint8_t* dst, const ContainerHeader& header, const float* boundsMin, const float* boundsMax, const uint8_t* attributeBits, const float* codebook, const uint8_t* dictionary, const ContainerBlock* blocks);
+
+// Checks header, and that all the blocks are within the data. On success fills info.
+bool ContainerParse(const uint8_t* data, size_t dataSize, ContainerInfo& info);
+
+// Parse just the header + bounds + attribute bits + codebook + dictionary + block table (e.g. read from start of a file
+// of fileSize bytes). Like ContainerParse, checks that all the blocks are within the file.
+bool ContainerParsePrefix(const uint8_t* data, size_t dataSize, size_t fileSize, ContainerHeader& header, std::vector<float>& boundsMin, std::vector<float>& boundsMax, std::vector<uint8_t>& attributeBits, std::vector<float>& codebook, std::vector<uint8_t>& dictionary, std::vector<ContainerBlock>& blocks);
+
+// Size of stream-split header + stream table
+size_t ContainerCalcStreamsPrefixSize(uint32_t streamCount);
+
+// Write stream-split header and stream table into dst (at least ContainerCalcStreamsPrefixSize bytes)
+void ContainerWriteStreamsPrefix(uint8_t* dst, const ContainerStreamsHeader& header, const ContainerStream* streams);
+
+// Checks stream-split header, and that all the streams are within the data. On success fills info.
+bool ContainerParseStreams(const uint8_t* data, size_t dataSize, ContainerStreamsInfo& info);
@@ -0,0 +1,55 @@
+#include "fast_math.h"
+#include "fast_math_kernels.h"
+#include "systeminfo.h"
+
+void FastMath_LinearizeOpacityScale16(float* data, size_t count, size_t stride)
+{
+	FLinearizeOpacityScale<Floats4>(data, count, stride);
+}
+
+void FastMath_UnlinearizeOpacityScale16(float* data, size_t count, size_t stride)
+{
+	FUnlinearizeOpacityScale<Floats4>(data, count, stride);
+}
+
+void FastMath_Exp16(const float* src, float* dst, size_t count)
+{
+	FApplyArray<Floats4, FExp<Floats4>>(src, dst, count);
+}
+
+void FastMath_Log16(const float* src, float* dst, size_t count)
+{
+	FApplyArray<Floats4, FLog<Floats4>>(src, dst, count);
+}
+
+void FastMath_LinearizeOpacityScale(float* data, size_t count, size_t stride)
+{
+	if (SysInfoGetSimdWidth() >= 32)
+		FastMath_LinearizeOpacityScale32(data, count, stride);
+	else
+		FastMath_LinearizeOpacityScale16(data, count, stride);
+}
+
+void FastMath_UnlinearizeOpacityScale(float* data, size_t count, size_t stride)
+{
+	if (SysInfoGetSimdWidth() >= 32)
+		FastMath_UnlinearizeOpacityScale32(data, count, stride);
+	else
+		FastMath_UnlinearizeOpacityScale16(data, count, stride);
+}
+
+void FastMath_Exp(const float* src, float* dst, size_t count)
+{
+	if (SysInfoGetSimdWidth() >= 32)
+		FastMath_Exp32(src, dst, count);
+	else
+		FastMath_Exp16(src, dst, count);
+}
+
+void FastMath_Log(const float* src, float* dst, size_t count)
+{
+	if (SysInfoGetSimdWidth() >= 32)
+		FastMath_Log32(src, dst, count);
+	else
+		FastMath_Log16(src, dst, count);
+}
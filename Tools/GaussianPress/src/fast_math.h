@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+// SIMD polynomial approximations of exp and log (Cephes expf / logf polynomials), for the
+// conversions between the PLY form of splat opacity & scale and the linear form that gets
+// quantized. Error bounds against double precision exp/log, from testing all floats in the ranges
+// (BenchMathKernels checks them on random samples):
+// - exp: relative error kFastExpMaxRelError for inputs in [-87, 88]. Results that would be
+//   denormal are 0 or denormal with a larger error; results over FLT_MAX are +inf.
+// - log: relative error kFastLogMaxRelError where |log(x)| >= 1, absolute error kFastLogMaxAbsError
+//   otherwise, for all positive floats including denormals. 0 gives -inf, negative numbers NaN.
+// NaNs stay NaNs. All SIMD variants give exactly the same results.
+const float kFastExpMaxRelError = 1.0e-7f;
+const float kFastLogMaxRelError = 1.0e-7f;
+const float kFastLogMaxAbsError = 5.0e-8f;
+
+// Opacity & scale of count splats: 4 floats (opacity, scale x, y, z) at data, data + stride bytes etc.
+// Linearize: opacity = sigmoid(opacity), scale = exp(scale)^(1/4), computed as exp(scale / 4).
+// Unlinearize is the inverse: opacity = log(opacity / max(1 - opacity, 1e-6)), scale = 4 * log(scale).
+// These use the widest SIMD variant below that the CPU supports.
+void FastMath_LinearizeOpacityScale(float* data, size_t count, size_t stride);
+void FastMath_UnlinearizeOpacityScale(float* data, size_t count, size_t stride);
+void FastMath_Exp(const float* src, float* dst, size_t count);
+void FastMath_Log(const float* src, float* dst, size_t count);
+
+// Specific variants of the above: 16 bytes (SSE4.1/NEON) and 32 bytes (AVX2; see SysInfoGetSimdWidth)
+void FastMath_LinearizeOpacityScale16(float* data, size_t count, size_t stride);
+void FastMath_UnlinearizeOpacityScale16(float* data, size_t count, size_t stride);
+void FastMath_Exp16(const float* src, float* dst, size_t count);
+void FastMath_Log16(const float* src, float* dst, size_t count);
+void FastMath_LinearizeOpacityScale32(float* data, size_t count, size_t stride);
+void FastMath_UnlinearizeOpacityScale32(float* data, size_t count, size_t stride);
+void FastMath_Exp32(const float* src, float* dst, size_t count);
+void FastMath_Log32(const float* src, float* dst, size_t count);
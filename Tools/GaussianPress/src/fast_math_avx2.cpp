@@ -0,0 +1,48 @@
+#include "fast_math.h"
+#include "fast_math_kernels.h"
+
+#if SIMD_HAS_BYTES32
+
+void FastMath_LinearizeOpacityScale32(float* data, size_t count, size_t stride)
+{
+	FLinearizeOpacityScale<Floats8>(data, count, stride);
+}
+
+void FastMath_UnlinearizeOpacityScale32(float* data, size_t count, size_t stride)
+{
+	FUnlinearizeOpacityScale<Floats8>(data, count, stride);
+}
+
+void FastMath_Exp32(const float* src, float* dst, size_t count)
+{
+	FApplyArray<Floats8, FExp<Floats8>>(src, dst, count);
+}
+
+void FastMath_Log32(const float* src, float* dst, size_t count)
+{
+	FApplyArray<Floats8, FLog<Floats8>>(src, dst, count);
+}
+
+#else
+
+void FastMath_LinearizeOpacityScale32(float* data, size_t count, size_t stride)
+{
+	FastMath_LinearizeOpacityScale16(data, count, stride);
+}
+
+void FastMath_UnlinearizeOpacityScale32(float* data, size_t count, size_t stride)
+{
+	FastMath_UnlinearizeOpacityScale16(data, count, stride);
+}
+
+void FastMath_Exp32(const float* src, float* dst, size_t count)
+{
+	FastMath_Exp16(src, dst, count);
+}
+
+void FastMath_Log32(const float* src, float* dst, size_t count)
+{
+	FastMath_Log16(src, dst, count);
+}
+
+#endif // #if SIMD_HAS_BYTES32
@@ -0,0 +1,333 @@
+#pragma once
+
+// exp / log kernels and the opacity & scale (un)linearization loops of fast_math.h, templated on
+// the float vector type: Floats4 (SSE4.1/NEON) and Floats8 (AVX2, only in translation units
+// compiled with it). Like in simd.h, 32 byte vectors work as two independent 16 byte lanes in
+// shuffles (FZipL/FZipR, FTranspose), and everything here is static.
+//
+// No FMA: each variant does the same float operations in the same order, so the results are the
+// same. That also goes for the one-splat-per-vector remainder loops.
+
+#include "simd.h"
+#include <math.h>
+#include <stdint.h>
+
+// Cephes constants
+const float kExpHi = 88.3762626647949f;
+const float kExpLo = -88.3762626647949f;
+const float kExpOverflow = 88.7228394f; // log(FLT_MAX)
+const float kLog2e = 1.44269504088896341f;
+const float kLn2Hi = 0.693359375f; // ln 2 split in two, for exact range reduction
+const float kLn2Lo = -2.12194440e-4f;
+const float kExpP0 = 1.9875691500e-4f;
+const float kExpP1 = 1.3981999507e-3f;
+const float kExpP2 = 8.3334519073e-3f;
+const float kExpP3 = 4.1665795894e-2f;
+const float kExpP4 = 1.6666665459e-1f;
+const float kExpP5 = 5.0000001201e-1f;
+const float kSqrtHalf = 0.707106781186547524f;
+const float kLogP0 = 7.0376836292e-2f;
+const float kLogP1 = -1.1514610310e-1f;
+const float kLogP2 = 1.1676998740e-1f;
+const float kLogP3 = -1.2420140846e-1f;
+const float kLogP4 = 1.4249322787e-1f;
+const float kLogP5 = -1.6668057665e-1f;
+const float kLogP6 = 2.0000714765e-1f;
+const float kLogP7 = -2.4999993993e-1f;
+const float kLogP8 = 3.3333331174e-1f;
+const float kMinNormal = 1.17549435e-38f;
+const float kDenormScale = 33554432.0f; // 2^25, brings denormals into normal range
+
+template<typename V> static inline V FSet1(float v);
+
+#if CPU_ARCH_X64
+typedef __m128 Floats4;
+template<> inline Floats4 FSet1<Floats4>(float v) { return _mm_set1_ps(v); }
+static inline Floats4 FLoad(const float* p, Floats4) { return _mm_loadu_ps(p); }
+static inline void FStore(float* p, Floats4 v) { _mm_storeu_ps(p, v); }
+static inline Floats4 FAdd(Floats4 a, Floats4 b) { return _mm_add_ps(a, b); }
+static inline Floats4 FSub(Floats4 a, Floats4 b) { return _mm_sub_ps(a, b); }
+static inline Floats4 FMul(Floats4 a, Floats4 b) { return _mm_mul_ps(a, b); }
+static inline Floats4 FDiv(Floats4 a, Floats4 b) { return _mm_div_ps(a, b); }
+static inline Floats4 FMin(Floats4 a, Floats4 b) { return _mm_min_ps(a, b); }
+static inline Floats4 FMax(Floats4 a, Floats4 b) { return _mm_max_ps(a, b); }
+static inline Floats4 FFloor(Floats4 a) { return _mm_floor_ps(a); }
+static inline Floats4 FLess(Floats4 a, Floats4 b) { return _mm_cmplt_ps(a, b); }
+static inline Floats4 FLessEqual(Floats4 a, Floats4 b) { return _mm_cmple_ps(a, b); }
+static inline Floats4 FEqual(Floats4 a, Floats4 b) { return _mm_cmpeq_ps(a, b); }
+static inline Floats4 FIsNaN(Floats4 a) { return _mm_cmpunord_ps(a, a); }
+static inline Floats4 FAnd(Floats4 a, Floats4 b) { return _mm_and_ps(a, b); }
+static inline bool FAllTrue(Floats4 mask) { return _mm_movemask_ps(mask) == 0xF; }
+// mask ? a : b
+static inline Floats4 FSelect(Floats4 mask, Floats4 a, Floats4 b) { return _mm_blendv_ps(b, a, mask); }
+static inline Floats4 FZipL(Floats4 a, Floats4 b) { return _mm_unpacklo_ps(a, b); }
+static inline Floats4 FZipR(Floats4 a, Floats4 b) { return _mm_unpackhi_ps(a, b); }
+// 2^n of integral n
+static inline Floats4 FPow2(Floats4 n) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23)); }
+// exponent (unbiased + 1) and mantissa in [0.5, 1) of normal positive floats
+static inline Floats4 FFrexp(Floats4 x, Floats4& mantissa)
+{
+	const __m128i bits = _mm_castps_si128(x);
+	mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x807FFFFF)), _mm_set1_epi32(0x3F000000)));
+	return _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+}
+static inline Floats4 FLanes4(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+#elif CPU_ARCH_ARM64
+typedef float32x4_t Floats4;
+template<> inline Floats4 FSet1<Floats4>(float v) { return vdupq_n_f32(v); }
+static inline Floats4 FLoad(const float* p, Floats4) { return vld1q_f32(p); }
+static inline void FStore(float* p, Floats4 v) { vst1q_f32(p, v); }
+static inline Floats4 FAdd(Floats4 a, Floats4 b) { return vaddq_f32(a, b); }
+static inline Floats4 FSub(Floats4 a, Floats4 b) { return vsubq_f32(a, b); }
+static inline Floats4 FMul(Floats4 a, Floats4 b) { return vmulq_f32(a, b); }
+static inline Floats4 FDiv(Floats4 a, Floats4 b) { return vdivq_f32(a, b); }
+static inline Floats4 FMin(Floats4 a, Floats4 b) { return vminnmq_f32(a, b); }
+static inline Floats4 FMax(Floats4 a, Floats4 b) { return vmaxnmq_f32(a, b); }
+static inline Floats4 FFloor(Floats4 a) { return vrndmq_f32(a); }
+static inline Floats4 FLess(Floats4 a, Floats4 b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+static inline Floats4 FLessEqual(Floats4 a, Floats4 b) { return vreinterpretq_f32_u32(vcleq_f32(a, b)); }
+static inline Floats4 FEqual(Floats4 a, Floats4 b) { return vreinterpretq_f32_u32(vceqq_f32(a, b)); }
+static inline Floats4 FIsNaN(Floats4 a) { return vreinterpretq_f32_u32(vmvnq_u32(vceqq_f32(a, a))); }
+static inline Floats4 FAnd(Floats4 a, Floats4 b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+static inline bool FAllTrue(Floats4 mask) { return vminvq_u32(vreinterpretq_u32_f32(mask)) != 0; }
+static inline Floats4 FSelect(Floats4 mask, Floats4 a, Floats4 b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+static inline Floats4 FZipL(Floats4 a, Floats4 b) { return vzip1q_f32(a, b); }
+static inline Floats4 FZipR(Floats4 a, Floats4 b) { return vzip2q_f32(a, b); }
+static inline Floats4 FPow2(Floats4 n) { return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23)); }
+static inline Floats4 FFrexp(Floats4 x, Floats4& mantissa)
+{
+	const uint32x4_t bits = vreinterpretq_u32_f32(x);
+	mantissa = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x807FFFFF)), vdupq_n_u32(0x3F000000)));
+	return vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(126)));
+}
+static inline Floats4 FLanes4(float a, float b, float c, float d) { const float v[4] = { a, b, c, d }; return vld1q_f32(v); }
+#endif
+
+// 16 byte lane 0 from p, lane 1 from p + laneStride bytes etc.
+static inline Floats4 FLoadLanes(const uint8_t* p, size_t /*laneStride*/, Floats4 type) { return FLoad((const float*)p, type); }
+static inline void FStoreLanes(uint8_t* p, size_t /*laneStride*/, Floats4 v) { FStore((float*)p, v); }
+
+#if SIMD_HAS_BYTES32
+typedef __m256 Floats8;
+template<> inline Floats8 FSet1<Floats8>(float v) { return _mm256_set1_ps(v); }
+static inline Floats8 FLoad(const float* p, Floats8) { return _mm256_loadu_ps(p); }
+static inline void FStore(float* p, Floats8 v) { _mm256_storeu_ps(p, v); }
+static inline Floats8 FAdd(Floats8 a, Floats8 b) { return _mm256_add_ps(a, b); }
+static inline Floats8 FSub(Floats8 a, Floats8 b) { return _mm256_sub_ps(a, b); }
+static inline Floats8 FMul(Floats8 a, Floats8 b) { return _mm256_mul_ps(a, b); }
+static inline Floats8 FDiv(Floats8 a, Floats8 b) { return _mm256_div_ps(a, b); }
+static inline Floats8 FMin(Floats8 a, Floats8 b) { return _mm256_min_ps(a, b); }
+static inline Floats8 FMax(Floats8 a, Floats8 b) { return _mm256_max_ps(a, b); }
+static inline Floats8 FFloor(Floats8 a) { return _mm256_floor_ps(a); }
+static inline Floats8 FLess(Floats8 a, Floats8 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline Floats8 FLessEqual(Floats8 a, Floats8 b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline Floats8 FEqual(Floats8 a, Floats8 b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+static inline Floats8 FIsNaN(Floats8 a) { return _mm256_cmp_ps(a, a, _CMP_UNORD_Q); }
+static inline Floats8 FAnd(Floats8 a, Floats8 b) { return _mm256_and_ps(a, b); }
+static inline bool FAllTrue(Floats8 mask) { return _mm256_movemask_ps(mask) == 0xFF; }
+static inline Floats8 FSelect(Floats8 mask, Floats8 a, Floats8 b) { return _mm256_blendv_ps(b, a, mask); }
+static inline Floats8 FZipL(Floats8 a, Floats8 b) { return _mm256_unpacklo_ps(a, b); }
+static inline Floats8 FZipR(Floats8 a, Floats8 b) { return _mm256_unpackhi_ps(a, b); }
+static inline Floats8 FPow2(Floats8 n) { return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23)); }
+static inline Floats8 FFrexp(Floats8 x, Floats8& mantissa)
+{
+	const __m256i bits = _mm256_castps_si256(x);
+	mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x807FFFFF)), _mm256_set1_epi32(0x3F000000)));
+	return _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+}
+static inline Floats8 FLoadLanes(const uint8_t* p, size_t laneStride, Floats8)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps((const float*)p)), _mm_loadu_ps((const float*)(p + laneStride)), 1);
+}
+static inline void FStoreLanes(uint8_t* p, size_t laneStride, Floats8 v)
+{
+	_mm_storeu_ps((float*)p, _mm256_castps256_ps128(v));
+	_mm_storeu_ps((float*)(p + laneStride), _mm256_extractf128_ps(v, 1));
+}
+#endif // #if SIMD_HAS_BYTES32
+
+template<typename V>
+static inline void FTranspose(V& a, V& b, V& c, V& d)
+{
+	const V t0 = FZipL(a, c), t1 = FZipR(a, c), t2 = FZipL(b, d), t3 = FZipR(b, d);
+	a = FZipL(t0, t2);
+	b = FZipR(t0, t2);
+	c = FZipL(t1, t3);
+	d = FZipR(t1, t3);
+}
+
+template<typename V>
+static inline V FPoly(V x, V y, float c)
+{
+	return FAdd(FMul(y, x), FSet1<V>(c));
+}
+
+template<typename V>
+static inline V FExp(V v)
+{
+	// exp(x) = 2^n * exp(r), r = x - n * ln 2 within [-ln2/2, ln2/2]
+	const V x = FMax(FMin(v, FSet1<V>(kExpHi)), FSet1<V>(kExpLo));
+	const V n = FFloor(FAdd(FMul(x, FSet1<V>(kLog2e)), FSet1<V>(0.5f)));
+	const V r = FSub(FSub(x, FMul(n, FSet1<V>(kLn2Hi))), FMul(n, FSet1<V>(kLn2Lo)));
+	V y = FSet1<V>(kExpP0);
+	y = FPoly(r, y, kExpP1);
+	y = FPoly(r, y, kExpP2);
+	y = FPoly(r, y, kExpP3);
+	y = FPoly(r, y, kExpP4);
+	y = FPoly(r, y, kExpP5);
+	y = FAdd(FAdd(FMul(FMul(y, r), r), r), FSet1<V>(1.0f));
+	const V res = FSelect(FLess(FSet1<V>(kExpOverflow), v), FSet1<V>(INFINITY), FMul(y, FPow2(n)));
+	return FSelect(FIsNaN(v), v, res);
+}
+
+// log of normal positive finite floats, minus eBias * ln 2 (for denormals scaled up by 2^eBias)
+template<typename V>
+static inline V FLogNormal(V x, V eBias)
+{
+	// log(x) = e * ln 2 + log(m), m within [sqrt(0.5), sqrt(2)]
+	const V one = FSet1<V>(1.0f);
+	V m;
+	V e = FSub(FFrexp(x, m), eBias);
+	const V isSmall = FLess(m, FSet1<V>(kSqrtHalf));
+	e = FSelect(isSmall, FSub(e, one), e);
+	m = FSub(FSelect(isSmall, FAdd(m, m), m), one);
+
+	const V z = FMul(m, m);
+	V y = FSet1<V>(kLogP0);
+	y = FPoly(m, y, kLogP1);
+	y = FPoly(m, y, kLogP2);
+	y = FPoly(m, y, kLogP3);
+	y = FPoly(m, y, kLogP4);
+	y = FPoly(m, y, kLogP5);
+	y = FPoly(m, y, kLogP6);
+	y = FPoly(m, y, kLogP7);
+	y = FPoly(m, y, kLogP8);
+	y = FMul(FMul(y, m), z);
+	y = FAdd(y, FMul(e, FSet1<V>(kLn2Lo)));
+	y = FSub(y, FMul(z, FSet1<V>(0.5f)));
+	return FAdd(FAdd(m, y), FMul(e, FSet1<V>(kLn2Hi)));
+}
+
+template<typename V>
+static inline V FLog(V x)
+{
+	// zero, negative, denormal, inf & NaN are rare; handled only when the vector has any
+	const V zero = FSet1<V>(0.0f);
+	const V isNormal = FAnd(FLessEqual(FSet1<V>(kMinNormal), x), FLess(x, FSet1<V>(INFINITY)));
+	if (FAllTrue(isNormal))
+		return FLogNormal(x, zero);
+
+	const V isDenormal = FLess(x, FSet1<V>(kMinNormal));
+	const V eBias = FSelect(isDenormal, FSet1<V>(25.0f), zero);
+	V res = FLogNormal(FSelect(isDenormal, FMul(x, FSet1<V>(kDenormScale)), x), eBias);
+	res = FSelect(FEqual(x, FSet1<V>(INFINITY)), x, res);
+	res = FSelect(FEqual(x, zero), FSet1<V>(-INFINITY), res);
+	res = FSelect(FLess(x, zero), FSet1<V>(NAN), res);
+	return FSelect(FIsNaN(x), x, res);
+}
+
+// Tail values go through a zero padded vector
+template<typename V, V (*Func)(V)>
+static void FApplyArray(const float* src, float* dst, size_t count)
+{
+	const size_t kWidth = sizeof(V) / sizeof(float);
+	size_t i = 0;
+	for (; i + kWidth <= count; i += kWidth)
+		FStore(dst + i, Func(FLoad(src + i, V())));
+	if (i == count)
+		return;
+	float tmp[kWidth] = {};
+	for (size_t j = i; j < count; ++j)
+		tmp[j - i] = src[j];
+	FStore(tmp, Func(FLoad(tmp, V())));
+	for (size_t j = i; j < count; ++j)
+		dst[j] = tmp[j - i];
+}
+
+// Splats are processed 4 per 16 byte lane, transposed so that each vector has one attribute of
+// them (lane k has splats [4k, 4k+4)); the remaining ones take a Floats4 each, where the opacity
+// element differs from the three scale ones.
+template<typename V>
+static inline void FLoadSplats(const uint8_t* ptr, size_t stride, V& o, V& x, V& y, V& z)
+{
+	const size_t laneStride = stride * 4;
+	o = FLoadLanes(ptr, laneStride, V());
+	x = FLoadLanes(ptr + stride, laneStride, V());
+	y = FLoadLanes(ptr + stride * 2, laneStride, V());
+	z = FLoadLanes(ptr + stride * 3, laneStride, V());
+	FTranspose(o, x, y, z);
+}
+
+template<typename V>
+static inline void FStoreSplats(uint8_t* ptr, size_t stride, V o, V x, V y, V z)
+{
+	const size_t laneStride = stride * 4;
+	FTranspose(o, x, y, z);
+	FStoreLanes(ptr, laneStride, o);
+	FStoreLanes(ptr + stride, laneStride, x);
+	FStoreLanes(ptr + stride * 2, laneStride, y);
+	FStoreLanes(ptr + stride * 3, laneStride, z);
+}
+
+template<typename V>
+static void FLinearizeOpacityScale(float* data, size_t count, size_t stride)
+{
+	// sigmoid(o) = 1 / (1 + exp(-o)); exp(s)^(1/4) = exp(s / 4)
+	const size_t kSplats = sizeof(V) / sizeof(float);
+	const V one = FSet1<V>(1.0f);
+	const V quarter = FSet1<V>(0.25f);
+	const V minusOne = FSet1<V>(-1.0f);
+	uint8_t* ptr = (uint8_t*)data;
+	size_t i = 0;
+	for (; i + kSplats <= count; i += kSplats, ptr += stride * kSplats)
+	{
+		V o, x, y, z;
+		FLoadSplats(ptr, stride, o, x, y, z);
+		o = FDiv(one, FAdd(one, FExp(FMul(o, minusOne))));
+		x = FExp(FMul(x, quarter));
+		y = FExp(FMul(y, quarter));
+		z = FExp(FMul(z, quarter));
+		FStoreSplats(ptr, stride, o, x, y, z);
+	}
+	const Floats4 one4 = FSet1<Floats4>(1.0f);
+	const Floats4 mul = FLanes4(-1.0f, 0.25f, 0.25f, 0.25f);
+	const Floats4 isOpacity = FEqual(mul, FSet1<Floats4>(-1.0f));
+	for (; i < count; ++i, ptr += stride)
+	{
+		const Floats4 e = FExp(FMul(FLoad((float*)ptr, Floats4()), mul));
+		FStore((float*)ptr, FSelect(isOpacity, FDiv(one4, FAdd(one4, e)), e));
+	}
+}
+
+template<typename V>
+static void FUnlinearizeOpacityScale(float* data, size_t count, size_t stride)
+{
+	// logit(o) = log(o / (1 - o)); log(s^4) = 4 * log(s)
+	const size_t kSplats = sizeof(V) / sizeof(float);
+	const V one = FSet1<V>(1.0f);
+	const V four = FSet1<V>(4.0f);
+	const V minDenom = FSet1<V>(1.0e-6f);
+	uint8_t* ptr = (uint8_t*)data;
+	size_t i = 0;
+	for (; i + kSplats <= count; i += kSplats, ptr += stride * kSplats)
+	{
+		V o, x, y, z;
+		FLoadSplats(ptr, stride, o, x, y, z);
+		o = FLog(FDiv(o, FMax(FSub(one, o), minDenom)));
+		x = FMul(FLog(x), four);
+		y = FMul(FLog(y), four);
+		z = FMul(FLog(z), four);
+		FStoreSplats(ptr, stride, o, x, y, z);
+	}
+	const Floats4 one4 = FSet1<Floats4>(1.0f);
+	const Floats4 minDenom4 = FSet1<Floats4>(1.0e-6f);
+	const Floats4 mul = FLanes4(1.0f, 4.0f, 4.0f, 4.0f);
+	const Floats4 isOpacity = FEqual(mul, one4);
+	for (; i < count; ++i, ptr += stride)
+	{
+		// opacity gets multiplied by 1, same as not multiplying
+		const Floats4 v = FLoad((float*)ptr, Floats4());
+		const Floats4 x = FSelect(isOpacity, FDiv(v, FMax(FSub(one4, v), minDenom4)), v);
+		FStore((float*)ptr, FMul(FLog(x), mul));
+	}
+}
@@ -1,13 +1,16 @@
 #include "filters.h"
 #include "simd.h"
+#include "systeminfo.h"
 #include <assert.h>
 #include <string.h>
+#include <algorithm>
 
-const size_t kMaxChannels = 256;
 static_assert(kMaxChannels >= 16, "max channels can't be lower than simd width");
 
 
-// Transpose NxM byte matrix, with faster code paths for rows=16, cols=multiple-of-16 case.
+// Transpose 16xN byte matrices, for any N up to kMaxChannels: full 16x16 SIMD tiles, and when N
+// is not a multiple of 16 the last tile overlaps the previous one (the overlapping part just
+// gets transposed twice). Only N < 16 goes through a padded temporary tile.
 // Largely based on https://fgiesen.wordpress.com/2013/07/09/simd-transposes-1/ and
 // https://fgiesen.wordpress.com/2013/08/29/simd-transposes-2/
 static void EvenOddInterleave16(const Bytes16* a, Bytes16* b, int astride = 1)
@@ -27,30 +30,55 @@ static void Transpose16x16(const Bytes16* a, Bytes16* b, int astride = 1)
     EvenOddInterleave16(tmp2, tmp1);
     EvenOddInterleave16(tmp1, b);
 }
-static void Transpose(const uint8_t* a, uint8_t* b, int cols, int rows)
+
+// 16 items of N bytes each -> N vectors of 16 bytes each
+static void TransposeItemsToChannels(const uint8_t* src, size_t channels, Bytes16* dst)
 {
-    if (rows == 16 && ((cols % 16) == 0))
+    if (channels < 16)
     {
-        int blocks = cols / rows;
-        for (int i = 0; i < blocks; ++i)
-        {
-            Transpose16x16(((const Bytes16*)a) + i, ((Bytes16*)b) + i * 16, blocks);
-        }
+        uint8_t tmp[16 * 16] = {};
+        for (int r = 0; r < 16; ++r)
+            memcpy(tmp + r * 16, src + r * channels, channels);
+        Bytes16 tmpT[16];
+        Transpose16x16((const Bytes16*)tmp, tmpT);
+        memcpy(dst, tmpT, channels * 16);
+        return;
     }
-    else
+    for (size_t ch = 0; ch < channels; ch += 16)
     {
-        for (int j = 0; j < rows; ++j)
-        {
-            for (int i = 0; i < cols; ++i)
-            {
-                b[i * rows + j] = a[j * cols + i];
-            }
-        }
+        size_t col = std::min(ch, channels - 16);
+        Bytes16 rows[16];
+        for (int r = 0; r < 16; ++r)
+            rows[r] = SimdLoad(src + r * channels + col);
+        Transpose16x16(rows, dst + col);
+    }
+}
+
+// N vectors of 16 bytes each -> 16 items of N bytes each
+static void TransposeChannelsToItems(const Bytes16* src, size_t channels, uint8_t* dst)
+{
+    if (channels < 16)
+    {
+        Bytes16 tmp[16] = {};
+        memcpy(tmp, src, channels * 16);
+        Bytes16 tmpT[16];
+        Transpose16x16(tmp, tmpT);
+        for (int r = 0; r < 16; ++r)
+            memcpy(dst + r * channels, &tmpT[r], channels);
+        return;
+    }
+    for (size_t ch = 0; ch < channels; ch += 16)
+    {
+        size_t col = std::min(ch, channels - 16);
+        Bytes16 rows[16];
+        Transpose16x16(src + col, rows);
+        for (int r = 0; r < 16; ++r)
+            SimdStore(dst + r * channels + col, rows[r]);
     }
 }
 
 // Fetch 16 N-sized items, transpose, SIMD delta, write N separate 16-sized items
-void Filter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+void Filter_ByteDelta16(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
 {
     uint8_t* dstPtr = dst;
     int64_t ip = 0;
@@ -60,15 +88,12 @@ void Filter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t
     Bytes16 prev[kMaxChannels] = {};
     for (; ip < int64_t(dataElems) - 15; ip += 16)
     {
-        // fetch 16 data items
-        uint8_t curr[kMaxChannels * 16];
-        memcpy(curr, srcPtr, channels * 16);
-        srcPtr += channels * 16;
-        // transpose so we have 16 bytes for each channel
+        // fetch 16 data items, transpose so we have 16 bytes for each channel
         Bytes16 currT[kMaxChannels];
-        Transpose(curr, (uint8_t*)currT, channels, 16);
+        TransposeItemsToChannels(srcPtr, channels, currT);
+        srcPtr += channels * 16;
         // delta within each channel, store
-        for (int ich = 0; ich < channels; ++ich)
+        for (size_t ich = 0; ich < channels; ++ich)
         {
             Bytes16 v = currT[ich];
             Bytes16 delta = SimdSub(v, SimdConcat<15>(v, prev[ich]));
@@ -81,11 +106,11 @@ void Filter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t
     if (ip < int64_t(dataElems))
     {
         uint8_t prev1[kMaxChannels];
-        for (int ich = 0; ich < channels; ++ich)
+        for (size_t ich = 0; ich < channels; ++ich)
             prev1[ich] = SimdGetLane<15>(prev[ich]);
         for (; ip < int64_t(dataElems); ip++)
         {
-            for (int ich = 0; ich < channels; ++ich)
+            for (size_t ich = 0; ich < channels; ++ich)
             {
                 uint8_t v = *srcPtr;
                 srcPtr++;
@@ -98,7 +123,7 @@ void Filter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t
 }
 
 // Fetch 16b from N streams, prefix sum SIMD undelta, transpose, sequential write 16xN chunk.
-void UnFilter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+void UnFilter_ByteDelta16(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
 {
     uint8_t* dstPtr = dst;
     int64_t ip = 0;
@@ -110,7 +135,7 @@ void UnFilter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_
     {
         // fetch 16 bytes from each channel, prefix-sum un-delta
         const uint8_t* srcPtr = src + ip;
-        for (int ich = 0; ich < channels; ++ich)
+        for (size_t ich = 0; ich < channels; ++ich)
         {
             Bytes16 v = SimdLoad(srcPtr);
             // un-delta via prefix sum
@@ -118,12 +143,8 @@ void UnFilter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_
             srcPtr += dataElems;
         }
 
-        // now transpose 16xChannels matrix
-        uint8_t currT[kMaxChannels * 16];
-        Transpose((const uint8_t*)curr, currT, 16, channels);
-
-        // and store into destination
-        memcpy(dstPtr, currT, 16 * channels);
+        // now transpose 16xChannels matrix straight into destination
+        TransposeChannelsToItems(curr, channels, dstPtr);
         dstPtr += 16 * channels;
     }
 
@@ -131,12 +152,12 @@ void UnFilter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_
     if (ip < int64_t(dataElems))
     {
         uint8_t curr1[kMaxChannels];
-        for (int ich = 0; ich < channels; ++ich)
+        for (size_t ich = 0; ich < channels; ++ich)
             curr1[ich] = SimdGetLane<15>(curr[ich]);
         for (; ip < int64_t(dataElems); ip++)
         {
             const uint8_t* srcPtr = src + ip;
-            for (int ich = 0; ich < channels; ++ich)
+            for (size_t ich = 0; ich < channels; ++ich)
             {
                 uint8_t v = *srcPtr + curr1[ich];
                 curr1[ich] = v;
@@ -147,3 +168,253 @@ void UnFilter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_
         }
     }
 }
+
+// Residual filters: 16 items at a time are transposed into channels (same as byte delta), and each
+// channel (or channel pair for 16-bit words) is predicted from the same channel of the previous item.
+// Op has EncodeByte/DecodeByte for one channel and EncodeWord/DecodeWord for a low+high byte channel
+// pair; prev is the previous 16 items of the channel(s) (original values), updated as items go.
+// Leftover items past the last multiple of 16 go through a zero padded group.
+template<typename Op>
+static void Filter_Residual(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    Bytes16 prev[kMaxChannels] = {};
+    Bytes16 currT[kMaxChannels];
+    for (size_t ip = 0; ip < dataElems; ip += 16)
+    {
+        const size_t count = std::min<size_t>(16, dataElems - ip);
+        if (count == 16)
+            TransposeItemsToChannels(src + ip * channels, channels, currT);
+        else
+        {
+            uint8_t tmp[16 * kMaxChannels] = {};
+            memcpy(tmp, src + ip * channels, count * channels);
+            TransposeItemsToChannels(tmp, channels, currT);
+        }
+        size_t ich = 0;
+        for (; ich + 1 < channels; ich += 2)
+            Op::EncodeWord(currT[ich], currT[ich + 1], prev[ich], prev[ich + 1]);
+        if (ich < channels)
+            Op::EncodeByte(currT[ich], prev[ich]);
+        for (ich = 0; ich < channels; ++ich)
+        {
+            if (count == 16)
+                SimdStore(dst + dataElems * ich + ip, currT[ich]);
+            else
+                memcpy(dst + dataElems * ich + ip, &currT[ich], count);
+        }
+    }
+}
+
+template<typename Op>
+static void UnFilter_Residual(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    Bytes16 prev[kMaxChannels] = {};
+    Bytes16 currT[kMaxChannels];
+    for (size_t ip = 0; ip < dataElems; ip += 16)
+    {
+        const size_t count = std::min<size_t>(16, dataElems - ip);
+        for (size_t ich = 0; ich < channels; ++ich)
+        {
+            if (count == 16)
+                currT[ich] = SimdLoad(src + dataElems * ich + ip);
+            else
+            {
+                currT[ich] = SimdZero();
+                memcpy(&currT[ich], src + dataElems * ich + ip, count);
+            }
+        }
+        size_t ich = 0;
+        for (; ich + 1 < channels; ich += 2)
+            Op::DecodeWord(currT[ich], currT[ich + 1], prev[ich], prev[ich + 1]);
+        if (ich < channels)
+            Op::DecodeByte(currT[ich], prev[ich]);
+        if (count == 16)
+            TransposeChannelsToItems(currT, channels, dst + ip * channels);
+        else
+        {
+            uint8_t tmp[16 * kMaxChannels];
+            TransposeChannelsToItems(currT, channels, tmp);
+            memcpy(dst + ip * channels, tmp, count * channels);
+        }
+    }
+}
+
+struct ByteDeltaOp
+{
+    static void EncodeByte(Bytes16& v, Bytes16& prev)
+    {
+        const Bytes16 curr = v;
+        v = SimdSub(curr, SimdConcatLast(curr, prev));
+        prev = curr;
+    }
+    static void DecodeByte(Bytes16& v, Bytes16& prev)
+    {
+        v = SimdAdd(SimdPrefixSum(v), SimdBroadcastLast(prev));
+        prev = v;
+    }
+};
+
+// Words of 16 items as two vectors of 8 each, and back
+static void BytePlanesToWords(Bytes16 lo, Bytes16 hi, Bytes16& w0, Bytes16& w1)
+{
+    w0 = SimdInterleaveL(lo, hi);
+    w1 = SimdInterleaveR(lo, hi);
+}
+
+struct WordDeltaOp : ByteDeltaOp
+{
+    static void EncodeWord(Bytes16& lo, Bytes16& hi, Bytes16& prevLo, Bytes16& prevHi)
+    {
+        Bytes16 w0, w1;
+        BytePlanesToWords(lo, hi, w0, w1);
+        const Bytes16 p1 = SimdInterleaveR(prevLo, prevHi); // previous items 8..15
+        prevLo = lo;
+        prevHi = hi;
+        const Bytes16 d0 = SimdSub16(w0, SimdConcat<14>(w0, p1));
+        const Bytes16 d1 = SimdSub16(w1, SimdConcat<14>(w1, w0));
+        SimdDeinterleave(d0, d1, lo, hi);
+    }
+    static void DecodeWord(Bytes16& lo, Bytes16& hi, Bytes16& prevLo, Bytes16& prevHi)
+    {
+        Bytes16 w0, w1;
+        BytePlanesToWords(lo, hi, w0, w1);
+        const Bytes16 p1 = SimdInterleaveR(prevLo, prevHi); // previous items 8..15
+        w0 = SimdAdd16(SimdPrefixSum16(w0), SimdBroadcastLast16(p1));
+        w1 = SimdAdd16(SimdPrefixSum16(w1), SimdBroadcastLast16(w0));
+        SimdDeinterleave(w0, w1, lo, hi);
+        prevLo = lo;
+        prevHi = hi;
+    }
+};
+
+struct XorDeltaOp
+{
+    static void EncodeByte(Bytes16& v, Bytes16& prev)
+    {
+        const Bytes16 curr = v;
+        v = SimdXor(curr, SimdConcatLast(curr, prev));
+        prev = curr;
+    }
+    static void DecodeByte(Bytes16& v, Bytes16& prev)
+    {
+        v = SimdXor(SimdPrefixXor(v), SimdBroadcastLast(prev));
+        prev = v;
+    }
+    static void EncodeWord(Bytes16& lo, Bytes16& hi, Bytes16& prevLo, Bytes16& prevHi)
+    {
+        EncodeByte(lo, prevLo);
+        EncodeByte(hi, prevHi);
+    }
+    static void DecodeWord(Bytes16& lo, Bytes16& hi, Bytes16& prevLo, Bytes16& prevHi)
+    {
+        DecodeByte(lo, prevLo);
+        DecodeByte(hi, prevHi);
+    }
+};
+
+struct PredictOp : ByteDeltaOp
+{
+    static void EncodeWord(Bytes16& lo, Bytes16& hi, Bytes16& prevLo, Bytes16& prevHi)
+    {
+        Bytes16 w0, w1;
+        BytePlanesToWords(lo, hi, w0, w1);
+        const Bytes16 p1 = SimdInterleaveR(prevLo, prevHi); // previous items 8..15
+        prevLo = lo;
+        prevHi = hi;
+        const Bytes16 d0 = SimdZigZag16(SimdSub16(w0, SimdConcat<14>(w0, p1)));
+        const Bytes16 d1 = SimdZigZag16(SimdSub16(w1, SimdConcat<14>(w1, w0)));
+        SimdDeinterleave(d0, d1, lo, hi);
+    }
+    static void DecodeWord(Bytes16& lo, Bytes16& hi, Bytes16& prevLo, Bytes16& prevHi)
+    {
+        Bytes16 w0, w1;
+        BytePlanesToWords(lo, hi, w0, w1);
+        const Bytes16 p1 = SimdInterleaveR(prevLo, prevHi); // previous items 8..15
+        w0 = SimdAdd16(SimdPrefixSum16(SimdUnZigZag16(w0)), SimdBroadcastLast16(p1));
+        w1 = SimdAdd16(SimdPrefixSum16(SimdUnZigZag16(w1)), SimdBroadcastLast16(w0));
+        SimdDeinterleave(w0, w1, lo, hi);
+        prevLo = lo;
+        prevHi = hi;
+    }
+};
+
+void Filter_WordDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems) { Filter_Residual<WordDeltaOp>(src, dst, channels, dataElems); }
+void UnFilter_WordDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems) { UnFilter_Residual<WordDeltaOp>(src, dst, channels, dataElems); }
+void Filter_XorDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems) { Filter_Residual<XorDeltaOp>(src, dst, channels, dataElems); }
+void UnFilter_XorDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems) { UnFilter_Residual<XorDeltaOp>(src, dst, channels, dataElems); }
+void Filter_Predict(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems) { Filter_Residual<PredictOp>(src, dst, channels, dataElems); }
+void UnFilter_Predict(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems) { UnFilter_Residual<PredictOp>(src, dst, channels, dataElems); }
+
+// Each group of 16 items adds 2 bytes (16 bits) to each of 8 bit planes of each channel
+void Filter_BitShuffle(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    const size_t groups = dataElems / 16;
+    const size_t planeSize = groups * 2;
+    Bytes16 currT[kMaxChannels];
+    for (size_t ig = 0; ig < groups; ++ig)
+    {
+        TransposeItemsToChannels(src + ig * 16 * channels, channels, currT);
+        for (size_t ich = 0; ich < channels; ++ich)
+        {
+            uint8_t* dstPtr = dst + dataElems * ich + ig * 2;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                const uint16_t plane = uint16_t(SimdBitPlane(currT[ich], bit));
+                memcpy(dstPtr + bit * planeSize, &plane, 2);
+            }
+        }
+    }
+    for (size_t ip = groups * 16; ip < dataElems; ++ip)
+    {
+        for (size_t ich = 0; ich < channels; ++ich)
+            dst[dataElems * ich + ip] = src[ip * channels + ich];
+    }
+}
+
+void UnFilter_BitShuffle(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    const size_t groups = dataElems / 16;
+    const size_t planeSize = groups * 2;
+    Bytes16 currT[kMaxChannels];
+    for (size_t ig = 0; ig < groups; ++ig)
+    {
+        for (size_t ich = 0; ich < channels; ++ich)
+        {
+            const uint8_t* srcPtr = src + dataElems * ich + ig * 2;
+            Bytes16 v = SimdZero();
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                uint16_t plane;
+                memcpy(&plane, srcPtr + bit * planeSize, 2);
+                v = SimdXor(v, SimdFromBitPlane(plane, bit));
+            }
+            currT[ich] = v;
+        }
+        TransposeChannelsToItems(currT, channels, dst + ig * 16 * channels);
+    }
+    for (size_t ip = groups * 16; ip < dataElems; ++ip)
+    {
+        for (size_t ich = 0; ich < channels; ++ich)
+            dst[ip * channels + ich] = src[dataElems * ich + ip];
+    }
+}
+
+void Filter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    switch (SysInfoGetSimdWidth())
+    {
+    case 64: Filter_ByteDelta64(src, dst, channels, dataElems); break;
+    case 32: Filter_ByteDelta32(src, dst, channels, dataElems); break;
+    default: Filter_ByteDelta16(src, dst, channels, dataElems); break;
+    }
+}
+
+void UnFilter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    switch (SysInfoGetSimdWidth())
+    {
+    case 64: UnFilter_ByteDelta64(src, dst, channels, dataElems); break;
+    case 32: UnFilter_ByteDelta32(src, dst, channels, dataElems); break;
+    default: UnFilter_ByteDelta16(src, dst, channels, dataElems); break;
+    }
+}
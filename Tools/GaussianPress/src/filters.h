@@ -3,7 +3,37 @@
 #include <stdint.h>
 #include <stddef.h>
 
-// Process 16xN bytes at once,
+const size_t kMaxChannels = 256;
+
+// Process 16xN bytes at once (any N up to kMaxChannels),
 // based on filter "H" from https://aras-p.info/blog/2023/03/01/Float-Compression-7-More-Filtering-Optimization/
+// Uses the widest SIMD variant below that the CPU supports.
 void Filter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
 void UnFilter_ByteDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+
+// Specific SIMD widths of the above: 16 (SSE4.1/NEON), 32 (AVX2), 64 (AVX-512; see SysInfoGetSimdWidth).
+void Filter_ByteDelta16(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void UnFilter_ByteDelta16(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void Filter_ByteDelta32(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void UnFilter_ByteDelta32(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void Filter_ByteDelta64(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void UnFilter_ByteDelta64(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+
+// Same layout as byte delta (each channel of all items one after another), 16 items at once with SSE4.1/NEON:
+// - WordDelta: channel pairs are 16-bit words (e.g. 16 bit quantized fields), with delta from previous item
+//   done on whole words, so that carries do not leak into the high byte delta.
+// - XorDelta: each byte XORed with the previous item's byte.
+// - Predict: residual of 16-bit words from the previous item (its spatial neighbor, since items are in
+//   Morton order), zig-zag coded so that small negative residuals have zero high bytes too.
+// A last odd channel of word based filters uses byte delta.
+void Filter_WordDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void UnFilter_WordDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void Filter_XorDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void UnFilter_XorDelta(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void Filter_Predict(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void UnFilter_Predict(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+
+// Bit-plane transpose: for each channel, bit 0 of all items, then bit 1 etc. (items past
+// the last multiple of 16 are stored as is, after the bit planes of their channel)
+void Filter_BitShuffle(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
+void UnFilter_BitShuffle(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems);
@@ -0,0 +1,34 @@
+#include "filters.h"
+#include "filters_wide.h"
+
+#if SIMD_HAS_BYTES64
+
+void Filter_ByteDelta64(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    if (channels < 16)
+        Filter_ByteDelta16(src, dst, channels, dataElems);
+    else
+        Filter_ByteDeltaWide<Bytes64, Simd64LoadLanes>(src, dst, channels, dataElems);
+}
+
+void UnFilter_ByteDelta64(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    if (channels < 16)
+        UnFilter_ByteDelta16(src, dst, channels, dataElems);
+    else
+        UnFilter_ByteDeltaWide<Bytes64, Simd64Load>(src, dst, channels, dataElems);
+}
+
+#else
+
+void Filter_ByteDelta64(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    Filter_ByteDelta16(src, dst, channels, dataElems);
+}
+
+void UnFilter_ByteDelta64(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    UnFilter_ByteDelta16(src, dst, channels, dataElems);
+}
+
+#endif // #if SIMD_HAS_BYTES64
@@ -0,0 +1,153 @@
+#pragma once
+
+// Byte delta filter kernels for vectors wider than 16 bytes (Bytes32, Bytes64).
+// Only to be included from translation units compiled with the matching instruction set.
+//
+// A W-byte vector is treated as W/16 independent 16-byte lanes, and each lane goes through
+// the same 16x16 transpose as the 16-wide code path. Lane k of a vector holds items
+// [16k, 16k+16), so after the transpose each vector holds W consecutive bytes of one channel.
+// Channels are processed 16 at a time; when the count is not a multiple of 16 the last tile
+// overlaps the previous one, same as in filters.cpp. Channel count has to be at least 16.
+
+#include "filters.h"
+#include "simd.h"
+#include <assert.h>
+#include <algorithm>
+
+template<typename V>
+static void EvenOddInterleaveLanes(const V* a, V* b)
+{
+    int bidx = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        b[bidx] = SimdInterleaveL(a[i], a[i + 8]); bidx++;
+        b[bidx] = SimdInterleaveR(a[i], a[i + 8]); bidx++;
+    }
+}
+
+template<typename V>
+static void TransposeLanes16x16(const V* a, V* b)
+{
+    V tmp1[16], tmp2[16];
+    EvenOddInterleaveLanes(a, tmp1);
+    EvenOddInterleaveLanes(tmp1, tmp2);
+    EvenOddInterleaveLanes(tmp2, tmp1);
+    EvenOddInterleaveLanes(tmp1, b);
+}
+
+template<typename V>
+static uint8_t SimdGetLastByte(V x)
+{
+    uint8_t tmp[sizeof(V)];
+    SimdStore(tmp, x);
+    return tmp[sizeof(V) - 1];
+}
+
+// Fetch W N-sized items, transpose, SIMD delta, write N separate W-sized items
+template<typename V, V (*LoadLanes)(const void*, size_t)>
+static void Filter_ByteDeltaWide(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    const int kWidth = sizeof(V);
+    assert(channels >= 16 && channels <= kMaxChannels);
+    uint8_t* dstPtr = dst;
+    int64_t ip = 0;
+
+    const uint8_t* srcPtr = src;
+    // simd loop
+    V prev[kMaxChannels] = {};
+    for (; ip < int64_t(dataElems) - (kWidth - 1); ip += kWidth)
+    {
+        // fetch 16 bytes of 16 items into each lane, transpose so we have W bytes for each channel
+        V currT[kMaxChannels];
+        for (size_t ch = 0; ch < channels; ch += 16)
+        {
+            size_t col = std::min(ch, channels - 16);
+            V rows[16];
+            for (int r = 0; r < 16; ++r)
+                rows[r] = LoadLanes(srcPtr + r * channels + col, channels * 16);
+            TransposeLanes16x16(rows, currT + col);
+        }
+        // delta within each channel, store
+        for (size_t ich = 0; ich < channels; ++ich)
+        {
+            V v = currT[ich];
+            V delta = SimdSub(v, SimdConcatLast(v, prev[ich]));
+            SimdStore(dstPtr + dataElems * ich, delta);
+            prev[ich] = v;
+        }
+        srcPtr += channels * kWidth;
+        dstPtr += kWidth;
+    }
+    // any remaining leftover
+    if (ip < int64_t(dataElems))
+    {
+        uint8_t prev1[kMaxChannels];
+        for (size_t ich = 0; ich < channels; ++ich)
+            prev1[ich] = SimdGetLastByte(prev[ich]);
+        for (; ip < int64_t(dataElems); ip++)
+        {
+            for (size_t ich = 0; ich < channels; ++ich)
+            {
+                uint8_t v = *srcPtr;
+                srcPtr++;
+                dstPtr[dataElems * ich] = v - prev1[ich];
+                prev1[ich] = v;
+            }
+            dstPtr++;
+        }
+    }
+}
+
+// Fetch W bytes from N streams, prefix sum SIMD undelta, transpose, write WxN chunk.
+template<typename V, V (*Load)(const void*)>
+static void UnFilter_ByteDeltaWide(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems)
+{
+    const int kWidth = sizeof(V);
+    assert(channels >= 16 && channels <= kMaxChannels);
+    uint8_t* dstPtr = dst;
+    int64_t ip = 0;
+
+    // simd loop: fetch W bytes from each stream
+    V curr[kMaxChannels] = {};
+    for (; ip < int64_t(dataElems) - (kWidth - 1); ip += kWidth)
+    {
+        // fetch W bytes from each channel, prefix-sum un-delta
+        const uint8_t* srcPtr = src + ip;
+        for (size_t ich = 0; ich < channels; ++ich)
+        {
+            V v = Load(srcPtr);
+            curr[ich] = SimdAdd(SimdPrefixSum(v), SimdBroadcastLast(curr[ich]));
+            srcPtr += dataElems;
+        }
+        // transpose back so that each lane has 16 bytes of one item, store
+        for (size_t ch = 0; ch < channels; ch += 16)
+        {
+            size_t col = std::min(ch, channels - 16);
+            V rows[16];
+            TransposeLanes16x16(curr + col, rows);
+            for (int r = 0; r < 16; ++r)
+                SimdStoreLanes(dstPtr + r * channels + col, channels * 16, rows[r]);
+        }
+        dstPtr += kWidth * channels;
+    }
+
+    // any remaining leftover
+    if (ip < int64_t(dataElems))
+    {
+        uint8_t curr1[kMaxChannels];
+        for (size_t ich = 0; ich < channels; ++ich)
+            curr1[ich] = SimdGetLastByte(curr[ich]);
+        for (; ip < int64_t(dataElems); ip++)
+        {
+            const uint8_t* srcPtr = src + ip;
+            for (size_t ich = 0; ich < channels; ++ich)
+            {
+                uint8_t v = *srcPtr + curr1[ich];
+                curr1[ich] = v;
+                *dstPtr = v;
+                srcPtr += dataElems;
+                dstPtr += 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,213 @@
+#include "kmeans.h"
+#include "parallel.h"
+#include "random.h"
+#include "simd.h"
+
+#include <float.h>
+#include <algorithm>
+#include <vector>
+
+#if CPU_ARCH_X64
+typedef __m128 Float4;
+static inline Float4 Float4Zero() { return _mm_setzero_ps(); }
+static inline Float4 Float4Set1(float v) { return _mm_set1_ps(v); }
+static inline Float4 Float4Load(const float* ptr) { return _mm_loadu_ps(ptr); }
+static inline void Float4Store(float* ptr, Float4 x) { _mm_storeu_ps(ptr, x); }
+static inline Float4 Float4MulAdd(Float4 acc, Float4 a, Float4 b) { return _mm_add_ps(acc, _mm_mul_ps(a, b)); }
+#elif CPU_ARCH_ARM64
+typedef float32x4_t Float4;
+static inline Float4 Float4Zero() { return vdupq_n_f32(0.0f); }
+static inline Float4 Float4Set1(float v) { return vdupq_n_f32(v); }
+static inline Float4 Float4Load(const float* ptr) { return vld1q_f32(ptr); }
+static inline void Float4Store(float* ptr, Float4 x) { vst1q_f32(ptr, x); }
+static inline Float4 Float4MulAdd(Float4 acc, Float4 a, Float4 b) { return vfmaq_f32(acc, a, b); }
+#else
+struct Float4 { float v[4]; };
+static inline Float4 Float4Zero() { return { {0, 0, 0, 0} }; }
+static inline Float4 Float4Set1(float v) { return { {v, v, v, v} }; }
+static inline Float4 Float4Load(const float* ptr) { return { {ptr[0], ptr[1], ptr[2], ptr[3]} }; }
+static inline void Float4Store(float* ptr, Float4 x) { for (int i = 0; i < 4; ++i) ptr[i] = x.v[i]; }
+static inline Float4 Float4MulAdd(Float4 acc, Float4 a, Float4 b) { for (int i = 0; i < 4; ++i) acc.v[i] += a.v[i] * b.v[i]; return acc; }
+#endif
+
+// Nearest centroid search goes over groups of kLanes centroids, stored transposed
+// (for each dimension, kLanes values) so that the inner loop is SIMD multiply-adds.
+// Nearest is the smallest |c|^2/2 - dot(p,c), i.e. squared distance without the
+// |p|^2 term that is the same for all centroids.
+static const size_t kLanes = 8;
+static const size_t kAssignJobSize = 1024;
+
+struct CentroidGroups
+{
+	size_t groupCount = 0;
+	std::vector<float> values; // groupCount * dim * kLanes
+	std::vector<float> halfNormSq; // groupCount * kLanes; FLT_MAX for padding lanes so they never win
+};
+
+static void BuildCentroidGroups(const float* centroids, size_t clusterCount, size_t dim, CentroidGroups& groups)
+{
+	groups.groupCount = (clusterCount + kLanes - 1) / kLanes;
+	groups.values.assign(groups.groupCount * dim * kLanes, 0.0f);
+	groups.halfNormSq.assign(groups.groupCount * kLanes, FLT_MAX);
+	for (size_t c = 0; c < clusterCount; ++c)
+	{
+		const float* src = centroids + c * dim;
+		float* dst = groups.values.data() + (c / kLanes) * dim * kLanes + c % kLanes;
+		float normSq = 0.0f;
+		for (size_t d = 0; d < dim; ++d)
+		{
+			dst[d * kLanes] = src[d];
+			normSq += src[d] * src[d];
+		}
+		groups.halfNormSq[c] = normSq * 0.5f;
+	}
+}
+
+// Nearest centroids of kPoints points at once; each loaded centroid value is used for all of
+// them, and there are enough independent accumulators to not wait on add latency.
+static const size_t kPoints = 4;
+static void FindNearest(const float* const points[kPoints], size_t dim, const CentroidGroups& groups, uint32_t outNearest[kPoints])
+{
+	const float* values = groups.values.data();
+	const float* halfNormSq = groups.halfNormSq.data();
+	float bestScore[kPoints];
+	for (size_t p = 0; p < kPoints; ++p)
+	{
+		bestScore[p] = FLT_MAX;
+		outNearest[p] = 0;
+	}
+	for (size_t g = 0; g < groups.groupCount; ++g)
+	{
+		Float4 acc[kPoints][2];
+		for (size_t p = 0; p < kPoints; ++p)
+			acc[p][0] = acc[p][1] = Float4Zero();
+		for (size_t d = 0; d < dim; ++d)
+		{
+			const Float4 c0 = Float4Load(values);
+			const Float4 c1 = Float4Load(values + 4);
+			for (size_t p = 0; p < kPoints; ++p)
+			{
+				const Float4 v = Float4Set1(points[p][d]);
+				acc[p][0] = Float4MulAdd(acc[p][0], v, c0);
+				acc[p][1] = Float4MulAdd(acc[p][1], v, c1);
+			}
+			values += kLanes;
+		}
+		float dot[kPoints][kLanes];
+		for (size_t p = 0; p < kPoints; ++p)
+		{
+			Float4Store(dot[p], acc[p][0]);
+			Float4Store(dot[p] + 4, acc[p][1]);
+		}
+		for (size_t p = 0; p < kPoints; ++p)
+		{
+			for (size_t l = 0; l < kLanes; ++l)
+			{
+				const float score = halfNormSq[l] - dot[p][l];
+				if (score < bestScore[p])
+				{
+					bestScore[p] = score;
+					outNearest[p] = uint32_t(g * kLanes + l);
+				}
+			}
+		}
+		halfNormSq += kLanes;
+	}
+}
+
+// points are given either directly (pointIndices null) or as indices into the point array
+static void AssignPoints(const float* points, const uint32_t* pointIndices, size_t count, size_t dim, const CentroidGroups& groups, int threadCount, uint32_t* outIndices)
+{
+	const size_t jobCount = (count + kAssignJobSize - 1) / kAssignJobSize;
+	ParallelFor(threadCount, jobCount, [&](size_t jobIndex, int)
+	{
+		const size_t start = jobIndex * kAssignJobSize;
+		const size_t end = std::min(start + kAssignJobSize, count);
+		for (size_t i = start; i < end; i += kPoints)
+		{
+			// partial last set of points repeats the last one
+			const float* setPoints[kPoints];
+			for (size_t p = 0; p < kPoints; ++p)
+			{
+				const size_t idx = std::min(i + p, end - 1);
+				setPoints[p] = points + (pointIndices ? pointIndices[idx] : idx) * dim;
+			}
+			uint32_t nearest[kPoints];
+			FindNearest(setPoints, dim, groups, nearest);
+			for (size_t p = 0; p < kPoints && i + p < end; ++p)
+				outIndices[i + p] = nearest[p];
+		}
+	});
+}
+
+void KMeansAssign(const float* points, size_t pointCount, size_t dim, const float* centroids, size_t clusterCount, int threadCount, uint32_t* outIndices)
+{
+	CentroidGroups groups;
+	BuildCentroidGroups(centroids, clusterCount, dim, groups);
+	AssignPoints(points, nullptr, pointCount, dim, groups, threadCount, outIndices);
+}
+
+void KMeansTrain(const float* points, size_t pointCount, size_t dim, const KMeansSettings& settings, float* outCentroids, uint32_t* outIndices)
+{
+	const size_t clusterCount = settings.clusterCount;
+	if (pointCount == 0 || clusterCount == 0)
+		return;
+
+	// initial centroids are points evenly spread over the input; for spatially
+	// ordered input that spreads them over the whole scene
+	for (size_t c = 0; c < clusterCount; ++c)
+	{
+		const float* src = points + (c * pointCount / clusterCount) * dim;
+		std::copy(src, src + dim, outCentroids + c * dim);
+	}
+
+	// mini-batch iterations
+	const size_t batchSize = std::min(settings.batchSize, pointCount);
+	std::vector<uint32_t> batch(batchSize);
+	std::vector<uint32_t> batchNearest(batchSize);
+	std::vector<uint32_t> counts(clusterCount, 0);
+	CentroidGroups groups;
+	uint64_t rng = settings.seed;
+	for (int it = 0; it < settings.iterations; ++it)
+	{
+		for (size_t i = 0; i < batchSize; ++i)
+			batch[i] = uint32_t(RandomNext(rng) % pointCount);
+		BuildCentroidGroups(outCentroids, clusterCount, dim, groups);
+		AssignPoints(points, batch.data(), batchSize, dim, groups, settings.threadCount, batchNearest.data());
+
+		// centroid updates in batch order, so the result does not depend on threads
+		for (size_t i = 0; i < batchSize; ++i)
+		{
+			const uint32_t c = batchNearest[i];
+			const float rate = 1.0f / float(++counts[c]);
+			const float* src = points + size_t(batch[i]) * dim;
+			float* dst = outCentroids + size_t(c) * dim;
+			for (size_t d = 0; d < dim; ++d)
+				dst[d] += (src[d] - dst[d]) * rate;
+		}
+	}
+
+	// assign all points, and move centroids to the mean of their points
+	KMeansAssign(points, pointCount, dim, outCentroids, clusterCount, settings.threadCount, outIndices);
+	std::vector<double> sums(clusterCount * dim, 0.0);
+	std::fill(counts.begin(), counts.end(), 0);
+	for (size_t i = 0; i < pointCount; ++i)
+	{
+		const uint32_t c = outIndices[i];
+		++counts[c];
+		const float* src = points + i * dim;
+		double* dst = sums.data() + size_t(c) * dim;
+		for (size_t d = 0; d < dim; ++d)
+			dst[d] += src[d];
+	}
+	for (size_t c = 0; c < clusterCount; ++c)
+	{
+		if (counts[c] == 0)
+			continue;
+		for (size_t d = 0; d < dim; ++d)
+			outCentroids[c * dim + d] = float(sums[c * dim + d] / counts[c]);
+	}
+
+	// moved centroids can have different nearest points; indices have to match the returned centroids
+	KMeansAssign(points, pointCount, dim, outCentroids, clusterCount, settings.threadCount, outIndices);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// k-means clustering of float vectors, for building vector quantization codebooks.
+//
+// Training is mini-batch k-means (Sculley 2010, "Web-Scale K-Means Clustering"): each
+// iteration finds nearest centroids for a random batch of points (on multiple threads),
+// then moves each centroid towards its points with a 1/count learning rate. At the end
+// all points are assigned, centroids are set to the mean of their points, and all points are
+// assigned again to the final centroids.
+// Results do not depend on the thread count.
+
+struct KMeansSettings
+{
+	size_t clusterCount = 256;
+	size_t batchSize = 8192;
+	int iterations = 16;
+	uint64_t seed = 1;
+	int threadCount = 1;
+};
+
+// points: pointCount vectors of dim floats, tightly packed.
+// outCentroids gets clusterCount * dim floats, outIndices gets pointCount nearest centroid indices.
+// When there are fewer points than clusters, the extra centroids are copies of the points.
+void KMeansTrain(const float* points, size_t pointCount, size_t dim, const KMeansSettings& settings, float* outCentroids, uint32_t* outIndices);
+
+// Index of the nearest centroid (squared distance) for each point, on threadCount threads
+void KMeansAssign(const float* points, size_t pointCount, size_t dim, const float* centroids, size_t clusterCount, int threadCount, uint32_t* outIndices);
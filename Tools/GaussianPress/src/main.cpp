@@ -1,11 +1,35 @@
+#include <assert.h>
+#include <float.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <algorithm>
 #include "compressors.h"
 #include "compression_helpers.h"
-#include "filters.h"
+#include "compressor_config.h"
+#include "alloc_stats.h"
+#include "bench_report.h"
+#include "container.h"
+#include "fast_math.h"
+#include "kmeans.h"
+#include "parallel.h"
+#include "ply_reader.h"
+#include "quantize.h"
+#include "quat_codec.h"
+#include "radix_sort.h"
+#include "random.h"
+#include "scratch_arena.h"
+#include "simd.h"
+#include "splat_data.h"
+#include "stream_split.h"
 #include "systeminfo.h"
+#include "trace.h"
+#include "tuner.h"
 #include <math.h>
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <meshoptimizer.h>
 
@@ -36,251 +60,104 @@ Compressor     SizeGB CTimeS  DTimeS   Ratio   CGB/s   DGB/s
 #include "../libs/sokol_time.h"
 
 
-struct FullVertex
-{
-	float px, py, pz;
-	float nx, ny, nz;
-	float dcr, dcg, dcb;
-	float shr[15];
-	float shg[15];
-	float shb[15];
-	float opacity;
-	float sx, sy, sz;
-	float rw, rx, ry, rz;
-};
-constexpr size_t kFullVertexStride = 248;
-constexpr size_t kFullVertexFloats = kFullVertexStride / 4;
-static_assert(sizeof(FullVertex) == kFullVertexStride);
+struct OrderDesc;
+struct QuantProfile;
 
-constexpr int kRuns = 1;
-
-struct FilterDesc
+// Benchmark settings; set from the command line (see PrintUsage)
+struct BenchOptions
 {
-	const char* name = nullptr;
-	void (*filterFunc)(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems) = nullptr;
-	void (*unfilterFunc)(const uint8_t* src, uint8_t* dst, size_t channels, size_t dataElems) = nullptr;
+	std::vector<const OrderDesc*> orders;
+	std::vector<const QuantProfile*> profiles;
+	int runs = 1;
+
+	// Quantization bounds per chunk of this many (spatially ordered) splats, instead of one
+	// global min/max per attribute; 0 to use global bounds. Streaming mode always uses global ones.
+	size_t quantChunkSize = 0;
+
+	// Streaming mode: convert each test file straight from PLY into a compressed file, block
+	// by block, keeping memory use under the cap, instead of running the in-memory benchmark.
+	bool streaming = false;
+	size_t memoryCap = 256 * 1024 * 1024;
+	// Check that spatial reordering visits each vertex exactly once (extra pass over the order table)
+	bool verifyOrder = false;
+
+	std::string jsonPath; // write results as JSON here, if not empty
+	std::string csvPath; // same as CSV
+	bool perfCounters = false; // record hardware counters around each compress/decompress call
+	std::string tracePath; // write Chrome trace of all stages here, if not empty
+
+	// Also test stream-split mode (see PackStream), with the other configs as candidates for each stream
+	bool streamSplit = false;
+	// Also time fused decode into splats (CompressorConfig::DecompressFused), against memcpy of the splat data
+	bool fusedDecode = false;
+	// Instead of anything else, run the kernel micro-benchmarks (see BenchQuantKernels, BenchMathKernels)
+	bool kernels = false;
+
+	// Auto-tune mode: instead of the benchmark table, measure all configs on a sample of each file and
+	// pick the smallest one that decodes at least this fast (GB/s); not tuning when negative
+	double tuneMinDecodeSpeed = -1;
+	size_t tuneSampleSize = 32 * 1024 * 1024;
 };
-
-static FilterDesc g_FilterByteDelta = { "-bd", Filter_ByteDelta, UnFilter_ByteDelta };
+static BenchOptions g_Options;
 
 static std::unique_ptr<GenericCompressor> g_CompZstd = std::make_unique<GenericCompressor>(kCompressionZstd);
 static std::unique_ptr<GenericCompressor> g_CompLZ4 = std::make_unique<GenericCompressor>(kCompressionLZ4);
+static std::unique_ptr<GenericCompressor> g_CompRans = std::make_unique<GenericCompressor>(kCompressionRans);
+static std::unique_ptr<ZstdCompressor> g_CompZstdCtx = std::make_unique<ZstdCompressor>(kZstdContexts);
+static std::unique_ptr<ZstdCompressor> g_CompZstdDict = std::make_unique<ZstdCompressor>(kZstdDictionary);
+static std::vector<std::unique_ptr<ZstdCompressor>> g_CompZstdWorkers; // one for each tested thread count
 static std::unique_ptr<Compressor> g_CompMeshOpt = std::make_unique<MeshOptCompressor>(kCompressionCount);
 
-
-struct TestFile
+// Bits used for each attribute when packing; 0 means not stored (decodes as zero).
+// Coefficients of each SH band use the same bit count.
+struct QuantProfile
 {
-	const char* title = nullptr;
-	const char* path = nullptr;
-	std::vector<uint8_t> origFileData;
-	std::vector<uint8_t> fileData;
-	size_t vertexCount = 0;
-	size_t vertexStride = 0;
-
-	FullVertex valMin;
-	FullVertex valMax;
-	FullVertex errMax;
-	FullVertex errAvg;
+	const char* name = nullptr;
+	int pos[3] = {};
+	int dc[3] = {};
+	int sh[3] = {}; // SH bands 1, 2, 3
+	int opacity = 0;
+	int scale[3] = {};
+	int rot[4] = {}; // w, x, y, z
+	int rotSmallest3 = 0; // when not zero, rotation uses smallest-three encoding with this many bits per component (plus 2 bit index) instead of rot[]
+	int shCodebookSize = 0; // when not zero, SH coefficients are an index into k-means codebook of this many entries instead of sh[]
+	// meshoptimizer attribute filters, instead of min/max quantization:
+	int rotMeshOptQuat = 0; // when not zero, rotation uses meshopt quaternion filter with this many bits per component (4-16) instead of rot[]
+	int scaleMeshOptExp = 0; // when not zero, scale uses meshopt exponential filter (one exponent for xyz) with this many mantissa bits instead of scale[]
+	int shMeshOptExp = 0; // when not zero, SH coefficients use meshopt exponential filter (one exponent per color channel) with this many mantissa bits instead of sh[]
 };
 
-enum BlockSize
-{
-	kBSizeNone,
-	kBSize64k,
-	kBSize256k,
-	kBSize1M,
-	kBSize4M,
-	kBSize16M,
-	kBSize64M,
-	kBSizeCount
-};
-static const size_t kBlockSizeToActualSize[] =
-{
-	0,
-	64 * 1024,
-	256 * 1024,
-	1024 * 1024,
-	4 * 1024 * 1024,
-	16 * 1024 * 1024,
-	64 * 1024 * 1024,
-};
-static_assert(sizeof(kBlockSizeToActualSize)/sizeof(kBlockSizeToActualSize[0]) == kBSizeCount, "block size table size mismatch");
-static const char* kBlockSizeName[] =
-{
-	"",
-	"-64k",
-	"-256k",
-	"-1M",
-	"-4M",
-	"-16M",
-	"-64M",
-};
-static_assert(sizeof(kBlockSizeName) / sizeof(kBlockSizeName[0]) == kBSizeCount, "block size name table size mismatch");
+static QuantProfile g_Quant16 = { "q16", {16,16,16}, {16,16,16}, {16,16,16}, 16, {16,16,16}, {16,16,16,16} };
+static QuantProfile g_QuantMedium = { "q-med", {16,16,16}, {11,10,11}, {8,8,8}, 8, {10,10,10}, {}, 10 };
+static QuantProfile g_QuantLow = { "q-low", {11,10,11}, {8,8,8}, {6,5,4}, 8, {6,5,5}, {}, 8 };
+static QuantProfile g_QuantVq = { "q-vq", {16,16,16}, {11,10,11}, {}, 8, {10,10,10}, {}, 10, 4096 };
+static QuantProfile g_QuantMeshOpt = { "q-mo", {16,16,16}, {16,16,16}, {}, 16, {}, {}, 0, 0, 16, 16, 16 };
 
-struct CompressorConfig
+static QuantProfile* g_QuantProfiles[] =
 {
-	Compressor* cmp;
-	FilterDesc* filter;
-	BlockSize blockSizeEnum = kBSizeNone;
-
-	std::string GetName() const
-	{
-		char buf[100];
-		cmp->PrintName(sizeof(buf), buf);
-		std::string res = buf;
-		if (filter != nullptr)
-			res += filter->name;
-		res += kBlockSizeName[blockSizeEnum];
-		return res;
-	}
-
-	uint8_t* CompressWhole(const TestFile& tf, int level, size_t& outCompressedSize)
-	{
-		const uint8_t* srcData = tf.fileData.data();
-		uint8_t* filterBuffer = nullptr;
-		if (filter)
-		{
-			filterBuffer = new uint8_t[tf.fileData.size()];
-			filter->filterFunc(srcData, filterBuffer, tf.vertexStride, tf.vertexCount);
-			srcData = filterBuffer;
-		}
-
-		outCompressedSize = 0;
-		uint8_t* compressed = cmp->Compress(level, srcData, tf.vertexCount, tf.vertexStride, outCompressedSize);
-		delete[] filterBuffer;
-		return compressed;
-	}
-
-	uint8_t* Compress(const TestFile& tf, int level, size_t& outCompressedSize)
-	{
-		if (blockSizeEnum == kBSizeNone)
-			return CompressWhole(tf, level, outCompressedSize);
-
-		size_t blockSize = kBlockSizeToActualSize[blockSizeEnum];
-		// make sure multiple of data elem size
-		blockSize = (blockSize / tf.vertexStride) * tf.vertexStride;
-
-		uint8_t* filterBuffer = nullptr;
-		if (filter)
-			filterBuffer = new uint8_t[blockSize];
-
-		const size_t dataSize = tf.fileData.size();
-		const uint8_t* srcData = tf.fileData.data();
-		uint8_t* compressed = new uint8_t[dataSize + 4];
-		size_t srcOffset = 0;
-		size_t cmpOffset = 0;
-		while (srcOffset < dataSize)
-		{
-			size_t thisBlockSize = std::min(blockSize, dataSize - srcOffset);
-			if (filter)
-			{
-				filter->filterFunc(srcData + srcOffset, filterBuffer, tf.vertexStride, thisBlockSize / tf.vertexStride);
-			}
-			size_t thisCmpSize = 0;
-			uint8_t* thisCmp = cmp->Compress(level,
-				(filter ? filterBuffer : srcData + srcOffset),
-				thisBlockSize / tf.vertexStride,
-				tf.vertexStride,
-				thisCmpSize);
-			if (cmpOffset + thisCmpSize > dataSize)
-			{
-				// data is not compressible; fallback to just zero indicator + memcpy
-				*(uint32_t*)compressed = 0;
-				memcpy(compressed + 4, srcData, dataSize);
-				outCompressedSize = dataSize + 4;
-				delete[] filterBuffer;
-				delete[] thisCmp;
-				return compressed;
-			}
-			// store this chunk size and data
-			*(uint32_t*)(compressed + cmpOffset) = uint32_t(thisCmpSize);
-			memcpy(compressed + cmpOffset + 4, thisCmp, thisCmpSize);
-			delete[] thisCmp;
-
-			srcOffset += blockSize;
-			cmpOffset += 4 + thisCmpSize;
-		}
-		delete[] filterBuffer;
-		outCompressedSize = cmpOffset;
-		return compressed;
-	}
-
-	void DecompressWhole(const TestFile& tf, const uint8_t* compressed, size_t compressedSize, uint8_t* dst)
-	{
-		uint8_t* filterBuffer = nullptr;
-		if (filter)
-			filterBuffer = new uint8_t[tf.fileData.size()];
-		cmp->Decompress(compressed, compressedSize, filter == nullptr ? dst : filterBuffer, tf.vertexCount, tf.vertexStride);
-
-		if (filter)
-		{
-			filter->unfilterFunc(filterBuffer, dst, tf.vertexStride, tf.vertexCount);
-			delete[] filterBuffer;
-		}
-	}
-
-	void Decompress(const TestFile& tf, const uint8_t* compressed, size_t compressedSize, uint8_t* dst)
-	{
-		if (blockSizeEnum == kBSizeNone)
-		{
-			DecompressWhole(tf, compressed, compressedSize, dst);
-			return;
-		}
-
-		uint32_t firstBlockCmpSize = *(const uint32_t*)compressed;
-		if (firstBlockCmpSize == 0)
-		{
-			// it was uncompressible data fallback
-			memcpy(dst, compressed + 4, tf.vertexCount * tf.vertexStride);
-			return;
-		}
-
-		size_t blockSize = kBlockSizeToActualSize[blockSizeEnum];
-		// make sure multiple of data elem size
-		blockSize = (blockSize / tf.vertexStride) * tf.vertexStride;
-
-		uint8_t* filterBuffer = nullptr;
-		if (filter)
-			filterBuffer = new uint8_t[blockSize];
-
-		uint8_t* dstData = dst;
-		const size_t dataSize = tf.fileData.size();
-		
-		size_t cmpOffset = 0;
-		size_t dstOffset = 0;
-		while (cmpOffset < compressedSize)
-		{
-			size_t thisBlockSize = std::min(blockSize, dataSize - dstOffset);
-
-			uint32_t thisCmpSize = *(const uint32_t*)(compressed + cmpOffset);
-			cmp->Decompress(compressed + cmpOffset + 4, thisCmpSize, (filter == nullptr ? dstData + dstOffset : filterBuffer), thisBlockSize / tf.vertexStride, tf.vertexStride);
-
-			if (filter)
-				filter->unfilterFunc(filterBuffer, dstData + dstOffset, tf.vertexStride, thisBlockSize / tf.vertexStride);
-
-			cmpOffset += 4 + thisCmpSize;
-			dstOffset += thisBlockSize;
-		}
-		delete[] filterBuffer;
-	}
+	&g_Quant16,
+	&g_QuantMedium,
+	&g_QuantLow,
+	&g_QuantVq,
+	&g_QuantMeshOpt,
 };
 
 static std::vector<CompressorConfig> g_Compressors;
+// Reused by all benchmark decodes, so that only the first ones allocate scratch memory
+static ScratchArenas g_DecodeArenas;
 
-static void TestCompressors(size_t testFileCount, TestFile* testFiles)
-{
-	//g_Compressors.push_back({ g_CompZstd.get(), &g_FilterByteDelta, kBSize1M });
-	//g_Compressors.push_back({ g_CompLZ4.get(), &g_FilterByteDelta, kBSize1M });
-
-	//g_Compressors.push_back({ g_CompZstd.get(), &g_FilterByteDelta });
-	g_Compressors.push_back({ g_CompLZ4.get(), &g_FilterByteDelta });
-
-	//g_Compressors.push_back({ g_CompZstd.get() });
-	g_Compressors.push_back({ g_CompLZ4.get() });
-	//g_Compressors.push_back({ g_CompMeshOpt.get() }); //@TODO: fails with packed data
+static void UnpackData(const TestFile& tf, const uint8_t* src, FullVertex* dst, int threadCount);
+static void UnpackData(const TestFile& tf, FullVertex* dst);
+static void UnlinearizeData(FullVertex* data, size_t count);
+static void UnlinearizeData(FullVertex* data, size_t count, int threadCount);
 
+// Runs each compressor config (and each of its levels) on all test files g_Options.runs times;
+// prints a table of median times, and adds the results to outResults
+static void TestCompressors(size_t testFileCount, TestFile* testFiles, const char* orderName, const char* profileName, std::vector<BenchResult>& outResults)
+{
+	const int runs = g_Options.runs;
 	size_t maxSize = 0, totalPackedSize = 0, totalOrigSize = 0;
-	for (int tfi = 0; tfi < testFileCount; ++tfi)
+	for (size_t tfi = 0; tfi < testFileCount; ++tfi)
 	{
 		size_t size = testFiles[tfi].fileData.size();
 		maxSize = std::max(maxSize, size);
@@ -290,61 +167,122 @@ static void TestCompressors(size_t testFileCount, TestFile* testFiles)
 
 	std::vector<uint8_t> decompressed(maxSize);
 
+	// fused decode results are checked against separately unpacked & unlinearized data
+	const bool fused = g_Options.fusedDecode;
+	std::vector<std::vector<FullVertex>> fusedReference(fused ? testFileCount : 0);
+	std::vector<FullVertex> fusedDecompressed;
+	std::vector<double> memcpyTimes(runs);
+	for (size_t tfi = 0; tfi < fusedReference.size(); ++tfi)
+	{
+		const TestFile& tf = testFiles[tfi];
+		fusedReference[tfi].resize(tf.vertexCount);
+		UnpackData(tf, fusedReference[tfi].data());
+		UnlinearizeData(fusedReference[tfi].data(), tf.vertexCount);
+		fusedDecompressed.resize(std::max(fusedDecompressed.size(), tf.vertexCount));
+	}
+
 	struct Result
 	{
 		int level = 0;
 		size_t size = 0;
-		double cmpTime = 0;
-		double decTime = 0;
+		std::vector<double> cmpTimes; // total over all files, for each run
+		std::vector<double> decTimes;
+		std::vector<double> fusedTimes; // when measuring fused decode
+		std::vector<double> separateTimes; // and decode in separate passes (decompress, unpack, unlinearize) to compare with
+		SysInfoPerfCounters cmpCounters; // sums over all files and runs
+		SysInfoPerfCounters decCounters;
+		uint64_t decAllocs = 0; // heap allocations while decompressing; sums over all files and runs
+		uint64_t decAllocBytes = 0;
 	};
 	typedef std::vector<Result> LevelResults;
 	std::vector<LevelResults> results;
 	for (auto& cmp : g_Compressors)
 	{
-		auto levels = cmp.cmp->GetLevels();
+		auto levels = cmp.GetLevels();
 		LevelResults res(levels.size());
 		for (size_t i = 0; i < levels.size(); ++i)
+		{
 			res[i].level = levels[i];
+			res[i].cmpTimes.resize(runs);
+			res[i].decTimes.resize(runs);
+			if (fused && !cmp.IsStreamSplit())
+			{
+				res[i].fusedTimes.resize(runs);
+				res[i].separateTimes.resize(runs);
+			}
+		}
 		results.emplace_back(res);
 	}
 
 	std::string cmpName;
-	for (int ir = 0; ir < kRuns; ++ir)
+	for (int ir = 0; ir < runs; ++ir)
 	{
-		printf("Run %i/%i, %zi compressors on %zi files:\n", ir+1, kRuns, g_Compressors.size(), testFileCount);
+		printf("Run %i/%i, %zi compressors on %zi files:\n", ir+1, runs, g_Compressors.size(), testFileCount);
+		for (size_t tfi = 0; tfi < fusedReference.size(); ++tfi)
+		{
+			SysInfoFlushCaches();
+			const uint64_t t0 = stm_now();
+			memcpy(fusedDecompressed.data(), fusedReference[tfi].data(), fusedReference[tfi].size() * kFullVertexStride);
+			memcpyTimes[ir] += stm_sec(stm_since(t0));
+		}
 		for (size_t ic = 0; ic < g_Compressors.size(); ++ic)
 		{
 			auto& config = g_Compressors[ic];
 			cmpName = config.GetName();
+			TraceZone zone("TestCompressor", cmpName.c_str());
 			LevelResults& levelRes = results[ic];
 			printf("%s: %zi levels:\n", cmpName.c_str(), levelRes.size());
 			for (Result& res : levelRes)
 			{
 				printf(".");
-				for (int tfi = 0; tfi < testFileCount; ++tfi)
+				res.size = 0;
+				for (size_t tfi = 0; tfi < testFileCount; ++tfi)
 				{
 					const TestFile& tf = testFiles[tfi];
 
-					const uint8_t* srcData = tf.fileData.data();
 					SysInfoFlushCaches();
 
 					// compress
+					if (g_Options.perfCounters)
+						SysInfoPerfCountersStart();
 					uint64_t t0 = stm_now();
 					size_t compressedSize = 0;
 					uint8_t* compressed = config.Compress(tf, res.level, compressedSize);
 					double tComp = stm_sec(stm_since(t0));
+					if (g_Options.perfCounters)
+						SysInfoPerfCountersStop(res.cmpCounters);
 
 					// decompress
 					memset(decompressed.data(), 0, tf.fileData.size());
 					SysInfoFlushCaches();
+					if (g_Options.perfCounters)
+						SysInfoPerfCountersStart();
+					const AllocStats alloc0 = AllocStatsGet();
 					t0 = stm_now();
-					config.Decompress(tf, compressed, compressedSize, decompressed.data());
+					if (!config.Decompress(tf, compressed, compressedSize, decompressed.data(), g_DecodeArenas))
+					{
+						printf("  ERROR, %s level %i failed to decompress %s\n", cmpName.c_str(), res.level, tf.path);
+						exit(1);
+					}
 					double tDecomp = stm_sec(stm_since(t0));
+					if (g_Options.perfCounters)
+						SysInfoPerfCountersStop(res.decCounters);
+					const AllocStats alloc1 = AllocStatsGet();
+					res.decAllocs += alloc1.count - alloc0.count;
+					res.decAllocBytes += alloc1.bytes - alloc0.bytes;
+					// the rest of the non-fused decode into splats, right after decompression like it would be used
+					if (!res.separateTimes.empty())
+					{
+						t0 = stm_now();
+						UnpackData(tf, decompressed.data(), fusedDecompressed.data(), config.threadCount);
+						UnlinearizeData(fusedDecompressed.data(), tf.vertexCount, config.threadCount);
+						res.separateTimes[ir] += tDecomp + stm_sec(stm_since(t0));
+					}
 
 					// stats
 					res.size += compressedSize;
-					res.cmpTime += tComp;
-					res.decTime += tDecomp;
+					res.cmpTimes[ir] += tComp;
+					res.decTimes[ir] += tDecomp;
 
 					// check validity
 					if (memcmp(tf.fileData.data(), decompressed.data(), tf.fileData.size()) != 0)
@@ -362,6 +300,25 @@ static void TestCompressors(size_t testFileCount, TestFile* testFiles)
 						}
 						exit(1);
 					}
+					if (!res.fusedTimes.empty())
+					{
+						memset(fusedDecompressed.data(), 0, tf.vertexCount * kFullVertexStride);
+						SysInfoFlushCaches();
+						t0 = stm_now();
+						if (!config.DecompressFused(tf, compressed, compressedSize, fusedDecompressed.data(), g_DecodeArenas))
+						{
+							printf("  ERROR, %s level %i fused decode failed on %s\n", cmpName.c_str(), res.level, tf.path);
+							exit(1);
+						}
+						res.fusedTimes[ir] += stm_sec(stm_since(t0));
+						if (memcmp(fusedReference[tfi].data(), fusedDecompressed.data(), tf.vertexCount * kFullVertexStride) != 0)
+						{
+							printf("  ERROR, %s level %i fused decode does not match unpacked data on %s\n", cmpName.c_str(), res.level, tf.path);
+							exit(1);
+						}
+					}
+					if (ir == 0 && config.IsStreamSplit())
+						PrintStreamSummary(config, tf, compressed, compressedSize, g_DecodeArenas);
 					delete[] compressed;
 				}
 			}
@@ -370,20 +327,9 @@ static void TestCompressors(size_t testFileCount, TestFile* testFiles)
 		printf("\n");
 	}
 
-	// normalize results
 	int counterRan = 0;
-	for (size_t ic = 0; ic < g_Compressors.size(); ++ic)
-	{
-		Compressor* cmp = g_Compressors[ic].cmp;
-		LevelResults& levelRes = results[ic];
-		for (Result& res : levelRes)
-		{
-			res.size /= kRuns;
-			res.cmpTime /= kRuns;
-			res.decTime /= kRuns;
-			++counterRan;
-		}
-	}
+	for (const LevelResults& levelRes : results)
+		counterRan += int(levelRes.size());
 	printf("  Ran %i cases\n", counterRan);
 
 
@@ -392,86 +338,214 @@ static void TestCompressors(size_t testFileCount, TestFile* testFiles)
 	double fullSize = (double)totalOrigSize;
 	double packedSize = (double)totalPackedSize;
 	// print results to screen
-	printf("Compressor     SizeGB CTimeS  DTimeS   Ratio   CGB/s   DGB/s\n");
+	// heap allocations (and their KB) per file decode; with perf counters: instructions per cycle,
+	// and cache & branch misses per input byte
+	printf("Compressor     SizeGB CTimeS  DTimeS   Ratio   CGB/s   DGB/s  DAlloc DAllocKB%s%s\n",
+		g_Options.perfCounters ? "    C-IPC  C-cm/B  C-bm/B    D-IPC  D-cm/B  D-bm/B" : "", runs > 1 ? "  (median of runs)" : "");
 	printf("%12s %7.3f\n", "Full", fullSize / oneGB);
 	printf("%12s %7.3f\n", "Packed", packedSize / oneGB);
 	for (size_t ic = 0; ic < g_Compressors.size(); ++ic)
 	{
-		cmpName = g_Compressors[ic].GetName();
+		const CompressorConfig& config = g_Compressors[ic];
 		const LevelResults& levelRes = results[ic];
 		for (const Result& res : levelRes)
 		{
-			char nameBuf[1000];
-			if (levelRes.size() == 1)
-				snprintf(nameBuf, sizeof(nameBuf), "%s", cmpName.c_str());
-			else if (res.level < 0)
-				snprintf(nameBuf, sizeof(nameBuf), "%s_n%i", cmpName.c_str(), abs(res.level));
-			else
-				snprintf(nameBuf, sizeof(nameBuf), "%s_%i", cmpName.c_str(), abs(res.level));
+			const std::string name = GetConfigLevelName(config, levelRes.size(), res.level);
 			double csize = (double)res.size;
-			double ctime = res.cmpTime;
-			double dtime = res.decTime;
+			double ctime = BenchCalcStats(res.cmpTimes).median;
+			double dtime = BenchCalcStats(res.decTimes).median;
 			double ratio = packedSize / csize;
 			double cspeed = packedSize / ctime;
 			double dspeed = packedSize / dtime;
-			printf("%12s %7.3f %7.3f %7.3f %7.3f %7.3f %7.3f\n", nameBuf, csize/ oneGB, ctime, dtime, ratio, cspeed/oneGB, dspeed/oneGB);
+			const double decodes = double(runs) * testFileCount;
+			const double allocs = res.decAllocs / decodes;
+			const double allocBytes = res.decAllocBytes / decodes;
+			printf("%12s %7.3f %7.3f %7.3f %7.3f %7.3f %7.3f %7.1f %8.1f", name.c_str(), csize/ oneGB, ctime, dtime, ratio, cspeed/oneGB, dspeed/oneGB, allocs, allocBytes / 1024.0);
+			if (g_Options.perfCounters)
+			{
+				const double bytes = packedSize * runs;
+				for (const SysInfoPerfCounters* pc : { &res.cmpCounters, &res.decCounters })
+					printf("  %7.3f %7.4f %7.4f", pc->cycles ? double(pc->instructions) / pc->cycles : 0.0, pc->cacheMisses / bytes, pc->branchMisses / bytes);
+			}
+			printf("\n");
+
+			BenchResult br;
+			br.order = orderName;
+			br.profile = profileName;
+			br.name = name;
+			br.codec = config.GetCodecName();
+			br.filter = config.IsStreamSplit() ? "auto" : config.filter ? config.filter->name + 1 : "none";
+			br.blockSize = kBlockSizeToActualSize[config.blockSizeEnum];
+			br.threads = config.threadCount;
+			br.level = res.level;
+			br.fullSize = totalOrigSize;
+			br.packedSize = totalPackedSize;
+			br.compressedSize = res.size;
+			br.cmpTimes = res.cmpTimes;
+			br.decTimes = res.decTimes;
+			br.hasCounters = g_Options.perfCounters;
+			br.cmpCounters = res.cmpCounters;
+			br.decCounters = res.decCounters;
+			br.decAllocs = allocs;
+			br.decAllocBytes = allocBytes;
+			br.fusedTimes = res.fusedTimes;
+			br.separateTimes = res.separateTimes;
+			outResults.push_back(br);
 		}
 	}
 
-	// cleanup
-	g_Compressors.clear();
+	// fused decode speeds are of the splat data it writes, like memcpy of it; STimeS/SGB/s is decode into
+	// splats in separate passes, and speedup is fused over that
+	if (fused)
+	{
+		const double memcpySpeed = fullSize / BenchCalcStats(memcpyTimes).median;
+		printf("Fused decode into splats   FTimeS   FGB/s  memcpy%%   STimeS   SGB/s  speedup\n");
+		printf("%24s %8.3f %7.3f\n", "memcpy", fullSize / memcpySpeed, memcpySpeed / oneGB);
+		for (size_t ic = 0; ic < g_Compressors.size(); ++ic)
+		{
+			const CompressorConfig& config = g_Compressors[ic];
+			const LevelResults& levelRes = results[ic];
+			for (const Result& res : levelRes)
+			{
+				if (res.fusedTimes.empty())
+					continue;
+				const double ftime = BenchCalcStats(res.fusedTimes).median;
+				const double fspeed = fullSize / ftime;
+				const double stime = BenchCalcStats(res.separateTimes).median;
+				printf("%24s %8.3f %7.3f %7.1f %8.3f %7.3f %7.2fx\n", GetConfigLevelName(config, levelRes.size(), res.level).c_str(), ftime, fspeed / oneGB, fspeed / memcpySpeed * 100.0,
+					stime, fullSize / stime / oneGB, stime / ftime);
+			}
+		}
+	}
 }
 
-static bool ReadPlyFile(const char* path, std::vector<uint8_t>& dst, size_t& outVertexCount, size_t& outStride)
+static bool OpenPlyFile(TestFile& tf)
 {
-	FILE* f = fopen(path, "rb");
-	if (f == nullptr)
-	{
-		printf("ERROR: failed to open data file %s\n", path);
+	TraceZone zone("OpenPlyFile", tf.title);
+	if (!PlyOpen(tf.path, tf.ply, !tf.streaming))
 		return false;
-	}
-	// read header
-	int vertexCount = 0;
-	int vertexStride = 0;
-	char lineBuf[1024], propType[1024], propName[1024];
+
+	// figure out where FullVertex data comes from; SH degree is 0-3 depending on how many
+	// f_rest_* properties are there; any other properties are ignored
+	PlyVertexLayout& layout = tf.plyLayout;
+	int shCount = 0;
 	while (true)
 	{
-		lineBuf[0] = 0;
-		fgets(lineBuf, sizeof(lineBuf), f);
-		if (0 == strncmp(lineBuf, "end_header", 10))
+		char name[32];
+		snprintf(name, sizeof(name), "f_rest_%i", shCount);
+		if (PlyFindProperty(tf.ply, name) < 0)
 			break;
-		// parse vertex count
-		if (1 == sscanf(lineBuf, "element vertex %i", &vertexCount))
-		{
-			// ok
-		}
-		// property
-		propType[0] = 0;
-		propName[0] = 0;
-		if (2 == sscanf(lineBuf, "property %s %s", propType, propName))
+		++shCount;
+	}
+	switch (shCount)
+	{
+	case 0: layout.shDegree = 0; break;
+	case 9: layout.shDegree = 1; break;
+	case 24: layout.shDegree = 2; break;
+	case 45: layout.shDegree = 3; break;
+	default:
+		printf("ERROR: PLY file %s has %i SH coefficients, expected 0, 9, 24 or 45\n", tf.path, shCount);
+		return false;
+	}
+	const int shPerChannel = shCount / 3;
+
+	auto mapProperty = [&](const char* name, int dstIndex, bool required)
+	{
+		int idx = PlyFindProperty(tf.ply, name);
+		if (idx < 0)
 		{
-			if (0 == strcmp(propType, "float")) vertexStride += 4;
-			if (0 == strcmp(propType, "double")) vertexStride += 8;
-			if (0 == strcmp(propType, "uchar")) vertexStride += 1;
+			if (required)
+				printf("ERROR: PLY file %s has no '%s' property\n", tf.path, name);
+			return !required;
 		}
+		layout.present[dstIndex] = true;
+		layout.type[dstIndex] = tf.ply.properties[idx].type;
+		layout.offset[dstIndex] = tf.ply.properties[idx].offset;
+		return true;
+	};
+	static const char* kRequiredNames[] = { "x", "y", "z", "f_dc_0", "f_dc_1", "f_dc_2", "opacity", "scale_0", "scale_1", "scale_2", "rot_0", "rot_1", "rot_2", "rot_3" };
+	static const int kRequiredIndices[] = { 0, 1, 2, 6, 7, 8, 54, 55, 56, 57, 58, 59, 60, 61 };
+	static_assert(std::size(kRequiredNames) == std::size(kRequiredIndices));
+	bool ok = true;
+	for (size_t i = 0; i < std::size(kRequiredNames); ++i)
+		ok &= mapProperty(kRequiredNames[i], kRequiredIndices[i], true);
+	mapProperty("nx", 3, false);
+	mapProperty("ny", 4, false);
+	mapProperty("nz", 5, false);
+	// f_rest_* are stored as all coefficients of R, then G, then B
+	for (int i = 0; i < shCount; ++i)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "f_rest_%i", i);
+		mapProperty(name, 9 + (i / shPerChannel) * 15 + (i % shPerChannel), true);
 	}
+	if (!ok)
+		return false;
 
-	//printf("PLY file %s: %i verts, %i stride\n", path, vertexCount, vertexStride);
+	layout.isFullVertex = tf.ply.vertexStride == kFullVertexStride;
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+		layout.isFullVertex &= layout.present[j] && layout.type[j] == kPlyFloat && layout.offset[j] == j * 4;
 
-	const size_t kStride = 248;
-	if (vertexStride != kStride)
+	if (tf.ply.vertexCount > UINT32_MAX)
 	{
-		printf("ERROR: expect vertex stride %zi, file %s had %i\n", kStride, path, vertexStride);
+		printf("ERROR: PLY file %s has too many vertices (%zi)\n", tf.path, tf.ply.vertexCount);
 		return false;
 	}
-	dst.resize(vertexCount * kStride);
-	fread(dst.data(), kStride, vertexCount, f);
 
-	outVertexCount = vertexCount;
-	outStride = vertexStride;
+	printf("- %s: %zi verts, stride %zi, SH degree %i, %zi properties%s\n", tf.title, tf.ply.vertexCount, tf.ply.vertexStride, layout.shDegree, tf.ply.properties.size(), layout.isFullVertex ? "" : " (converting)");
+	tf.vertexCount = tf.ply.vertexCount;
+	tf.vertexStride = kFullVertexStride;
 	return true;
 }
 
+// Vertices read at once when going through a PLY file that is not mapped
+const size_t kPlyReadWindowBytes = 1024 * 1024;
+
+// Raw data of vertices [first, first + count): straight from the mapping, or read into buffer when
+// the file is not mapped; null (with a message) when reading fails
+static const uint8_t* GetPlyVertices(const TestFile& tf, size_t first, size_t count, std::vector<uint8_t>& buffer)
+{
+	if (tf.ply.vertexData != nullptr)
+		return tf.ply.vertexData + first * tf.ply.vertexStride;
+	buffer.resize(count * tf.ply.vertexStride);
+	if (!PlyRead(tf.ply, first, count, buffer.data()))
+	{
+		printf("ERROR: failed to read %zi vertices at %zi from %s\n", count, first, tf.path);
+		return nullptr;
+	}
+	return buffer.data();
+}
+
+static size_t GetPlyWindowVertices(const TestFile& tf)
+{
+	return std::max<size_t>(kPlyReadWindowBytes / tf.ply.vertexStride, 1);
+}
+
+static void ConvertPlyVertex(const TestFile& tf, const uint8_t* src, FullVertex& dst)
+{
+	const PlyVertexLayout& layout = tf.plyLayout;
+	if (layout.isFullVertex)
+	{
+		memcpy(&dst, src, kFullVertexStride);
+		return;
+	}
+	float* dstFloats = (float*)&dst;
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+		dstFloats[j] = layout.present[j] ? PlyReadValue(src + layout.offset[j], layout.type[j]) : 0.0f;
+}
+
+static void ReadPlyVertex(const TestFile& tf, size_t index, FullVertex& dst)
+{
+	ConvertPlyVertex(tf, tf.ply.vertexData + index * tf.ply.vertexStride, dst);
+}
+
+static void ReadPlyPosition(const TestFile& tf, const uint8_t* src, float pos[3])
+{
+	const PlyVertexLayout& layout = tf.plyLayout;
+	for (int j = 0; j < 3; ++j)
+		pos[j] = PlyReadValue(src + layout.offset[j], layout.type[j]);
+}
+
 // Based on https://fgiesen.wordpress.com/2009/12/13/decoding-morton-codes/
 //
 // "Insert" two 0 bits after each of the 21 low bits of x
@@ -491,83 +565,324 @@ static uint64_t MortonEncode3(uint64_t x, uint64_t y, uint64_t z)
 	return (MortonPart1By2(z) << 2) | (MortonPart1By2(y) << 1) | MortonPart1By2(x);
 }
 
-static void ReorderData(TestFile& tf)
+// Position along 3D Hilbert curve of three 21-bit integers. Based on
+// John Skilling, "Programming the Hilbert curve" (2004): transform the coordinates
+// into "transposed" Hilbert index, then interleave their bits.
+static uint64_t HilbertEncode3(uint32_t x, uint32_t y, uint32_t z)
 {
-	assert(tf.vertexStride == kFullVertexStride);
+	uint32_t X[3] = { x, y, z };
+	const uint32_t M = 1u << 20;
+	// inverse undo
+	for (uint32_t Q = M; Q > 1; Q >>= 1)
+	{
+		uint32_t P = Q - 1;
+		for (int i = 0; i < 3; ++i)
+		{
+			// if bit is set, invert low bits of X[0]; otherwise exchange low bits of X[0] and X[i].
+			// Branchless, since on real data the bits are quite random.
+			uint32_t set = 0u - ((X[i] & Q) != 0);
+			uint32_t t = (X[0] ^ X[i]) & P & ~set;
+			X[0] ^= (P & set) | t;
+			X[i] ^= t;
+		}
+	}
+	// gray encode
+	X[1] ^= X[0];
+	X[2] ^= X[1];
+	uint32_t t = 0;
+	for (uint32_t Q = M; Q > 1; Q >>= 1)
+	{
+		if (X[2] & Q)
+			t ^= Q - 1;
+	}
+	for (int i = 0; i < 3; ++i)
+		X[i] ^= t;
+	// X[0] has the most significant bit of each 3-bit group
+	return (MortonPart1By2(X[0]) << 2) | (MortonPart1By2(X[1]) << 1) | MortonPart1By2(X[2]);
+}
+
+// Two level: space is split into 16x16x16 tiles visited in linear (x, then y, then z)
+// order, with Morton order of the remaining 17 bits per axis inside each tile.
+const int kTileBits = 4;
+static uint64_t TiledMortonEncode3(uint32_t x, uint32_t y, uint32_t z)
+{
+	const int shift = 21 - kTileBits;
+	const uint64_t tile = (uint64_t(z >> shift) << (kTileBits * 2)) | ((y >> shift) << kTileBits) | (x >> shift);
+	const uint32_t mask = (1u << shift) - 1;
+	return (tile << (shift * 3)) | MortonEncode3(x & mask, y & mask, z & mask);
+}
+
+// Spatial ordering strategy: sort key from 21-bit-per-axis quantized position
+// within the bounding box. Null key function keeps the file order.
+struct OrderDesc
+{
+	const char* name = nullptr;
+	uint64_t (*keyFunc)(uint32_t x, uint32_t y, uint32_t z) = nullptr;
+};
+
+static uint64_t MortonKey(uint32_t x, uint32_t y, uint32_t z) { return MortonEncode3(x, y, z); }
+
+static OrderDesc g_OrderNone = { "none" };
+static OrderDesc g_OrderMorton = { "morton", MortonKey };
+static OrderDesc g_OrderHilbert = { "hilbert", HilbertEncode3 };
+static OrderDesc g_OrderTiledMorton = { "tiled-morton", TiledMortonEncode3 };
+
+static OrderDesc* g_Orders[] =
+{
+	&g_OrderNone,
+	&g_OrderMorton,
+	&g_OrderHilbert,
+	&g_OrderTiledMorton,
+};
+
+// The order of data points does not matter: arrange them along a space filling curve,
+// both for better data delta locality, and for better runtime access
+// (neighboring points would likely get fetched together).
+// Positions are read straight from the memory mapped PLY file, or a window at a time when it is
+// not mapped; false if reading fails.
+static bool CalcSpatialOrder(const TestFile& tf, const OrderDesc& orderDesc, std::vector<uint32_t>& order)
+{
+	TraceZone zone("CalcSpatialOrder", orderDesc.name);
+	order.resize(tf.vertexCount);
+	if (orderDesc.keyFunc == nullptr)
+	{
+		for (size_t i = 0; i < tf.vertexCount; ++i)
+			order[i] = uint32_t(i);
+		return true;
+	}
 
-	// The order of data points does not matter: arrange them in 3D Morton order,
-	// both for better data delta locality, and for better runtime access
-	// (neighboring points would likely get fetched together).
+	const int threads = ParallelGetHardwareThreads();
+	const size_t kChunkVerts = 64 * 1024;
+	const size_t chunkCount = (tf.vertexCount + kChunkVerts - 1) / kChunkVerts;
+	const size_t windowVerts = GetPlyWindowVertices(tf);
+	const size_t srcStride = tf.ply.vertexStride;
+	std::atomic<bool> readOk = true;
 
 	// Find bounding box of positions
+	uint64_t t0 = stm_now();
+	std::vector<float> chunkBounds(chunkCount * 6);
+	ParallelFor(threads, chunkCount, [&](size_t chunk, int)
+	{
+		float* bmin = &chunkBounds[chunk * 6];
+		float* bmax = bmin + 3;
+		bmin[0] = bmin[1] = bmin[2] = FLT_MAX;
+		bmax[0] = bmax[1] = bmax[2] = -FLT_MAX;
+		const size_t end = std::min(tf.vertexCount, (chunk + 1) * kChunkVerts);
+		std::vector<uint8_t> buffer;
+		for (size_t start = chunk * kChunkVerts; start < end; start += windowVerts)
+		{
+			const size_t count = std::min(windowVerts, end - start);
+			const uint8_t* src = GetPlyVertices(tf, start, count, buffer);
+			if (src == nullptr)
+			{
+				readOk = false;
+				return;
+			}
+			for (size_t i = 0; i < count; ++i)
+			{
+				float pos[3];
+				ReadPlyPosition(tf, src + i * srcStride, pos);
+				for (int j = 0; j < 3; ++j)
+				{
+					bmin[j] = std::min(bmin[j], pos[j]);
+					bmax[j] = std::max(bmax[j], pos[j]);
+				}
+			}
+		}
+	});
+	if (!readOk)
+		return false;
 	float bmin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
 	float bmax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
-	const float* posData = (const float*)tf.fileData.data();
-	for (size_t i = 0, dataIdx = 0; i < tf.vertexCount; ++i, dataIdx += tf.vertexStride / 4)
+	for (size_t chunk = 0; chunk < chunkCount; ++chunk)
 	{
-		float x = posData[dataIdx + 0], y = posData[dataIdx + 1], z = posData[dataIdx + 2];
-		bmin[0] = std::min(bmin[0], x);
-		bmin[1] = std::min(bmin[1], y);
-		bmin[2] = std::min(bmin[2], z);
-		bmax[0] = std::max(bmin[0], x);
-		bmax[1] = std::max(bmax[1], y);
-		bmax[2] = std::max(bmax[2], z);
+		for (int j = 0; j < 3; ++j)
+		{
+			bmin[j] = std::min(bmin[j], chunkBounds[chunk * 6 + j]);
+			bmax[j] = std::max(bmax[j], chunkBounds[chunk * 6 + 3 + j]);
+		}
 	}
 	printf("- %s bounds %.2f,%.2f,%.2f .. %.2f,%.2f,%.2f\n", tf.title, bmin[0], bmin[1], bmin[2], bmax[0], bmax[1], bmax[2]);
+	double tBounds = stm_sec(stm_since(t0));
 
-	// Compute Morton codes for the positions, and sort by them
-	std::vector<std::pair<uint64_t, size_t>> remap(tf.vertexCount);
+	// Compute sort keys for the positions
+	t0 = stm_now();
+	std::vector<uint64_t> codes(tf.vertexCount);
 	const float kScaler = float((1<<21)-1);
-	for (size_t i = 0, dataIdx = 0; i < tf.vertexCount; ++i, dataIdx += tf.vertexStride / 4)
-	{
-		float x = (posData[dataIdx + 0] - bmin[0]) / (bmax[0] - bmin[0]) * kScaler;
-		float y = (posData[dataIdx + 1] - bmin[1]) / (bmax[1] - bmin[1]) * kScaler;
-		float z = (posData[dataIdx + 2] - bmin[2]) / (bmax[2] - bmin[2]) * kScaler;
-		uint32_t ix = (uint32_t)x;
-		uint32_t iy = (uint32_t)y;
-		uint32_t iz = (uint32_t)z;
-		uint64_t code = MortonEncode3(ix, iy, iz);
-		remap[i] = { code, i };
-	}
-	std::sort(remap.begin(), remap.end(), [](const auto& a, const auto& b)
-	{
-		if (a.first != b.first)
-			return a.first < b.first;
-		return a.second < b.second;
+	ParallelFor(threads, chunkCount, [&](size_t chunk, int)
+	{
+		const size_t end = std::min(tf.vertexCount, (chunk + 1) * kChunkVerts);
+		std::vector<uint8_t> buffer;
+		for (size_t start = chunk * kChunkVerts; start < end; start += windowVerts)
+		{
+			const size_t count = std::min(windowVerts, end - start);
+			const uint8_t* src = GetPlyVertices(tf, start, count, buffer);
+			if (src == nullptr)
+			{
+				readOk = false;
+				return;
+			}
+			for (size_t i = start; i < start + count; ++i)
+			{
+				float pos[3];
+				ReadPlyPosition(tf, src + (i - start) * srcStride, pos);
+				float x = (pos[0] - bmin[0]) / (bmax[0] - bmin[0]) * kScaler;
+				float y = (pos[1] - bmin[1]) / (bmax[1] - bmin[1]) * kScaler;
+				float z = (pos[2] - bmin[2]) / (bmax[2] - bmin[2]) * kScaler;
+				uint32_t ix = (uint32_t)x;
+				uint32_t iy = (uint32_t)y;
+				uint32_t iz = (uint32_t)z;
+				codes[i] = orderDesc.keyFunc(ix, iy, iz);
+				order[i] = uint32_t(i);
+			}
+		}
 	});
+	if (!readOk)
+		return false;
+	double tCodes = stm_sec(stm_since(t0));
+
+	// Sort by them; sort is stable so equal codes stay in file order
+	t0 = stm_now();
+	RadixSort64(codes.data(), order.data(), tf.vertexCount, threads);
+	double tSort = stm_sec(stm_since(t0));
+	printf("- %s %s order: bounds %.3fs keys %.3fs sort %.3fs\n", tf.title, orderDesc.name, tBounds, tCodes, tSort);
 
-	// Reorder the data
-	std::vector<uint8_t> dst(tf.fileData.size());
-	for (size_t i = 0, idx = 0; i < tf.vertexCount; ++i)
+	if (g_Options.verifyOrder)
 	{
-		size_t srcIdx = remap[i].second * tf.vertexStride;
-		for (size_t j = 0; j < tf.vertexStride; ++j)
-			dst[idx + j] = tf.fileData[srcIdx + j];
-		idx += tf.vertexStride;
+		// Check that each source vertex got used exactly once
+		t0 = stm_now();
+		std::vector<uint8_t> used(tf.vertexCount);
+		for (size_t i = 0; i < tf.vertexCount; ++i)
+			used[order[i]]++;
+		if (std::any_of(used.begin(), used.end(), [](uint8_t u) { return u != 1; }))
+			printf("ERROR in %s remapping of %s\n", orderDesc.name, tf.title);
+		printf("- %s %s order verified in %.3fs\n", tf.title, orderDesc.name, stm_sec(stm_since(t0)));
 	}
+	return true;
+}
 
-	// Reverse reorder the data and check if it matches the source
-	std::vector<uint8_t> check(tf.fileData.size());
-	for (size_t i = 0; i < tf.vertexCount; ++i)
+// Gather vertices from the PLY file in the given order, converting into FullVertex layout.
+// Source vertices are all over the file, so fetch the ones a bit ahead while converting.
+const size_t kGatherPrefetchDistance = 8;
+
+static void GatherPlyVertices(const TestFile& tf, const uint32_t* order, size_t count, FullVertex* dst)
+{
+	TraceZone zone("GatherPlyVertices");
+	const size_t srcStride = tf.ply.vertexStride;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (i + kGatherPrefetchDistance < count)
+		{
+			const uint8_t* next = tf.ply.vertexData + order[i + kGatherPrefetchDistance] * srcStride;
+			for (size_t offset = 0; offset < srcStride; offset += 64)
+				SimdPrefetch(next + offset);
+			SimdPrefetch(next + srcStride - 1);
+		}
+		ReadPlyVertex(tf, order[i], dst[i]);
+	}
+}
+
+static void ReorderData(TestFile& tf, const OrderDesc& orderDesc)
+{
+	TraceZone zone("ReorderData", tf.title);
+	// from the mapped file, so there are no reads that could fail
+	std::vector<uint32_t> order;
+	[[maybe_unused]] const bool ok = CalcSpatialOrder(tf, orderDesc, order);
+	assert(ok);
+	uint64_t t0 = stm_now();
+	tf.fileData.resize(tf.vertexCount * kFullVertexStride);
+	FullVertex* dst = (FullVertex*)tf.fileData.data();
+	const size_t kChunkVerts = 16 * 1024;
+	const size_t chunkCount = (tf.vertexCount + kChunkVerts - 1) / kChunkVerts;
+	ParallelFor(ParallelGetHardwareThreads(), chunkCount, [&](size_t chunk, int)
+	{
+		const size_t start = chunk * kChunkVerts;
+		GatherPlyVertices(tf, order.data() + start, std::min(kChunkVerts, tf.vertexCount - start), dst + start);
+	});
+	printf("- %s gather %.3fs\n", tf.title, stm_sec(stm_since(t0)));
+}
+
+// Runtime locality of the reordered data, when stored as an array of itemStride sized items:
+// - average distance between consecutive splats,
+// - splats are put into cells of a 256^3 grid over the bounds (~what a renderer would fetch
+//   together); total count of cache lines touched when fetching all splats of each cell,
+//   relative to the minimum possible (if splats of each cell were all next to each other).
+static void PrintOrderLocality(const TestFile& tf, const OrderDesc& orderDesc, size_t itemStride)
+{
+	TraceZone zone("PrintOrderLocality", tf.title);
+	assert(tf.vertexStride == kFullVertexStride);
+	const FullVertex* data = (const FullVertex*)tf.fileData.data();
+	const size_t count = tf.vertexCount;
+	if (count < 2)
+		return;
+
+	float bmin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+	float bmax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+	double distSum = 0;
+	for (size_t i = 0; i < count; ++i)
 	{
-		size_t srcIdx = i * tf.vertexStride;
-		size_t dstIdx = remap[i].second * tf.vertexStride;
-		for (size_t j = 0; j < tf.vertexStride; ++j)
-			check[dstIdx + j] = dst[srcIdx + j];
+		const float* pos = &data[i].px;
+		for (int j = 0; j < 3; ++j)
+		{
+			bmin[j] = std::min(bmin[j], pos[j]);
+			bmax[j] = std::max(bmax[j], pos[j]);
+		}
+		if (i > 0)
+		{
+			float dx = pos[0] - data[i - 1].px, dy = pos[1] - data[i - 1].py, dz = pos[2] - data[i - 1].pz;
+			distSum += sqrtf(dx * dx + dy * dy + dz * dz);
+		}
 	}
-	if (0 != memcmp(tf.fileData.data(), check.data(), check.size()))
+
+	// sort (cell, index) so that each cell splats are together, in increasing index order
+	const int kCellBits = 8;
+	const float kScaler = float((1 << kCellBits) - 1);
+	std::vector<uint64_t> keys(count);
+	std::vector<uint32_t> values(count);
+	for (size_t i = 0; i < count; ++i)
 	{
-		printf("ERROR in Morton3D remapping of %s\n", tf.title);
+		const float* pos = &data[i].px;
+		uint64_t cell = 0;
+		for (int j = 0; j < 3; ++j)
+		{
+			float range = bmax[j] - bmin[j];
+			uint32_t c = range > 0 ? uint32_t((pos[j] - bmin[j]) / range * kScaler) : 0;
+			cell = (cell << kCellBits) | c;
+		}
+		keys[i] = (cell << 32) | i;
+		values[i] = uint32_t(i);
 	}
+	RadixSort64(keys.data(), values.data(), count, ParallelGetHardwareThreads());
 
-	tf.fileData.swap(dst);
+	const size_t kCacheLine = 64;
+	size_t linesTouched = 0, linesMin = 0;
+	for (size_t start = 0; start < count; )
+	{
+		const uint64_t cell = keys[start] >> 32;
+		size_t end = start;
+		size_t prevLast = SIZE_MAX;
+		while (end < count && (keys[end] >> 32) == cell)
+		{
+			size_t index = values[end];
+			size_t first = index * itemStride / kCacheLine;
+			size_t last = (index * itemStride + itemStride - 1) / kCacheLine;
+			if (prevLast != SIZE_MAX)
+				first = std::max(first, prevLast + 1);
+			if (last >= first)
+				linesTouched += last - first + 1;
+			prevLast = last;
+			++end;
+		}
+		linesMin += ((end - start) * itemStride + kCacheLine - 1) / kCacheLine;
+		start = end;
+	}
+	printf("- %s %s order locality: neighbor distance avg %.4f, cell cache lines %.3fx of minimum\n", tf.title, orderDesc.name,
+		distSum / (count - 1), double(linesTouched) / double(linesMin));
 }
 
-static void NormalizeRotation(TestFile& tf)
+static void NormalizeRotation(FullVertex* data, size_t count)
 {
-	assert(tf.vertexStride == kFullVertexStride);
-	FullVertex* data = (FullVertex*)tf.fileData.data();
-	for (size_t i = 0; i < tf.vertexCount; ++i)
+	for (size_t i = 0; i < count; ++i)
 	{
 		float x = data->rx;
 		float y = data->ry;
@@ -583,6 +898,14 @@ static void NormalizeRotation(TestFile& tf)
 	}
 }
 
+static void NormalizeRotation(TestFile& tf)
+{
+	TraceZone zone("NormalizeRotation", tf.title);
+	assert(tf.vertexStride == kFullVertexStride);
+	NormalizeRotation((FullVertex*)tf.fileData.data(), tf.vertexCount);
+}
+
+// Precise (libm) versions, as reference for the SIMD FastMath_*OpacityScale (see BenchMathKernels)
 static float Sigmoid(float v)
 {
 	return 1.0f / (1.0f + expf(-v));
@@ -593,72 +916,107 @@ static float InvSigmoid(float v)
 	return logf(v / (std::max(1.0f - v, 1.0e-6f)));
 }
 
+static_assert(offsetof(FullVertex, sz) == offsetof(FullVertex, opacity) + 3 * sizeof(float), "opacity & scale have to be consecutive");
+
+static void LinearizeData(FullVertex* data, size_t count)
+{
+	FastMath_LinearizeOpacityScale(&data->opacity, count, kFullVertexStride);
+}
+
+const size_t kLinearizeChunkVerts = 16 * 1024;
 
 static void LinearizeData(TestFile& tf)
 {
+	TraceZone zone("LinearizeData", tf.title);
 	assert(tf.vertexStride == kFullVertexStride);
 	FullVertex* data = (FullVertex*)tf.fileData.data();
-	for (size_t i = 0; i < tf.vertexCount; ++i)
+	const size_t chunkCount = (tf.vertexCount + kLinearizeChunkVerts - 1) / kLinearizeChunkVerts;
+	ParallelFor(ParallelGetHardwareThreads(), chunkCount, [&](size_t chunk, int)
 	{
-		// opacity
-		data->opacity = Sigmoid(data->opacity);
-		// scale
-		{
-			data->sx = expf(data->sx);
-			data->sy = expf(data->sy);
-			data->sz = expf(data->sz);
+		const size_t start = chunk * kLinearizeChunkVerts;
+		LinearizeData(data + start, std::min(kLinearizeChunkVerts, tf.vertexCount - start));
+	});
+}
 
-			data->sx = sqrtf(data->sx);
-			data->sy = sqrtf(data->sy);
-			data->sz = sqrtf(data->sz);
-			data->sx = sqrtf(data->sx);
-			data->sy = sqrtf(data->sy);
-			data->sz = sqrtf(data->sz);
-		}
-		data++;
-	}
+static void UnlinearizeData(FullVertex* data, size_t count)
+{
+	FastMath_UnlinearizeOpacityScale(&data->opacity, count, kFullVertexStride);
+}
+
+static void UnlinearizeData(FullVertex* data, size_t count, int threadCount)
+{
+	const size_t chunkCount = (count + kLinearizeChunkVerts - 1) / kLinearizeChunkVerts;
+	ParallelFor(threadCount, chunkCount, [&](size_t chunk, int)
+	{
+		const size_t start = chunk * kLinearizeChunkVerts;
+		UnlinearizeData(data + start, std::min(kLinearizeChunkVerts, count - start));
+	});
 }
 
+// Also measures how far the SIMD results are from precise ones (max abs difference, into
+// tf.approxErrOpacity / approxErrScale), for CalcErrorFromOrig
 static void UnlinearizeData(TestFile& tf)
 {
+	TraceZone zone("UnlinearizeData", tf.title);
 	assert(tf.vertexStride == kFullVertexStride);
 	FullVertex* data = (FullVertex*)tf.fileData.data();
-	for (size_t i = 0; i < tf.vertexCount; ++i)
+	const size_t kBatch = 64;
+	const size_t chunkCount = (tf.vertexCount + kLinearizeChunkVerts - 1) / kLinearizeChunkVerts;
+	std::vector<float> chunkErr(chunkCount * 2);
+	ParallelFor(ParallelGetHardwareThreads(), chunkCount, [&](size_t chunk, int)
 	{
-		// opacity
-		data->opacity = InvSigmoid(data->opacity);
-		// scale
+		const size_t end = std::min(tf.vertexCount, (chunk + 1) * kLinearizeChunkVerts);
+		float errOpacity = 0, errScale = 0;
+		for (size_t start = chunk * kLinearizeChunkVerts; start < end; start += kBatch)
 		{
-			data->sx *= data->sx;
-			data->sy *= data->sy;
-			data->sz *= data->sz;
-			data->sx *= data->sx;
-			data->sy *= data->sy;
-			data->sz *= data->sz;
-
-			data->sx = logf(data->sx);
-			data->sy = logf(data->sy);
-			data->sz = logf(data->sz);
+			const size_t count = std::min(kBatch, end - start);
+			float linear[kBatch][4];
+			for (size_t i = 0; i < count; ++i)
+				memcpy(linear[i], &data[start + i].opacity, sizeof(linear[i]));
+			UnlinearizeData(data + start, count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				// NaN differences (of infinities) are ignored by max
+				const float* res = &data[start + i].opacity;
+				const double o = linear[i][0];
+				errOpacity = std::max(errOpacity, float(fabs(res[0] - log(o / std::max(1.0 - o, 1.0e-6)))));
+				for (int j = 1; j < 4; ++j)
+					errScale = std::max(errScale, float(fabs(res[j] - 4.0 * log(double(linear[i][j])))));
+			}
 		}
-		data++;
+		chunkErr[chunk * 2 + 0] = errOpacity;
+		chunkErr[chunk * 2 + 1] = errScale;
+	});
+	tf.approxErrOpacity = 0;
+	tf.approxErrScale = 0;
+	for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		tf.approxErrOpacity = std::max(tf.approxErrOpacity, chunkErr[chunk * 2 + 0]);
+		tf.approxErrScale = std::max(tf.approxErrScale, chunkErr[chunk * 2 + 1]);
 	}
 }
 
 
-static void CalcMinMax(TestFile& tf)
+static void ResetMinMax(FullVertex& vmin, FullVertex& vmax)
 {
-	assert(tf.vertexStride == kFullVertexStride);
-	float* valMax = (float*)&tf.valMax;
-	float* valMin = (float*)&tf.valMin;
-	for (int i = 0; i < kFullVertexFloats; ++i)
+	float* valMax = (float*)&vmax;
+	float* valMin = (float*)&vmin;
+	for (size_t i = 0; i < kFullVertexFloats; ++i)
 	{
 		valMax[i] = -FLT_MAX;
 		valMin[i] = FLT_MAX;
 	}
-	float* data = (float*)tf.fileData.data();
-	for (size_t i = 0; i < tf.vertexCount; ++i)
+}
+
+// Grows vmin/vmax to include given vertices
+static void CalcMinMax(const FullVertex* vertices, size_t count, FullVertex& vmin, FullVertex& vmax)
+{
+	float* valMax = (float*)&vmax;
+	float* valMin = (float*)&vmin;
+	const float* data = (const float*)vertices;
+	for (size_t i = 0; i < count; ++i)
 	{
-		for (int j = 0; j < kFullVertexFloats; ++j)
+		for (size_t j = 0; j < kFullVertexFloats; ++j)
 		{
 			float val = *data++;
 			valMax[j] = std::max(valMax[j], val);
@@ -667,113 +1025,541 @@ static void CalcMinMax(TestFile& tf)
 	}
 }
 
-struct PackedVertex
-{
-	uint16_t px, py, pz;
-	uint16_t dcr, dcg, dcb;
-	uint16_t shr[15];
-	uint16_t shg[15];
-	uint16_t shb[15];
-	uint16_t opacity;
-	uint16_t sx, sy, sz;
-	uint16_t rx, ry, rz, rw;
-};
-constexpr size_t kPackedVertexSize = sizeof(PackedVertex);
-
-static uint32_t Pack16(float vmin, float vmax, float v)
+// Grows vmin/vmax to include the srcMin/srcMax range
+static void MergeMinMax(const FullVertex& srcMin, const FullVertex& srcMax, FullVertex& vmin, FullVertex& vmax)
 {
-	v = (v - vmin) / (vmax - vmin);
-	return meshopt_quantizeUnorm(v, 16);
+	float* valMax = (float*)&vmax;
+	float* valMin = (float*)&vmin;
+	const float* srcMaxPtr = (const float*)&srcMax;
+	const float* srcMinPtr = (const float*)&srcMin;
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+	{
+		valMax[j] = std::max(valMax[j], srcMaxPtr[j]);
+		valMin[j] = std::min(valMin[j], srcMinPtr[j]);
+	}
+}
+
+static void CalcMinMax(TestFile& tf)
+{
+	TraceZone zone("CalcMinMax", tf.title);
+	assert(tf.vertexStride == kFullVertexStride);
+	const FullVertex* data = (const FullVertex*)tf.fileData.data();
+	ResetMinMax(tf.valMin, tf.valMax);
+	CalcMinMax(data, tf.vertexCount, tf.valMin, tf.valMax);
+
+	// per chunk bounds
+	tf.quantChunkSize = g_Options.quantChunkSize;
+	tf.chunkMin.clear();
+	tf.chunkMax.clear();
+	if (tf.quantChunkSize == 0)
+		return;
+	const size_t chunkCount = (tf.vertexCount + tf.quantChunkSize - 1) / tf.quantChunkSize;
+	tf.chunkMin.resize(chunkCount);
+	tf.chunkMax.resize(chunkCount);
+	for (size_t ic = 0; ic < chunkCount; ++ic)
+	{
+		const size_t start = ic * tf.quantChunkSize;
+		ResetMinMax(tf.chunkMin[ic], tf.chunkMax[ic]);
+		CalcMinMax(data + start, std::min(tf.quantChunkSize, tf.vertexCount - start), tf.chunkMin[ic], tf.chunkMax[ic]);
+	}
 }
 
-static float Unpack16(float vmin, float vmax, uint32_t u)
+// SH coefficients (per color channel) up to each SH degree
+static const int kShBandStart[4] = { 0, 3, 8, 15 };
+
+// Layout from bits stored in a compressed container, or of a profile; false when they are not valid
+static bool BuildPackLayout(const uint8_t* bits, size_t count, const char* name, PackLayout& layout)
 {
-	float v = float(u) / float((1 << 16) - 1);
-	return vmin * (1 - v) + vmax * v;
+	if (count != kPackAttributeCount)
+		return false;
+	layout.name = name;
+	for (size_t j = 0; j < kPackAttributeCount; ++j)
+	{
+		if (bits[j] > 16)
+			return false;
+		layout.bits[j] = bits[j];
+	}
+	if (bits[kPackScaleExp] > 1 || bits[kPackShExp] > 1 || (bits[kPackRotQuat] != 0 && (bits[kPackRotQuat] < 4 || bits[kPackRotSmallest3] != 0)))
+		return false;
+	CalcPackRecordSize(layout);
+	return true;
 }
 
-#define PACK_POS(field)		dst->field = Pack16(tf.valMin.field, tf.valMax.field, src->field)
-#define PACK_DC(field)		dst->field = Pack16(tf.valMin.field, tf.valMax.field, src->field)
-#define PACK_OP(field)		dst->field = Pack16(tf.valMin.field, tf.valMax.field, src->field)
-#define PACK_SCALE(field)	dst->field = Pack16(tf.valMin.field, tf.valMax.field, src->field)
-#define PACK_ROT(field)		dst->field = Pack16(tf.valMin.field, tf.valMax.field, src->field)
+// Layout for a profile; SH bands the file does not have are not stored. False when the profile
+// has bit counts that a layout can not store.
+static bool BuildPackLayout(const QuantProfile& profile, int shDegree, PackLayout& layout)
+{
+	FullVertex bits = {};
+	bits.px = profile.pos[0]; bits.py = profile.pos[1]; bits.pz = profile.pos[2];
+	bits.dcr = profile.dc[0]; bits.dcg = profile.dc[1]; bits.dcb = profile.dc[2];
+	const bool shCodebook = profile.shCodebookSize != 0 && shDegree != 0;
+	for (int band = 0; band < shDegree && !shCodebook; ++band)
+	{
+		for (int j = kShBandStart[band]; j < kShBandStart[band + 1]; ++j)
+			bits.shr[j] = bits.shg[j] = bits.shb[j] = float(profile.shMeshOptExp ? profile.shMeshOptExp : profile.sh[band]);
+	}
+	bits.opacity = profile.opacity;
+	if (profile.scaleMeshOptExp)
+		bits.sx = bits.sy = bits.sz = profile.scaleMeshOptExp;
+	else
+	{
+		bits.sx = profile.scale[0]; bits.sy = profile.scale[1]; bits.sz = profile.scale[2];
+	}
+	if (profile.rotSmallest3 == 0 && profile.rotMeshOptQuat == 0)
+	{
+		bits.rw = profile.rot[0]; bits.rx = profile.rot[1]; bits.ry = profile.rot[2]; bits.rz = profile.rot[3];
+	}
 
-#define UNPACK_POS(field)	dst->field = Unpack16(tf.valMin.field, tf.valMax.field, src->field)
-#define UNPACK_DC(field)	dst->field = Unpack16(tf.valMin.field, tf.valMax.field, src->field)
-#define UNPACK_OP(field)	dst->field = Unpack16(tf.valMin.field, tf.valMax.field, src->field)
-#define UNPACK_SCALE(field)	dst->field = Unpack16(tf.valMin.field, tf.valMax.field, src->field)
-#define UNPACK_ROT(field)	dst->field = Unpack16(tf.valMin.field, tf.valMax.field, src->field)
+	// out of range counts become 255, which the validation rejects
+	auto toBits = [](int b) { return uint8_t(b >= 0 && b <= 255 ? b : 255); };
+	uint8_t attributeBits[kPackAttributeCount] = {};
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+		attributeBits[j] = toBits(int(((const float*)&bits)[j]));
+	attributeBits[kPackRotSmallest3] = toBits(profile.rotSmallest3);
+	attributeBits[kPackRotQuat] = toBits(profile.rotMeshOptQuat);
+	attributeBits[kPackScaleExp] = profile.scaleMeshOptExp != 0;
+	attributeBits[kPackShExp] = profile.shMeshOptExp != 0 && shDegree != 0 && !shCodebook;
+	if (shCodebook)
+	{
+		if (profile.shCodebookSize < 0 || profile.shCodebookSize > 65536)
+			return false;
+		int indexBits = 1;
+		while ((1 << indexBits) < profile.shCodebookSize)
+			++indexBits;
+		attributeBits[kPackShIndex] = uint8_t(indexBits);
+	}
+	return BuildPackLayout(attributeBits, kPackAttributeCount, profile.name, layout);
+}
 
+// Layout of a profile that is known to be valid
+static PackLayout BuildPackLayout(const QuantProfile& profile, int shDegree)
+{
+	PackLayout layout;
+	[[maybe_unused]] const bool ok = BuildPackLayout(profile, shDegree, layout);
+	assert(ok);
+	return layout;
+}
 
-static void PackData(TestFile& tf)
+// meshopt exponential filter output is a 24 bit signed mantissa and 8 bit exponent; mantissa of a
+// bits wide filter fits into bits, except when rounding overflows it by one (which gets clamped)
+static uint32_t PackExpMantissa(uint32_t value, int bits)
 {
-	assert(tf.vertexStride == kFullVertexStride);
-	std::vector<uint8_t> dstData(tf.vertexCount * kPackedVertexSize);
+	const int mmax = (1 << (bits - 1)) - 1;
+	const int m = std::clamp(int32_t(value << 8) >> 8, -mmax - 1, mmax);
+	return uint32_t(m) & ((1u << bits) - 1);
+}
 
-	const FullVertex* src = (const FullVertex*)tf.fileData.data();
-	PackedVertex* dst = (PackedVertex*)dstData.data();
-	for (size_t i = 0; i < tf.vertexCount; ++i)
+static uint32_t UnpackExpValue(uint32_t exponent, uint32_t mantissa, int bits)
+{
+	const int32_t m = int32_t(mantissa << (32 - bits)) >> (32 - bits);
+	return (exponent << 24) | (uint32_t(m) & 0xFFFFFF);
+}
+
+// Attributes of the layout that are plain unorm quantized (not meshopt exp filtered, and not empty)
+static int GetUnormAttributes(const PackLayout& layout, int attributes[kFullVertexFloats])
+{
+	int count = 0;
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
 	{
+		if (layout.bits[j] != 0 && GetExpVectorStart(layout, j) < 0)
+			attributes[count++] = j;
+	}
+	return count;
+}
+
+// Plain unorm attributes are quantized a batch of vertices at a time, on SoA data
+const size_t kPackBatch = 64;
 
-		PACK_POS(px); PACK_POS(py); PACK_POS(pz);
-		PACK_DC(dcr); PACK_DC(dcg); PACK_DC(dcb);
-		for (int j = 0; j < 15; ++j)
+// shIndices (SH codebook index of each vertex) are only used if layout has SH index bits
+static void PackData(const FullVertex* src, uint8_t* dst, size_t count, const PackLayout& layout, const FullVertex& valMin, const FullVertex& valMax, const uint32_t* shIndices)
+{
+	const float* vmin = (const float*)&valMin;
+	const float* vmax = (const float*)&valMax;
+	const int shIndexBits = layout.bits[kPackShIndex];
+	const int rotBits = layout.bits[kPackRotSmallest3];
+	const int quatBits = layout.bits[kPackRotQuat];
+	int expStart[kFullVertexFloats];
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+		expStart[j] = GetExpVectorStart(layout, j);
+	int unormAttributes[kFullVertexFloats];
+	const int unormCount = GetUnormAttributes(layout, unormAttributes);
+	float invRange[kFullVertexFloats];
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+		invRange[j] = QuantCalcInvRange(vmin[j], vmax[j]);
+	float values[kPackBatch];
+	uint16_t quantized[kFullVertexFloats][kPackBatch];
+	for (size_t batchStart = 0; batchStart < count; batchStart += kPackBatch)
+	{
+		const size_t batchCount = std::min(kPackBatch, count - batchStart);
+		for (int k = 0; k < unormCount; ++k)
 		{
-			dst->shr[j] = Pack16(tf.valMin.shr[j], tf.valMax.shr[j], src->shr[j]);
-			dst->shg[j] = Pack16(tf.valMin.shg[j], tf.valMax.shg[j], src->shg[j]);
-			dst->shb[j] = Pack16(tf.valMin.shb[j], tf.valMax.shb[j], src->shb[j]);
+			const int j = unormAttributes[k];
+			for (size_t i = 0; i < batchCount; ++i)
+				values[i] = ((const float*)(src + batchStart + i))[j];
+			Quant_PackUnorm(values, quantized[j], batchCount, vmin[j], invRange[j], layout.bits[j]);
+		}
+		for (size_t bi = 0; bi < batchCount; ++bi)
+		{
+			const size_t i = batchStart + bi;
+			const float* s = (const float*)(src + i);
+			uint8_t* d = dst + i * layout.recordSize;
+			uint64_t acc = 0;
+			int accBits = 0;
+			uint32_t expValues[kFullVertexFloats];
+			for (size_t j = 0; j < kFullVertexFloats; ++j)
+			{
+				const int bits = layout.bits[j];
+				if (bits == 0)
+					continue;
+				if (expStart[j] < 0)
+				{
+					WriteBits(quantized[j][bi], bits, acc, accBits, d);
+					continue;
+				}
+				if (expStart[j] == int(j))
+				{
+					int size = 1;
+					while (j + size < kFullVertexFloats && expStart[j + size] == int(j) && layout.bits[j + size])
+						++size;
+					meshopt_encodeFilterExp(&expValues[j], 1, size * sizeof(float), bits, s + j);
+					WriteBits(expValues[j] >> 24, 8, acc, accBits, d);
+				}
+				WriteBits(PackExpMantissa(expValues[j], bits), bits, acc, accBits, d);
+			}
+			if (shIndexBits != 0)
+				WriteBits(shIndices[i], shIndexBits, acc, accBits, d);
+			if (rotBits != 0)
+			{
+				QuatSmallest3 q = QuatEncodeSmallest3(&src[i].rw, rotBits);
+				WriteBits(q.index, 2, acc, accBits, d);
+				WriteBits(q.a, rotBits, acc, accBits, d);
+				WriteBits(q.b, rotBits, acc, accBits, d);
+				WriteBits(q.c, rotBits, acc, accBits, d);
+			}
+			if (quatBits != 0)
+			{
+				const float q[4] = { src[i].rx, src[i].ry, src[i].rz, src[i].rw };
+				uint16_t e[4];
+				meshopt_encodeFilterQuat(e, 1, sizeof(e), quatBits, q);
+				WriteBits(e[3] & 3, 2, acc, accBits, d);
+				for (int k = 0; k < 3; ++k)
+					WriteBits(e[k] & ((1u << quatBits) - 1), quatBits, acc, accBits, d);
+			}
+			if (accBits > 0)
+				*d++ = uint8_t(acc);
 		}
-		PACK_OP(opacity);
-		PACK_SCALE(sx); PACK_SCALE(sy); PACK_SCALE(sz);
-		PACK_ROT(rx); PACK_ROT(ry); PACK_ROT(rz); PACK_ROT(rw);
-		++src;
-		++dst;
 	}
-
-	tf.fileData.swap(dstData);
-	tf.vertexStride = kPackedVertexSize;
 }
 
-static void UnpackData(TestFile& tf)
+// Trains SH codebook on all vertices (which are in spatial order by now),
+// and finds codebook index of each vertex
+static void BuildShCodebook(TestFile& tf, size_t codebookSize, std::vector<uint32_t>& outIndices)
 {
-	assert(tf.vertexStride == kPackedVertexSize);
-	std::vector<uint8_t> dstData(tf.vertexCount * kFullVertexStride);
-
-	const PackedVertex* src = (const PackedVertex*)tf.fileData.data();
-	FullVertex* dst = (FullVertex*)dstData.data();
+	TraceZone zone("BuildShCodebook", tf.title);
+	ShCodebook& codebook = tf.shCodebook;
+	codebook.coeffCount = kShBandStart[tf.plyLayout.shDegree];
+	const size_t coeffs = codebook.coeffCount;
+	const size_t dim = codebook.GetDim();
+	const FullVertex* src = (const FullVertex*)tf.fileData.data();
+	std::vector<float> points(tf.vertexCount * dim);
 	for (size_t i = 0; i < tf.vertexCount; ++i)
 	{
+		float* dst = points.data() + i * dim;
+		memcpy(dst, src[i].shr, coeffs * sizeof(float));
+		memcpy(dst + coeffs, src[i].shg, coeffs * sizeof(float));
+		memcpy(dst + coeffs * 2, src[i].shb, coeffs * sizeof(float));
+	}
+
+	uint64_t t0 = stm_now();
+	KMeansSettings settings;
+	settings.clusterCount = codebookSize;
+	settings.threadCount = ParallelGetHardwareThreads();
+	codebook.entries.resize(codebookSize * dim);
+	outIndices.resize(tf.vertexCount);
+	KMeansTrain(points.data(), tf.vertexCount, dim, settings, codebook.entries.data(), outIndices.data());
+	printf("- %s SH codebook: %zi entries of %zi floats, %.3fs\n", tf.title, codebookSize, dim, stm_sec(stm_since(t0)));
+}
+
+static void PackData(TestFile& tf, const QuantProfile& profile)
+{
+	TraceZone zone("PackData", tf.title);
+	assert(tf.vertexStride == kFullVertexStride);
+	tf.packLayout = BuildPackLayout(profile, tf.plyLayout.shDegree);
+	const PackLayout& layout = tf.packLayout;
+	tf.shCodebook = ShCodebook();
+	std::vector<uint32_t> shIndices;
+	if (layout.bits[kPackShIndex] != 0)
+		BuildShCodebook(tf, profile.shCodebookSize, shIndices);
+
+	std::vector<uint8_t> dstData(tf.vertexCount * layout.recordSize);
+	const FullVertex* src = (const FullVertex*)tf.fileData.data();
+	uint8_t* dst = dstData.data();
+	if (tf.quantChunkSize == 0)
+		PackData(src, dst, tf.vertexCount, layout, tf.valMin, tf.valMax, shIndices.data());
+	for (size_t ic = 0; ic < tf.chunkMin.size(); ++ic)
+	{
+		const size_t start = ic * tf.quantChunkSize;
+		PackData(src + start, dst + start * layout.recordSize, std::min(tf.quantChunkSize, tf.vertexCount - start), layout, tf.chunkMin[ic], tf.chunkMax[ic], shIndices.data() + (shIndices.empty() ? 0 : start));
+	}
+	tf.fileData.swap(dstData);
+	tf.vertexStride = layout.recordSize;
+}
 
-		UNPACK_POS(px); UNPACK_POS(py); UNPACK_POS(pz);
-		UNPACK_DC(dcr); UNPACK_DC(dcg); UNPACK_DC(dcb);
-		for (int j = 0; j < 15; ++j)
+// shCodebook is only used if layout has SH index bits
+static void UnpackData(const uint8_t* src, FullVertex* dst, size_t count, const PackLayout& layout, const FullVertex& valMin, const FullVertex& valMax, const ShCodebookView& shCodebook)
+{
+	const float* vmin = (const float*)&valMin;
+	const float* vmax = (const float*)&valMax;
+	const int shIndexBits = layout.bits[kPackShIndex];
+	const size_t shCoeffs = std::min<size_t>(shCodebook.coeffCount, 15);
+	const size_t shEntries = shCodebook.size;
+	const size_t shDim = shCodebook.coeffCount * 3;
+	const int rotBits = layout.bits[kPackRotSmallest3];
+	const int quatBits = layout.bits[kPackRotQuat];
+	const bool scaleExp = layout.bits[kPackScaleExp] != 0;
+	const bool shExp = layout.bits[kPackShExp] != 0;
+	int expStart[kFullVertexFloats];
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+		expStart[j] = GetExpVectorStart(layout, j);
+	int unormAttributes[kFullVertexFloats];
+	const int unormCount = GetUnormAttributes(layout, unormAttributes);
+	// meshopt filtered scale and SH go into compact arrays (only the stored SH coefficients of each
+	// color), decoded with the same vector sizes as PackData encoded them
+	size_t shExpCoeffs = 0;
+	while (shExp && shExpCoeffs < 15 && layout.bits[kFloatShStart + shExpCoeffs] != 0)
+		++shExpCoeffs;
+	const size_t shExpFloats = shExpCoeffs * 3;
+	// plain unorm attributes, smallest-three rotations and meshopt filtered attributes are gathered
+	// and decoded a batch at a time
+	const size_t kRotBatch = kPackBatch;
+	float values[kPackBatch];
+	uint16_t quantized[kFullVertexFloats][kPackBatch];
+	QuatSmallest3 rotations[kRotBatch];
+	int16_t quats[kRotBatch * 4];
+	uint32_t expScale[kRotBatch * 3];
+	uint32_t expSh[kRotBatch * 45];
+	for (size_t batchStart = 0; batchStart < count; batchStart += kRotBatch)
+	{
+		const size_t batchCount = std::min(kRotBatch, count - batchStart);
+		for (size_t i = 0; i < batchCount; ++i)
+		{
+			const uint8_t* s = src + (batchStart + i) * layout.recordSize;
+			float* d = (float*)(dst + batchStart + i);
+			uint64_t acc = 0;
+			int accBits = 0;
+			uint32_t exponent = 0;
+			uint32_t* e = nullptr;
+			for (size_t j = 0; j < kFullVertexFloats; ++j)
+			{
+				const int bits = layout.bits[j];
+				if (bits == 0)
+					d[j] = 0.0f;
+				else if (expStart[j] < 0)
+					quantized[j][i] = uint16_t(ReadBits(bits, acc, accBits, s));
+				else
+				{
+					if (expStart[j] == int(j))
+					{
+						exponent = ReadBits(8, acc, accBits, s);
+						e = j == kFloatScaleStart ? expScale + i * 3 : expSh + i * shExpFloats + (j - kFloatShStart) / 15 * shExpCoeffs;
+					}
+					*e++ = UnpackExpValue(exponent, ReadBits(bits, acc, accBits, s), bits);
+				}
+			}
+			if (shIndexBits != 0)
+			{
+				const uint32_t index = ReadBits(shIndexBits, acc, accBits, s);
+				FullVertex& v = dst[batchStart + i];
+				if (index < shEntries)
+				{
+					const float* entry = shCodebook.entries + index * shDim;
+					memcpy(v.shr, entry, shCoeffs * sizeof(float));
+					memcpy(v.shg, entry + shCodebook.coeffCount, shCoeffs * sizeof(float));
+					memcpy(v.shb, entry + shCodebook.coeffCount * 2, shCoeffs * sizeof(float));
+				}
+				else
+				{
+					// corrupt index; no SH rather than whatever was in dst
+					memset(v.shr, 0, shCoeffs * sizeof(float));
+					memset(v.shg, 0, shCoeffs * sizeof(float));
+					memset(v.shb, 0, shCoeffs * sizeof(float));
+				}
+			}
+			if (rotBits != 0)
+			{
+				QuatSmallest3& q = rotations[i];
+				q.index = ReadBits(2, acc, accBits, s);
+				q.a = ReadBits(rotBits, acc, accBits, s);
+				q.b = ReadBits(rotBits, acc, accBits, s);
+				q.c = ReadBits(rotBits, acc, accBits, s);
+			}
+			if (quatBits != 0)
+			{
+				int16_t* q = quats + i * 4;
+				q[3] = int16_t((meshopt_quantizeSnorm(1.0f, quatBits) & ~3) | ReadBits(2, acc, accBits, s));
+				for (int k = 0; k < 3; ++k)
+					q[k] = int16_t(int32_t(ReadBits(quatBits, acc, accBits, s) << (32 - quatBits)) >> (32 - quatBits));
+			}
+		}
+		for (int k = 0; k < unormCount; ++k)
+		{
+			const int j = unormAttributes[k];
+			Quant_UnpackUnorm(quantized[j], values, batchCount, vmin[j], vmax[j], layout.bits[j]);
+			for (size_t i = 0; i < batchCount; ++i)
+				((float*)(dst + batchStart + i))[j] = values[i];
+		}
+		if (rotBits != 0)
+			QuatDecodeSmallest3(rotations, batchCount, rotBits, &dst[batchStart].rw, kFullVertexStride);
+		if (quatBits != 0)
+		{
+			meshopt_decodeFilterQuat(quats, batchCount, 4 * sizeof(int16_t));
+			for (size_t i = 0; i < batchCount; ++i)
+			{
+				FullVertex& v = dst[batchStart + i];
+				const int16_t* q = quats + i * 4;
+				v.rx = q[0] / 32767.0f; v.ry = q[1] / 32767.0f; v.rz = q[2] / 32767.0f; v.rw = q[3] / 32767.0f;
+			}
+		}
+		if (scaleExp)
+		{
+			meshopt_decodeFilterExp(expScale, batchCount, 3 * sizeof(float));
+			for (size_t i = 0; i < batchCount; ++i)
+				memcpy(&dst[batchStart + i].sx, expScale + i * 3, 3 * sizeof(float));
+		}
+		if (shExpFloats != 0)
 		{
-			dst->shr[j] = Unpack16(tf.valMin.shr[j], tf.valMax.shr[j], src->shr[j]);
-			dst->shg[j] = Unpack16(tf.valMin.shg[j], tf.valMax.shg[j], src->shg[j]);
-			dst->shb[j] = Unpack16(tf.valMin.shb[j], tf.valMax.shb[j], src->shb[j]);
+			meshopt_decodeFilterExp(expSh, batchCount, shExpFloats * sizeof(float));
+			for (size_t i = 0; i < batchCount; ++i)
+			{
+				FullVertex& v = dst[batchStart + i];
+				const uint32_t* e = expSh + i * shExpFloats;
+				memcpy(v.shr, e, shExpCoeffs * sizeof(float));
+				memcpy(v.shg, e + shExpCoeffs, shExpCoeffs * sizeof(float));
+				memcpy(v.shb, e + shExpCoeffs * 2, shExpCoeffs * sizeof(float));
+			}
 		}
-		UNPACK_OP(opacity);
-		UNPACK_SCALE(sx); UNPACK_SCALE(sy); UNPACK_SCALE(sz);
-		UNPACK_ROT(rx); UNPACK_ROT(ry); UNPACK_ROT(rz); UNPACK_ROT(rw);
-		++src;
-		++dst;
 	}
+}
+
+// Unpacks data in the file's pack layout with the file's global or chunk bounds, on threadCount threads
+static void UnpackData(const TestFile& tf, const uint8_t* src, FullVertex* dst, int threadCount)
+{
+	const PackLayout& layout = tf.packLayout;
+	const size_t chunkElems = tf.quantChunkSize ? tf.quantChunkSize : std::max<size_t>(tf.vertexCount, 1);
+	const size_t jobCount = (tf.vertexCount + kLinearizeChunkVerts - 1) / kLinearizeChunkVerts;
+	ParallelFor(threadCount, jobCount, [&](size_t jobIndex, int)
+	{
+		const size_t end = std::min((jobIndex + 1) * kLinearizeChunkVerts, tf.vertexCount);
+		for (size_t index = jobIndex * kLinearizeChunkVerts; index < end;)
+		{
+			// parts do not cross quantization chunks
+			const size_t chunk = index / chunkElems;
+			const size_t count = std::min(end - index, (chunk + 1) * chunkElems - index);
+			const FullVertex& vmin = tf.quantChunkSize ? tf.chunkMin[chunk] : tf.valMin;
+			const FullVertex& vmax = tf.quantChunkSize ? tf.chunkMax[chunk] : tf.valMax;
+			UnpackData(src + index * layout.recordSize, dst + index, count, layout, vmin, vmax, tf.shCodebook);
+			index += count;
+		}
+	});
+}
+
+// Unpacks packed file data
+static void UnpackData(const TestFile& tf, FullVertex* dst)
+{
+	assert(tf.vertexStride == tf.packLayout.recordSize);
+	UnpackData(tf, tf.fileData.data(), dst, ParallelGetHardwareThreads());
+}
 
+static void UnpackData(TestFile& tf)
+{
+	TraceZone zone("UnpackData", tf.title);
+	std::vector<uint8_t> dstData(tf.vertexCount * kFullVertexStride);
+	UnpackData(tf, (FullVertex*)dstData.data());
 	tf.fileData.swap(dstData);
 	tf.vertexStride = kFullVertexStride;
 }
 
-#undef PACK_POS
-#undef PACK_DC
-#undef PACK_OP
-#undef PACK_SCALE
-#undef PACK_ROT
-
-#undef UNPACK_POS
-#undef UNPACK_DC
-#undef UNPACK_OP
-#undef UNPACK_SCALE
-#undef UNPACK_ROT
+// Fused decode: each block is decompressed & unfiltered into thread scratch, then unpacked and
+// unlinearized into dst a tile at a time, so the packed block and the tile stay in cache and dst
+// is written once, instead of separate passes over all the data for each stage. That holds for
+// blocks of up to about L2 size; without blocks, the whole packed data goes through scratch.
+// Pack layout, SH codebook and bounds all come from the container; only the splat count has to
+// match the file.
+bool CompressorConfig::DecompressFused(const TestFile& tf, const uint8_t* compressed, size_t compressedSize, FullVertex* dst, ScratchArenas& arenas)
+{
+	TraceZone zone("DecompressFused", tf.title);
+	ContainerInfo info;
+	if (IsStreamSplit() || !ContainerParse(compressed, compressedSize, info))
+		return false;
+	const ContainerHeader& header = info.header;
+	const size_t chunkElems = header.boundsChunkElems ? header.boundsChunkElems : std::max<size_t>(header.elemCount, 1);
+	const size_t chunkCount = (header.elemCount + chunkElems - 1) / chunkElems;
+	PackLayout layout;
+	const bool layoutOk = BuildPackLayout(info.attributeBits, header.attributeCount, "file", layout) &&
+		header.codebookDim % 3 == 0 && (header.codebookCount != 0 || layout.bits[kPackShIndex] == 0);
+	const ShCodebookView shCodebook(info.codebook, header.codebookCount, header.codebookDim / 3);
+	if (!MatchesContainer(header) || !layoutOk || header.elemCount != tf.vertexCount || header.elemStride != layout.recordSize ||
+		header.boundsCount != std::max<size_t>(chunkCount, 1) * kFullVertexFloats)
+	{
+		printf("ERROR: compressed data does not match %s (%llu items of %u bytes)\n", tf.title, (unsigned long long)header.elemCount, header.elemStride);
+		return false;
+	}
+	if (!cmp->SetDictionary(info.dictionary, header.dictionarySize))
+	{
+		printf("ERROR: failed to load %u byte compression dictionary for %s\n", header.dictionarySize, tf.title);
+		return false;
+	}
+	const FullVertex* boundsMin = (const FullVertex*)info.boundsMin;
+	const FullVertex* boundsMax = (const FullVertex*)info.boundsMax;
+
+	// 256 splats are 62KB unpacked; with the packed block, that fits L2 (and L1 on some CPUs)
+	const size_t kTileElems = 256;
+	const size_t blockCount = header.blockCount;
+	const size_t blockElems = header.blockElemCount;
+	const int threads = int(std::min<size_t>(threadCount, blockCount));
+	arenas.Prepare(threads, CalcDecodeScratchSize(header) + ScratchArenaAllocSize(blockElems * header.elemStride));
+	std::atomic<bool> ok = true;
+	ParallelFor(threads, blockCount, [&](size_t blockIndex, int threadIndex)
+	{
+		const ContainerBlock& block = info.blocks[blockIndex];
+		const uint8_t* packed = info.data + block.offset;
+		if (!(block.flags & kContainerBlockStored))
+		{
+			ScratchArena& scratch = arenas.Get(threadIndex);
+			scratch.Reset();
+			uint8_t* decoded = scratch.Alloc(size_t(block.elemCount) * header.elemStride);
+			if (!DecompressBlock(packed, block.size, block, block.elemCount, header.elemStride, scratch, decoded))
+			{
+				ok = false;
+				return;
+			}
+			packed = decoded;
+		}
+		else if (block.size != size_t(block.elemCount) * header.elemStride)
+		{
+			ok = false;
+			return;
+		}
+		TraceZone unpackZone("UnpackBlock");
+		const size_t blockStart = blockIndex * blockElems;
+		for (size_t i = 0; i < block.elemCount;)
+		{
+			// tiles do not cross quantization chunks
+			const size_t index = blockStart + i;
+			const size_t chunk = index / chunkElems;
+			const size_t count = std::min({ kTileElems, block.elemCount - i, (chunk + 1) * chunkElems - index });
+			UnpackData(packed + i * header.elemStride, dst + index, count, layout, boundsMin[chunk], boundsMax[chunk], shCodebook);
+			UnlinearizeData(dst + index, count);
+			i += count;
+		}
+	});
+	if (!ok)
+	{
+		printf("ERROR: blocks of %s did not decompress to their size in the block table\n", tf.title);
+		return false;
+	}
+	return true;
+}
 
 static void QuatConjugate(const float q[4], float r[4])
 {
@@ -788,13 +1574,13 @@ static void QuatMul(const float a[4], const float b[4], float r[4])
 	r[0] = a[3] * b[0] + (a[0] * b[3] + a[1] * b[2]) - a[2] * b[1];
 	r[1] = a[3] * b[1] + (a[1] * b[3] + a[2] * b[0]) - a[0] * b[2];
 	r[2] = a[3] * b[2] + (a[2] * b[3] + a[0] * b[1]) - a[1] * b[0];
-	r[3] = a[3] * b[3] - (a[3] * b[0] + a[1] * b[1]) - a[2] * b[2];
+	r[3] = a[3] * b[3] - (a[0] * b[0] + a[1] * b[1]) - a[2] * b[2];
 }
 
 static void QuatNormalize(float q[4])
 {
 	float lensq = q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
-	float len = 1.0f / lensq;
+	float len = sqrtf(lensq);
 	q[0] /= len; q[1] /= len; q[2] /= len; q[3] /= len;
 }
 
@@ -807,24 +1593,28 @@ static float QuatAngleBetween(const float q1[4], const float q2[4])
 	QuatNormalize(qm);
 
 	float vecLenSq = qm[0] * qm[0] + qm[1] * qm[1] + qm[2] * qm[2];
-	float a = asinf(sqrtf(vecLenSq));
+	float a = asinf(sqrtf(std::min(vecLenSq, 1.0f)));
 	return a * 2;
 }
 
-static void CalcErrorFromOrig(TestFile& tf)
+struct ErrorStats
 {
-	assert(tf.vertexStride == kFullVertexStride);
-	memset(&tf.errMax, 0, sizeof(tf.errMax));
-	memset(&tf.errAvg, 0, sizeof(tf.errAvg));
-	const float* src1 = (const float*)tf.origFileData.data();
-	const float* src2 = (const float*)tf.fileData.data();
-	float* errSumPtr = (float*)&tf.errAvg;
-	float* errMaxPtr = (float*)&tf.errMax;
+	FullVertex errMax = {};
+	FullVertex errSum = {};
 	float errRotSum = 0;
 	float errRotMax = 0;
-	for (size_t i = 0; i < tf.vertexCount; ++i)
+	size_t count = 0;
+};
+
+static void AccumulateError(const FullVertex* orig, const FullVertex* data, size_t count, ErrorStats& err)
+{
+	const float* src1 = (const float*)orig;
+	const float* src2 = (const float*)data;
+	float* errSumPtr = (float*)&err.errSum;
+	float* errMaxPtr = (float*)&err.errMax;
+	for (size_t i = 0; i < count; ++i)
 	{
-		for (int j = 0; j < kFullVertexFloats; ++j)
+		for (size_t j = 0; j < kFullVertexFloats; ++j)
 		{
 			float diff = fabsf(*src1 - *src2);
 			errSumPtr[j] += diff;
@@ -834,71 +1624,1335 @@ static void CalcErrorFromOrig(TestFile& tf)
 		}
 		// evaluate rotation error
 		{
-			const FullVertex& v1 = ((const FullVertex*)tf.origFileData.data())[i];
-			const FullVertex& v2 = ((const FullVertex*)tf.fileData.data())[i];
+			const FullVertex& v1 = orig[i];
+			const FullVertex& v2 = data[i];
 			float q1[4] = { v1.rx, v1.ry, v1.rz, v1.rw };
 			float q2[4] = { v2.rx, v2.ry, v2.rz, v2.rw };
 			float diff = QuatAngleBetween(q1, q2);
-			errRotSum += diff;
-			errRotMax = std::max(errRotMax, diff);
+			err.errRotSum += diff;
+			err.errRotMax = std::max(err.errRotMax, diff);
 		}
 	}
-	for (int j = 0; j < kFullVertexFloats; ++j)
+	err.count += count;
+}
+
+static void PrintError(const char* title, const ErrorStats& err, FullVertex& outErrMax, FullVertex& outErrAvg)
+{
+	outErrMax = err.errMax;
+	float* errAvgPtr = (float*)&outErrAvg;
+	const float* errSumPtr = (const float*)&err.errSum;
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
 	{
-		errSumPtr[j] /= tf.vertexCount;
+		errAvgPtr[j] = errSumPtr[j] / err.count;
 	}
-	float errRotAvg = errRotSum /= tf.vertexCount;
-
-	float errPosMax = std::max(tf.errMax.px, std::max(tf.errMax.py, tf.errMax.pz));
-	float errPosAvg = (tf.errAvg.px + tf.errAvg.py + tf.errAvg.pz) / 3.0f;
-	float errDcMax = std::max(tf.errMax.dcr, std::max(tf.errMax.dcg, tf.errMax.dcb));
-	float errDcAvg = (tf.errAvg.dcr + tf.errAvg.dcg + tf.errAvg.dcb) / 3.0f;
-	float errScaleMax = std::max(tf.errMax.sx, std::max(tf.errMax.sy, tf.errMax.sz));
-	float errScaleAvg = (tf.errAvg.sx + tf.errAvg.sy + tf.errAvg.sz) / 3.0f;
+	float errRotAvg = err.errRotSum / err.count;
+	float errRotMax = err.errRotMax;
+	const FullVertex& errMax = outErrMax;
+	const FullVertex& errAvg = outErrAvg;
+
+	float errPosMax = std::max(errMax.px, std::max(errMax.py, errMax.pz));
+	float errPosAvg = (errAvg.px + errAvg.py + errAvg.pz) / 3.0f;
+	float errDcMax = std::max(errMax.dcr, std::max(errMax.dcg, errMax.dcb));
+	float errDcAvg = (errAvg.dcr + errAvg.dcg + errAvg.dcb) / 3.0f;
+	float errScaleMax = std::max(errMax.sx, std::max(errMax.sy, errMax.sz));
+	float errScaleAvg = (errAvg.sx + errAvg.sy + errAvg.sz) / 3.0f;
+	float errShMax = 0, errShAvg = 0;
+	for (int j = 0; j < 15; ++j)
+	{
+		errShMax = std::max(errShMax, std::max(errMax.shr[j], std::max(errMax.shg[j], errMax.shb[j])));
+		errShAvg += errAvg.shr[j] + errAvg.shg[j] + errAvg.shb[j];
+	}
+	errShAvg /= 45.0f;
 
-	printf("Packing error on %s:\n", tf.title);
+	printf("Packing error on %s:\n", title);
 	printf("  - pos avg %7.4f max %7.4f\n", errPosAvg, errPosMax);
 	printf("  - rot avg %7.4f max %7.4f\n", errRotAvg, errRotMax);
 	printf("  - scl avg %7.4f max %7.4f\n", errScaleAvg, errScaleMax);
 	printf("  - col avg %7.4f max %7.4f\n", errDcAvg, errDcMax);
-	printf("  - opa avg %7.4f max %7.4f\n", tf.errAvg.opacity, tf.errMax.opacity);
+	printf("  - sh  avg %7.4f max %7.4f\n", errShAvg, errShMax);
+	printf("  - opa avg %7.4f max %7.4f\n", errAvg.opacity, errMax.opacity);
+}
+
+static void CalcErrorFromOrig(TestFile& tf)
+{
+	TraceZone zone("CalcErrorFromOrig", tf.title);
+	assert(tf.vertexStride == kFullVertexStride);
+	ErrorStats err;
+	AccumulateError((const FullVertex*)tf.origFileData.data(), (const FullVertex*)tf.fileData.data(), tf.vertexCount, err);
+	char title[1000];
+	if (tf.quantChunkSize)
+	{
+		const size_t boundsSize = tf.chunkMin.size() * kFullVertexStride * 2;
+		snprintf(title, sizeof(title), "%s, %s, bounds per %zi splats (%.1fMB, %.2f bytes/splat)", tf.title, tf.packLayout.name, tf.quantChunkSize, boundsSize / 1024.0 / 1024.0, double(boundsSize) / tf.vertexCount);
+	}
+	else
+		snprintf(title, sizeof(title), "%s, %s, global bounds", tf.title, tf.packLayout.name);
+	PrintError(title, err, tf.errMax, tf.errAvg);
+	printf("  - of it from SIMD exp/log: scl max %.1e opa max %.1e (exp/log rel. error bounds %.1e/%.1e)\n", tf.approxErrScale, tf.approxErrOpacity, kFastExpMaxRelError, kFastLogMaxRelError);
+}
+
+// Streaming conversion: PLY file -> Morton order -> normalize/linearize -> pack -> filter -> compress
+// -> output file, one compression block at a time. The whole scene is never in memory; what
+// does scale with scene size is just the 4 bytes/splat Morton order table (and the 16 bytes/splat
+// while sorting it). The output is the same container as CompressorConfig::Compress makes of packed data.
+// Memory cap limits how many blocks are in flight at once (at most one per thread).
+struct StreamBlockBuffers
+{
+	std::vector<uint8_t> plyData; // raw PLY vertices read from the file
+	std::vector<FullVertex> full;
+	std::vector<uint8_t> packed;
+	std::vector<uint8_t> filtered;
+	std::vector<uint8_t> compressed;
+	size_t compressedSize = 0;
+	ScratchArena scratch; // decoding
+};
+// Vertices in spatial order are all over the PLY file; they are read one run of consecutive
+// vertices at a time
+static bool StreamGatherPlyVertices(const TestFile& tf, const uint32_t* order, size_t count, FullVertex* dst, std::vector<uint8_t>& buffer)
+{
+	TraceZone zone("StreamGatherPlyVertices");
+	const size_t srcStride = tf.ply.vertexStride;
+	const size_t maxRun = GetPlyWindowVertices(tf);
+	for (size_t i = 0; i < count;)
+	{
+		size_t run = 1;
+		while (i + run < count && run < maxRun && order[i + run] == order[i] + run)
+			++run;
+		const uint8_t* src = GetPlyVertices(tf, order[i], run, buffer);
+		if (src == nullptr)
+			return false;
+		for (size_t k = 0; k < run; ++k)
+			ConvertPlyVertex(tf, src + k * srcStride, dst[i + k]);
+		i += run;
+	}
+	return true;
+}
+
+static void StreamSampleMemory(TestFile& tf)
+{
+	tf.streamPeakMemory = std::max(tf.streamPeakMemory, SysInfoGetCurrentMemory());
 }
 
+static size_t GetStreamBlockVertices(const CompressorConfig& config, size_t recordSize)
+{
+	BlockSize blockSize = config.blockSizeEnum == kBSizeNone ? kBSize1M : config.blockSizeEnum;
+	return kBlockSizeToActualSize[blockSize] / recordSize;
+}
 
+static size_t GetStreamBlocksInFlight(size_t blockVerts, size_t recordSize, int threadCount, size_t memoryCap)
+{
+	const size_t bytesPerVertex = kFullVertexStride + recordSize * 3; // full + packed + filtered + compressed
+	size_t blockMemory = blockVerts * bytesPerVertex + kPlyReadWindowBytes;
+	size_t inFlight = memoryCap / blockMemory;
+	if (inFlight == 0)
+	{
+		printf("  WARN: memory cap %.1fMB is less than one block needs (%.1fMB)\n", memoryCap / 1024.0 / 1024.0, blockMemory / 1024.0 / 1024.0);
+		inFlight = 1;
+	}
+	return std::min<size_t>(inFlight, std::max(threadCount, 1));
+}
 
-int main()
+static bool StreamCalcMinMax(const TestFile& tf, size_t blockVerts, size_t inFlight, FullVertex& valMin, FullVertex& valMax)
 {
-	stm_setup();
-	printf("CPU: '%s' Compiler: '%s'\n", SysInfoGetCpuName().c_str(), SysInfoGetCompilerName().c_str());
+	TraceZone zone("StreamCalcMinMax", tf.title);
+	// min/max does not depend on the order, so just go through the file linearly
+	const size_t blockCount = (tf.vertexCount + blockVerts - 1) / blockVerts;
+	std::vector<StreamBlockBuffers> buffers(inFlight);
+	std::vector<FullVertex> threadMin(inFlight), threadMax(inFlight);
+	for (size_t i = 0; i < inFlight; ++i)
+		ResetMinMax(threadMin[i], threadMax[i]);
+	const size_t windowVerts = GetPlyWindowVertices(tf);
+	std::atomic<bool> readOk = true;
+	ParallelFor(int(inFlight), blockCount, [&](size_t blockIndex, int threadIndex)
+	{
+		const size_t start = blockIndex * blockVerts;
+		const size_t count = std::min(blockVerts, tf.vertexCount - start);
+		TraceZone zone("StreamMinMaxBlock");
+		StreamBlockBuffers& buf = buffers[threadIndex];
+		buf.full.resize(blockVerts);
+		for (size_t i = 0; i < count; i += windowVerts)
+		{
+			const size_t windowCount = std::min(windowVerts, count - i);
+			const uint8_t* src = GetPlyVertices(tf, start + i, windowCount, buf.plyData);
+			if (src == nullptr)
+			{
+				readOk = false;
+				return;
+			}
+			for (size_t k = 0; k < windowCount; ++k)
+				ConvertPlyVertex(tf, src + k * tf.ply.vertexStride, buf.full[i + k]);
+		}
+		NormalizeRotation(buf.full.data(), count);
+		LinearizeData(buf.full.data(), count);
+		CalcMinMax(buf.full.data(), count, threadMin[threadIndex], threadMax[threadIndex]);
+	});
+	if (!readOk)
+		return false;
+	// slots that got no blocks (e.g. fewer blocks than in flight) still have the reset values
+	ResetMinMax(valMin, valMax);
+	for (size_t i = 0; i < inFlight; ++i)
+		MergeMinMax(threadMin[i], threadMax[i], valMin, valMax);
+	const float* minPtr = (const float*)&valMin;
+	const float* maxPtr = (const float*)&valMax;
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+	{
+		if (!(minPtr[j] <= maxPtr[j]) || minPtr[j] <= -FLT_MAX || maxPtr[j] >= FLT_MAX)
+		{
+			printf("ERROR: %s value %zi has invalid bounds %g .. %g (%zi blocks, %zi in flight)\n", tf.title, j, minPtr[j], maxPtr[j], blockCount, inFlight);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool StreamCompressFile(TestFile& tf, const CompressorConfig& config, int level, size_t memoryCap, const char* outPath, size_t& outCompressedSize)
+{
+	TraceZone zone("StreamCompressFile", outPath);
+	const PackLayout& layout = tf.packLayout;
+	const size_t blockVerts = GetStreamBlockVertices(config, layout.recordSize);
+	const size_t inFlight = GetStreamBlocksInFlight(blockVerts, layout.recordSize, config.threadCount, memoryCap);
+	const ContainerHeader header = config.MakeContainerHeader(level, tf.vertexCount, layout.recordSize, blockVerts);
+	const size_t blockCount = header.blockCount;
+
+	FILE* f = fopen(outPath, "wb");
+	if (f == nullptr)
+	{
+		printf("ERROR: failed to write output file %s\n", outPath);
+		return false;
+	}
+
+	std::vector<StreamBlockBuffers> buffers(inFlight);
+	for (StreamBlockBuffers& buf : buffers)
+	{
+		buf.full.resize(blockVerts);
+		buf.packed.resize(blockVerts * layout.recordSize);
+		if (config.filter)
+			buf.filtered.resize(blockVerts * layout.recordSize);
+	}
+
+	// header & block table go first; the table is filled in after all blocks are written
+	std::vector<ContainerBlock> blocks(blockCount);
+	std::vector<uint8_t> prefix(ContainerCalcPrefixSize(header));
+	fwrite(prefix.data(), 1, prefix.size(), f);
+
+	uint64_t cmpOffset = prefix.size();
+	std::atomic<bool> readOk = true;
+	for (size_t batchStart = 0; batchStart < blockCount && readOk; batchStart += inFlight)
+	{
+		const size_t batchCount = std::min(inFlight, blockCount - batchStart);
+		ParallelFor(int(batchCount), batchCount, [&](size_t jobIndex, int)
+		{
+			StreamBlockBuffers& buf = buffers[jobIndex];
+			const size_t start = (batchStart + jobIndex) * blockVerts;
+			const size_t count = std::min(blockVerts, tf.vertexCount - start);
+			buf.compressedSize = 0;
+			if (!StreamGatherPlyVertices(tf, tf.order.data() + start, count, buf.full.data(), buf.plyData))
+			{
+				readOk = false;
+				return;
+			}
+			{
+				TraceZone packZone("StreamPackBlock");
+				NormalizeRotation(buf.full.data(), count);
+				LinearizeData(buf.full.data(), count);
+				PackData(buf.full.data(), buf.packed.data(), count, layout, tf.valMin, tf.valMax, nullptr);
+			}
+			ContainerBlock& block = blocks[batchStart + jobIndex];
+			uint8_t* cmp = config.CompressBlock(level, buf.packed.data(), count, layout.recordSize, buf.filtered.data(), buf.compressedSize, block);
+			buf.compressed.assign(cmp, cmp + buf.compressedSize);
+			delete[] cmp;
+			block.size = uint32_t(buf.compressedSize);
+			block.elemCount = uint32_t(count);
+		});
+		StreamSampleMemory(tf);
+		if (!readOk)
+			break;
+		// write out in order
+		TraceZone writeZone("StreamWriteBlocks");
+		for (size_t i = 0; i < batchCount; ++i)
+		{
+			blocks[batchStart + i].offset = cmpOffset;
+			fwrite(buffers[i].compressed.data(), 1, buffers[i].compressedSize, f);
+			cmpOffset += buffers[i].compressedSize;
+		}
+	}
+
+	if (!readOk)
+	{
+		fclose(f);
+		return false;
+	}
+	ContainerWritePrefix(prefix.data(), header, (const float*)&tf.valMin, (const float*)&tf.valMax, layout.bits, nullptr, nullptr, blocks.data());
+	fseek(f, 0, SEEK_SET);
+	bool ok = fwrite(prefix.data(), 1, prefix.size(), f) == prefix.size();
+	ok &= fclose(f) == 0;
+	if (!ok)
+	{
+		printf("ERROR: failed to write output file %s\n", outPath);
+		return false;
+	}
+	outCompressedSize = cmpOffset;
+	return true;
+}
 
-	TestFile testFiles[] = {
-#ifdef _DEBUG
-		{"synthetic", "../../../../../Assets/Models~/synthetic/point_cloud/iteration_7000/point_cloud.ply"},
-		{"bicycle_crop", "../../../../../Assets/Models~/bicycle_cropped/point_cloud/iteration_7000/point_cloud.ply"},
+static bool FileSeek(FILE* f, uint64_t offset)
+{
+#ifdef _MSC_VER
+	return _fseeki64(f, int64_t(offset), SEEK_SET) == 0;
 #else
-		{"bicycle_7k", "../../../../../Assets/Models~/bicycle/point_cloud/iteration_7000/point_cloud.ply"},
-		//{"bicycle_30k", "../../../../../Assets/Models~/bicycle/point_cloud/iteration_30000/point_cloud.ply"},
-		//{"truck_7k", "../../../../../Assets/Models~/truck/point_cloud/iteration_7000/point_cloud.ply"},
+	return fseeko(f, off_t(offset), SEEK_SET) == 0;
 #endif
-	};
-	for (auto& tf : testFiles)
+}
+
+// Size of the whole file; leaves the position at the start
+static uint64_t FileGetSize(FILE* f)
+{
+#ifdef _MSC_VER
+	_fseeki64(f, 0, SEEK_END);
+	const int64_t size = _ftelli64(f);
+#else
+	fseeko(f, 0, SEEK_END);
+	const off_t size = ftello(f);
+#endif
+	FileSeek(f, 0);
+	return size > 0 ? uint64_t(size) : 0;
+}
+
+// Reads the container written by StreamCompressFile one batch of blocks at a time, decodes
+// back into FullVertex, and compares with the original PLY data. Everything needed for
+// decoding (compressor, filter, quantization bounds & bits, block locations) comes from the file.
+static bool StreamVerifyFile(TestFile& tf, int threadCount, size_t memoryCap, const char* path, ErrorStats& err)
+{
+	TraceZone zone("StreamVerifyFile", path);
+	FILE* f = fopen(path, "rb");
+	if (f == nullptr)
 	{
-		if (!ReadPlyFile(tf.path, tf.fileData, tf.vertexCount, tf.vertexStride))
-			return 1;
-		ReorderData(tf);
+		printf("ERROR: failed to read file %s\n", path);
+		return false;
+	}
 
-		tf.origFileData = tf.fileData;
-		NormalizeRotation(tf);
-		LinearizeData(tf);
-		CalcMinMax(tf);
-		PackData(tf);
+	// header first, then the rest of the prefix based on counts in it
+	const uint64_t fileSize = FileGetSize(f);
+	std::vector<uint8_t> prefix(sizeof(ContainerHeader));
+	bool ok = fread(prefix.data(), 1, prefix.size(), f) == prefix.size();
+	ContainerHeader header;
+	std::vector<float> boundsMin, boundsMax;
+	std::vector<uint8_t> attributeBits;
+	ShCodebook shCodebook;
+	std::vector<uint8_t> dictionary;
+	std::vector<ContainerBlock> blocks;
+	if (ok)
+	{
+		memcpy(&header, prefix.data(), sizeof(header));
+		// counts of a malformed header must not drive a huge allocation
+		ok = ContainerCalcPrefixSize(header) <= fileSize;
+	}
+	if (ok)
+	{
+		prefix.resize(ContainerCalcPrefixSize(header));
+		ok = fread(prefix.data() + sizeof(header), 1, prefix.size() - sizeof(header), f) == prefix.size() - sizeof(header);
+	}
+	if (!ok || !ContainerParsePrefix(prefix.data(), prefix.size(), size_t(fileSize), header, boundsMin, boundsMax, attributeBits, shCodebook.entries, dictionary, blocks))
+	{
+		printf("ERROR: failed to read container header from %s\n", path);
+		fclose(f);
+		return false;
+	}
+	std::unique_ptr<Compressor> cmp(CreateCompressor(CompressorKind(header.codecKind), CompressionFormat(header.codecFormat)));
+	FilterDesc* filter = FindFilter(ContainerFilter(header.filter));
+	PackLayout layout;
+	const bool layoutOk = BuildPackLayout(attributeBits.data(), attributeBits.size(), "file", layout) &&
+		header.codebookDim % 3 == 0 && (header.codebookCount != 0 || layout.bits[kPackShIndex] == 0);
+	shCodebook.coeffCount = header.codebookDim / 3;
+	if (cmp == nullptr || !cmp->SetDictionary(dictionary.data(), dictionary.size()) || (filter == nullptr && header.filter != kContainerFilterNone) || !layoutOk || header.elemStride != layout.recordSize ||
+		header.elemCount != tf.vertexCount || header.boundsCount != kFullVertexFloats || header.boundsChunkElems != 0)
+	{
+		printf("ERROR: %s has unsupported or mismatching data (codec %i/%i filter %i, %llu items of %u bytes)\n", path,
+			header.codecKind, header.codecFormat, header.filter, (unsigned long long)header.elemCount, header.elemStride);
+		fclose(f);
+		return false;
 	}
-	TestCompressors(std::size(testFiles), testFiles);
-	for (auto& tf : testFiles)
+	const CompressorConfig config = { cmp.get(), filter, kBSizeNone, threadCount, {}, {} };
+	FullVertex valMin, valMax;
+	memcpy(&valMin, boundsMin.data(), sizeof(valMin));
+	memcpy(&valMax, boundsMax.data(), sizeof(valMax));
+
+	const size_t blockVerts = header.blockElemCount;
+	const size_t inFlight = GetStreamBlocksInFlight(blockVerts, layout.recordSize, threadCount, memoryCap);
+	const size_t blockCount = header.blockCount;
+	std::vector<StreamBlockBuffers> buffers(inFlight);
+	for (StreamBlockBuffers& buf : buffers)
+		buf.scratch.Reserve(config.CalcDecodeScratchSize(header));
+	std::vector<ErrorStats> threadErr(inFlight);
+	std::atomic<bool> readOk = true, decodeOk = true;
+	for (size_t batchStart = 0; batchStart < blockCount && ok && readOk && decodeOk; batchStart += inFlight)
 	{
-		UnpackData(tf);
-		UnlinearizeData(tf);
-		CalcErrorFromOrig(tf);
+		const size_t batchCount = std::min(inFlight, blockCount - batchStart);
+		{
+			TraceZone readZone("StreamReadBlocks");
+			for (size_t i = 0; i < batchCount; ++i)
+			{
+				const ContainerBlock& block = blocks[batchStart + i];
+				buffers[i].compressed.resize(block.size);
+				buffers[i].compressedSize = block.size;
+				ok &= FileSeek(f, block.offset);
+				ok &= fread(buffers[i].compressed.data(), 1, block.size, f) == block.size;
+				ok &= block.elemCount <= blockVerts;
+			}
+		}
+		if (!ok)
+			break;
+		ParallelFor(int(batchCount), batchCount, [&](size_t jobIndex, int)
+		{
+			StreamBlockBuffers& buf = buffers[jobIndex];
+			const ContainerBlock& block = blocks[batchStart + jobIndex];
+			const size_t start = (batchStart + jobIndex) * blockVerts;
+			const size_t count = block.elemCount;
+			buf.packed.resize(blockVerts * layout.recordSize);
+			buf.full.resize(blockVerts * 2);
+			buf.scratch.Reset();
+			if (!config.DecompressBlock(buf.compressed.data(), buf.compressedSize, block, count, layout.recordSize, buf.scratch, buf.packed.data()))
+			{
+				decodeOk = false;
+				return;
+			}
+			FullVertex* decoded = buf.full.data();
+			FullVertex* orig = buf.full.data() + blockVerts;
+			{
+				TraceZone unpackZone("StreamUnpackBlock");
+				UnpackData(buf.packed.data(), decoded, count, layout, valMin, valMax, shCodebook);
+				UnlinearizeData(decoded, count);
+			}
+			if (!StreamGatherPlyVertices(tf, tf.order.data() + start, count, orig, buf.plyData))
+			{
+				readOk = false;
+				return;
+			}
+			TraceZone errorZone("AccumulateError");
+			AccumulateError(orig, decoded, count, threadErr[jobIndex]);
+		});
+		StreamSampleMemory(tf);
 	}
+	fclose(f);
+	if (!ok)
+	{
+		printf("ERROR: failed to read file %s\n", path);
+		return false;
+	}
+	if (!decodeOk)
+	{
+		printf("ERROR: blocks of %s did not decompress to their size in the block table\n", path);
+		return false;
+	}
+	if (!readOk)
+		return false;
+	for (const ErrorStats& e : threadErr)
+	{
+		for (size_t j = 0; j < kFullVertexFloats; ++j)
+			((float*)&err.errMax)[j] = std::max(((float*)&err.errMax)[j], ((const float*)&e.errMax)[j]);
+		for (size_t j = 0; j < kFullVertexFloats; ++j)
+			((float*)&err.errSum)[j] += ((const float*)&e.errSum)[j];
+		err.errRotSum += e.errRotSum;
+		err.errRotMax = std::max(err.errRotMax, e.errRotMax);
+		err.count += e.count;
+	}
+	return true;
+}
+
+static bool StreamTestFile(TestFile& tf, const CompressorConfig& config, const OrderDesc& orderDesc, const QuantProfile& profile, int level, size_t memoryCap)
+{
+	char outPath[1000];
+	snprintf(outPath, sizeof(outPath), "%s.gspress", tf.title);
+	const std::string name = config.GetName();
+	TraceZone zone("StreamTestFile", name.c_str());
+
+	uint64_t t0 = stm_now();
+	tf.streaming = true;
+	tf.streamPeakMemory = 0;
+	if (!OpenPlyFile(tf))
+		return false;
+	tf.packLayout = BuildPackLayout(profile, tf.plyLayout.shDegree);
+	if (tf.packLayout.bits[kPackShIndex] != 0)
+	{
+		printf("ERROR: %s uses SH codebook, which needs all splats for training; not supported when streaming\n", profile.name);
+		PlyClose(tf.ply);
+		return false;
+	}
+	if (config.cmp->UsesDictionary())
+	{
+		printf("ERROR: %s needs samples of all data for dictionary training; not supported when streaming\n", name.c_str());
+		PlyClose(tf.ply);
+		return false;
+	}
+	const size_t blockVerts = GetStreamBlockVertices(config, tf.packLayout.recordSize);
+	const size_t inFlight = GetStreamBlocksInFlight(blockVerts, tf.packLayout.recordSize, config.threadCount, memoryCap);
+	printf("Streaming %s with %s %s, memory cap %.1fMB, %zi blocks in flight:\n", tf.title, name.c_str(), profile.name, memoryCap / 1024.0 / 1024.0, inFlight);
+	if (!CalcSpatialOrder(tf, orderDesc, tf.order) || !StreamCalcMinMax(tf, blockVerts, inFlight, tf.valMin, tf.valMax))
+	{
+		PlyClose(tf.ply);
+		return false;
+	}
+	size_t compressedSize = 0;
+	if (!StreamCompressFile(tf, config, level, memoryCap, outPath, compressedSize))
+	{
+		PlyClose(tf.ply);
+		return false;
+	}
+	double tComp = stm_sec(stm_since(t0));
+
+	// the spatial order (4 bytes per splat, more while sorting it) is the only memory that grows with
+	// the splat count; the rest of streaming memory use is bounded by the memory cap
+	const double oneMB = 1024.0 * 1024.0;
+	const double rawSize = double(tf.vertexCount * tf.ply.vertexStride);
+	const double orderSize = double(tf.order.size() * sizeof(tf.order[0]));
+	printf("  %s: %.1fMB -> %.1fMB, ratio %.3f, %.3fs (%.3f GB/s of PLY data)\n", outPath,
+		rawSize / oneMB, compressedSize / oneMB, rawSize / compressedSize, tComp, rawSize / tComp / (oneMB * 1024.0));
+	printf("  memory: peak %.1fMB, while streaming blocks %.1fMB (%.1fMB of it splat order)\n", SysInfoGetPeakMemory() / oneMB, tf.streamPeakMemory / oneMB, orderSize / oneMB);
+
+	ErrorStats err;
+	t0 = stm_now();
+	if (!StreamVerifyFile(tf, config.threadCount, memoryCap, outPath, err))
+	{
+		PlyClose(tf.ply);
+		return false;
+	}
+	double tDecomp = stm_sec(stm_since(t0));
+	printf("  decoded back in %.3fs, memory: peak %.1fMB, while streaming blocks %.1fMB\n", tDecomp, SysInfoGetPeakMemory() / oneMB, tf.streamPeakMemory / oneMB);
+	PrintError(tf.title, err, tf.errMax, tf.errAvg);
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+	{
+		if (!std::isfinite(((const float*)&tf.errAvg)[j]))
+		{
+			printf("ERROR: %s decoded back with non-finite error in value %zi\n", outPath, j);
+			PlyClose(tf.ply);
+			return false;
+		}
+	}
+
+	tf.order.clear();
+	tf.order.shrink_to_fit();
+	PlyClose(tf.ply);
+	return true;
+}
+
+// Times a pair of kernels (forward & inverse, e.g. pack & unpack) of each variant, and prints a row of
+// their speeds as GB/s of dataSize bytes, in columns as wide as kernelNames. For each run,
+// prepare(kernel) sets up the input (untimed), then run(variant, kernel) runs it; after the runs of a
+// variant, check(variant, variantIndex) tells whether its results are right.
+template<typename Variant, typename PrepareFunc, typename RunFunc, typename CheckFunc>
+static bool BenchKernelPairs(const std::vector<Variant>& variants, int reps, double dataSize, const char* rowPrefix, const char* const kernelNames[2],
+	PrepareFunc prepare, RunFunc run, CheckFunc check)
+{
+	const double oneGB = 1024.0 * 1024.0 * 1024.0;
+	for (size_t vi = 0; vi < variants.size(); ++vi)
+	{
+		const Variant& v = variants[vi];
+		std::vector<double> times[2];
+		for (int ir = 0; ir < reps; ++ir)
+		{
+			for (int kernel = 0; kernel < 2; ++kernel)
+			{
+				prepare(kernel);
+				uint64_t t0 = stm_now();
+				run(v, kernel);
+				times[kernel].push_back(stm_sec(stm_since(t0)));
+			}
+		}
+		if (!check(v, vi))
+			return false;
+		printf("%s%-7s", rowPrefix, v.name);
+		for (int kernel = 0; kernel < 2; ++kernel)
+			printf(" %*.3f", std::max(int(strlen(kernelNames[kernel])), 7), dataSize / BenchCalcStats(times[kernel]).median / oneGB);
+		printf("\n");
+	}
+	return true;
+}
+
+// Micro-benchmark of unorm quantization kernels, each SIMD variant the CPU supports against the
+// scalar one, on synthetic SoA data (including out of range values and NaNs); the variants have to
+// give exactly the same results. Speeds are GB/s of float data.
+static bool BenchQuantKernels()
+{
+	const size_t kCount = 1024 * 1024;
+	const int kReps = std::max(g_Options.runs, 5);
+	const float vmin = -2.0f, vmax = 3.0f;
+	std::vector<float> src(kCount);
+	uint64_t rng = 1;
+	for (size_t i = 0; i < kCount; ++i)
+		src[i] = vmin - 0.5f + RandomToFloat(RandomNext(rng)) * (vmax - vmin + 1.0f);
+	src[1] = vmin;
+	src[2] = vmax;
+	src[3] = NAN;
+	src[4] = -INFINITY;
+	src[5] = INFINITY;
+
+	typedef void (*PackFunc)(const float* src, uint16_t* dst, size_t count, float vmin, float invRange, int bits);
+	typedef void (*UnpackFunc)(const uint16_t* src, float* dst, size_t count, float vmin, float vmax, int bits);
+	struct Variant
+	{
+		const char* name;
+		PackFunc pack;
+		UnpackFunc unpack;
+	};
+	std::vector<Variant> variants = {
+		{ "scalar", Quant_PackUnormScalar, Quant_UnpackUnormScalar },
+		{ "simd16", Quant_PackUnorm16, Quant_UnpackUnorm16 },
+	};
+	if (SysInfoGetSimdWidth() >= 32)
+		variants.push_back({ "simd32", Quant_PackUnorm32, Quant_UnpackUnorm32 });
+
+	const double dataSize = double(kCount * sizeof(float));
+	const char* const kernelNames[2] = { "Pack", "Unpack" };
+	std::vector<uint16_t> refQuantized(kCount), quantized(kCount);
+	std::vector<float> refValues(kCount), values(kCount);
+	printf("Quantization kernels on %zi values, GB/s of floats (median of %i):\n", kCount, kReps);
+	printf("  Bits Variant    Pack  Unpack\n");
+	for (int bits : { 8, 11, 16 })
+	{
+		const float invRange = QuantCalcInvRange(vmin, vmax);
+		Quant_PackUnormScalar(src.data(), refQuantized.data(), kCount, vmin, invRange, bits);
+		Quant_UnpackUnormScalar(refQuantized.data(), refValues.data(), kCount, vmin, vmax, bits);
+		char rowPrefix[16];
+		snprintf(rowPrefix, sizeof(rowPrefix), "  %4i ", bits);
+		const bool ok = BenchKernelPairs(variants, kReps, dataSize, rowPrefix, kernelNames,
+			[](int) {},
+			[&](const Variant& v, int kernel)
+			{
+				if (kernel == 0)
+					v.pack(src.data(), quantized.data(), kCount, vmin, invRange, bits);
+				else
+					v.unpack(refQuantized.data(), values.data(), kCount, vmin, vmax, bits);
+			},
+			[&](const Variant& v, size_t)
+			{
+				if (quantized == refQuantized && memcmp(values.data(), refValues.data(), kCount * sizeof(float)) == 0)
+					return true;
+				printf("ERROR: %s quantization kernels at %i bits do not match the scalar ones\n", v.name, bits);
+				return false;
+			});
+		if (!ok)
+			return false;
+	}
+	return true;
+}
+
+// Micro-benchmark of the SIMD exp/log kernels: checks their documented error bounds on random
+// samples (against double precision), and times (un)linearization of opacity & scale with each
+// SIMD variant the CPU supports against the scalar libm code; the SIMD variants have to give
+// exactly the same results. Speeds are GB/s of float data.
+static bool BenchMathKernels()
+{
+	const size_t kCount = 1024 * 1024;
+	const int kReps = std::max(g_Options.runs, 5);
+	std::vector<float> expSrc(kCount), logSrc(kCount), expRes(kCount), logRes(kCount), res(kCount);
+	uint64_t rng = 1;
+	for (size_t i = 0; i < kCount; ++i)
+	{
+		const uint64_t z = RandomNext(rng);
+		expSrc[i] = -87.0f + RandomToFloat(z) * 175.0f;
+		// any positive finite float, including denormals
+		const uint32_t bits = uint32_t(z) % 0x7F7FFFFF + 1;
+		memcpy(&logSrc[i], &bits, sizeof(float));
+	}
+
+	double expErr = 0, logRelErr = 0, logAbsErr = 0;
+	FastMath_Exp16(expSrc.data(), expRes.data(), kCount);
+	for (size_t i = 0; i < kCount; ++i)
+	{
+		const double ref = exp(double(expSrc[i]));
+		expErr = std::max(expErr, fabs(expRes[i] - ref) / ref);
+	}
+	FastMath_Log16(logSrc.data(), logRes.data(), kCount);
+	for (size_t i = 0; i < kCount; ++i)
+	{
+		const double ref = log(double(logSrc[i]));
+		if (fabs(ref) >= 1.0)
+			logRelErr = std::max(logRelErr, fabs(logRes[i] - ref) / fabs(ref));
+		else
+			logAbsErr = std::max(logAbsErr, fabs(logRes[i] - ref));
+	}
+	printf("SIMD exp/log on %zi random values, max error (bound):\n", kCount);
+	printf("  exp rel %.2e (%.2e)\n", expErr, kFastExpMaxRelError);
+	printf("  log rel %.2e (%.2e) abs %.2e (%.2e)\n", logRelErr, kFastLogMaxRelError, logAbsErr, kFastLogMaxAbsError);
+	if (expErr > kFastExpMaxRelError || logRelErr > kFastLogMaxRelError || logAbsErr > kFastLogMaxAbsError)
+	{
+		printf("ERROR: SIMD exp/log are outside of their error bounds\n");
+		return false;
+	}
+	const bool hasSimd32 = SysInfoGetSimdWidth() >= 32;
+	if (hasSimd32)
+	{
+		FastMath_Exp32(expSrc.data(), res.data(), kCount);
+		bool same = memcmp(res.data(), expRes.data(), kCount * sizeof(float)) == 0;
+		FastMath_Log32(logSrc.data(), res.data(), kCount);
+		same = same && memcmp(res.data(), logRes.data(), kCount * sizeof(float)) == 0;
+		if (!same)
+		{
+			printf("ERROR: simd32 exp/log do not match the simd16 ones\n");
+			return false;
+		}
+	}
+
+	// opacity & scale of kCount / 4 splats: logit opacity, log scale
+	typedef void (*SplatFunc)(float* data, size_t count, size_t stride);
+	struct Variant
+	{
+		const char* name;
+		SplatFunc linearize;
+		SplatFunc unlinearize;
+	};
+	auto libmLinearize = [](float* data, size_t count, size_t /*stride*/)
+	{
+		for (size_t i = 0; i < count; ++i, data += 4)
+		{
+			data[0] = Sigmoid(data[0]);
+			for (int j = 1; j < 4; ++j)
+				data[j] = sqrtf(sqrtf(expf(data[j])));
+		}
+	};
+	auto libmUnlinearize = [](float* data, size_t count, size_t /*stride*/)
+	{
+		for (size_t i = 0; i < count; ++i, data += 4)
+		{
+			data[0] = InvSigmoid(data[0]);
+			for (int j = 1; j < 4; ++j)
+				data[j] = logf(data[j] * data[j] * data[j] * data[j]);
+		}
+	};
+	std::vector<Variant> variants = {
+		{ "libm", libmLinearize, libmUnlinearize },
+		{ "simd16", FastMath_LinearizeOpacityScale16, FastMath_UnlinearizeOpacityScale16 },
+	};
+	if (hasSimd32)
+		variants.push_back({ "simd32", FastMath_LinearizeOpacityScale32, FastMath_UnlinearizeOpacityScale32 });
+
+	// 3 splats more than a multiple of 8, so that the one splat remainder loops run too
+	const size_t splatCount = kCount / 4 - 5;
+	const size_t valueCount = splatCount * 4;
+	std::vector<float> plyValues(valueCount), linear(valueCount), refLinear(valueCount), refPly(valueCount);
+	for (size_t i = 0; i < valueCount; ++i)
+		plyValues[i] = (i & 3) ? expSrc[i] * 0.1f - 4.0f : expSrc[i] * 0.1f;
+	const double dataSize = double(valueCount * sizeof(float));
+	const char* const kernelNames[2] = { "Linearize", "Unlinearize" };
+	printf("Opacity & scale (un)linearization of %zi splats, GB/s of floats (median of %i):\n", splatCount, kReps);
+	printf("  Variant Linearize Unlinearize\n");
+	return BenchKernelPairs(variants, kReps, dataSize, "  ", kernelNames,
+		[&](int kernel)
+		{
+			if (kernel == 0)
+				linear = plyValues;
+			else
+				res = linear;
+		},
+		[&](const Variant& v, int kernel)
+		{
+			if (kernel == 0)
+				v.linearize(linear.data(), splatCount, 4 * sizeof(float));
+			else
+				v.unlinearize(res.data(), splatCount, 4 * sizeof(float));
+		},
+		[&](const Variant& v, size_t vi)
+		{
+			// libm is only timed; the simd16 results are the reference for the others
+			if (vi == 1)
+			{
+				refLinear = linear;
+				refPly = res;
+			}
+			else if (vi > 1 && (memcmp(linear.data(), refLinear.data(), valueCount * sizeof(float)) != 0 || memcmp(res.data(), refPly.data(), valueCount * sizeof(float)) != 0))
+			{
+				printf("ERROR: %s (un)linearization does not match the simd16 one\n", v.name);
+				return false;
+			}
+			return true;
+		});
+}
+
+// Measures the same threaded work twice, like two identical result rows; the counts have to be
+// about the same, or counts of earlier (exited) threads leak into later measurements.
+static bool CheckPerfCounters()
+{
+	const size_t kJobSize = 256 * 1024;
+	std::vector<uint32_t> data(kJobSize * 8, 1);
+	std::atomic<uint32_t> sum = 0;
+	SysInfoPerfCounters counts[2];
+	for (SysInfoPerfCounters& c : counts)
+	{
+		SysInfoPerfCountersStart();
+		ParallelFor(4, 8, [&](size_t jobIndex, int)
+		{
+			uint32_t s = 0;
+			for (size_t i = 0; i < kJobSize; ++i)
+				s = s * 31 + data[jobIndex * kJobSize + i];
+			sum += s;
+		});
+		SysInfoPerfCountersStop(c);
+	}
+	const double ratio = counts[0].instructions ? double(counts[1].instructions) / counts[0].instructions : 0.0;
+	if (ratio < 0.9 || ratio > 1.1)
+	{
+		printf("WARN: perf counters of two identical runs differ (%llu vs %llu instructions); not using them\n",
+			(unsigned long long)counts[0].instructions, (unsigned long long)counts[1].instructions);
+		return false;
+	}
+	return true;
+}
+
+static void PrintUsage()
+{
+	printf("Usage: GaussianPress [options] [title=]file.ply ...\n");
+	printf("Benchmarks spatial ordering, quantization and compression of Gaussian splat PLY files.\n");
+	printf("Options (lists are comma separated):\n");
+	printf("  --orders=LIST      spatial orders: none, morton, hilbert, tiled-morton (default: morton,hilbert,tiled-morton; streaming: morton)\n");
+	printf("  --profiles=LIST    quantization profiles: q16, q-med, q-low, q-vq, q-mo (default: all; streaming: q16)\n");
+	printf("  --profile=SPEC     custom quantization profile, can be repeated: bits of each attribute (pos, dc, sh, opa, scale, rot)\n");
+	printf("                     for all its components, or each one separated by '/', e.g. pos=16,dc=11/10/11,sh=8/6/4,rot=s10;\n");
+	printf("                     rot=sN smallest-three, rot=qN meshopt quaternion, scale=eN/sh=eN meshopt exponential filter,\n");
+	printf("                     sh=vqN codebook of N entries; attributes not listed use 16 bits (default: none)\n");
+	printf("  --quant-chunk=N    quantization bounds for each N splats instead of global ones (default: 0)\n");
+	printf("  --codecs=LIST      zstd, zstd-ctx (reused contexts), zstd-dict (trained dictionary; blocked configs only),\n");
+	printf("                     zstd-mt (zstd worker threads, for each --threads count; whole data only), lz4,\n");
+	printf("                     rans (interleaved rANS entropy coder), meshopt (default: lz4)\n");
+	printf("  --filters=LIST     none, bd (byte delta), bd16, bd32, bd64, wd (16-bit word delta), xor (XOR delta), bshuf (bitshuffle),\n");
+	printf("                     pred (zig-zag residual from previous splat), auto (smallest of none..pred for each block) (default: bd,none)\n");
+	printf("  --levels=LIST      compression levels (default: each codec's own set)\n");
+	printf("  --split            also test stream-split mode: packed data split into attribute streams, each compressed\n");
+	printf("                     with whichever of the other codec/filter/level configs suits it best (in-memory mode only)\n");
+	printf("  --tune=GBS         auto-tune instead of the benchmark table: measure each configuration on a sample of each file,\n");
+	printf("                     print the size vs decode speed Pareto frontier, and pick the smallest configuration that decodes\n");
+	printf("                     at least GBS GB/s on its thread count (0: smallest overall)\n");
+	printf("  --tune-sample=SIZE auto-tune sample size, taken as 8 runs spread over the data (default: 32M)\n");
+	printf("  --blocks=LIST      block sizes: none, 64k, 256k, 1M, 4M, 16M, 64M (default: none,1M)\n");
+	printf("  --threads=LIST     thread counts of blocked configs; 'max' is all hardware threads, 'scale' is 1,2,4,..max (default: scale)\n");
+	printf("  --runs=N           run each configuration N times; times are median of runs (default: 1)\n");
+	printf("  --json=PATH        write results (with median, min, stddev of times) as JSON\n");
+	printf("  --csv=PATH         write results as CSV\n");
+	printf("  --stream           streaming mode: convert each file into <title>.gspress with each configuration, and verify it\n");
+	printf("  --memory-cap=SIZE  streaming mode memory cap, e.g. 512M (default: 256M)\n");
+	printf("  --verify-order     check that each spatial order visits every splat exactly once\n");
+	printf("  --fused            also time fused decode (decompress, unfilter, unpack, unlinearize a tile at a time) into splats\n");
+	printf("  --kernels          only run the micro-benchmarks of quantization and exp/log kernels (scalar vs. SIMD), no files needed\n");
+	printf("  --perf-counters    record CPU cycles, instructions, cache and branch misses of each compress/decompress (Linux only)\n");
+	printf("  --trace=PATH       write a Chrome trace (ui.perfetto.dev, chrome://tracing) of all stages, blocks and worker threads\n");
+}
+
+static std::vector<std::string> SplitList(const char* str)
+{
+	std::vector<std::string> res;
+	while (true)
+	{
+		const char* end = strchr(str, ',');
+		res.emplace_back(str, end ? end - str : strlen(str));
+		if (end == nullptr)
+			break;
+		str = end + 1;
+	}
+	return res;
+}
+
+static bool ParseInt(const std::string& str, int& out)
+{
+	char* end = nullptr;
+	long v = strtol(str.c_str(), &end, 10);
+	if (str.empty() || *end != 0)
+		return false;
+	out = int(v);
+	return true;
+}
+
+// Bits of all components of an attribute ("10"), or of each one ("11/10/11")
+static bool ParseBitList(const std::string& str, int* bits, int count)
+{
+	std::vector<std::string> parts;
+	for (size_t start = 0; start <= str.size();)
+	{
+		size_t end = std::min(str.find('/', start), str.size());
+		parts.push_back(str.substr(start, end - start));
+		start = end + 1;
+	}
+	if (parts.size() != 1 && parts.size() != size_t(count))
+		return false;
+	for (int i = 0; i < count; ++i)
+	{
+		if (!ParseInt(parts[parts.size() == 1 ? 0 : i], bits[i]))
+			return false;
+	}
+	return true;
+}
+
+// Profile from a --profile spec; attributes it does not list keep their bits (of q16)
+static bool ParseQuantProfile(const char* spec, QuantProfile& profile)
+{
+	for (const std::string& item : SplitList(spec))
+	{
+		const size_t sep = item.find('=');
+		const std::string key = item.substr(0, sep);
+		const std::string val = sep == std::string::npos ? std::string() : item.substr(sep + 1);
+		const char mode = val.empty() ? 0 : val[0];
+		bool ok = true;
+		if (key == "pos")
+			ok = ParseBitList(val, profile.pos, 3);
+		else if (key == "dc")
+			ok = ParseBitList(val, profile.dc, 3);
+		else if (key == "opa")
+			ok = ParseInt(val, profile.opacity);
+		else if (key == "sh" && mode == 'e')
+			ok = ParseInt(val.substr(1), profile.shMeshOptExp) && profile.shMeshOptExp > 0;
+		else if (key == "sh" && val.compare(0, 2, "vq") == 0)
+			ok = ParseInt(val.substr(2), profile.shCodebookSize) && profile.shCodebookSize > 0;
+		else if (key == "sh")
+			ok = ParseBitList(val, profile.sh, 3);
+		else if (key == "scale" && mode == 'e')
+			ok = ParseInt(val.substr(1), profile.scaleMeshOptExp) && profile.scaleMeshOptExp > 0;
+		else if (key == "scale")
+			ok = ParseBitList(val, profile.scale, 3);
+		else if (key == "rot" && mode == 's')
+			ok = ParseInt(val.substr(1), profile.rotSmallest3) && profile.rotSmallest3 > 0;
+		else if (key == "rot" && mode == 'q')
+			ok = ParseInt(val.substr(1), profile.rotMeshOptQuat) && profile.rotMeshOptQuat > 0;
+		else if (key == "rot")
+			ok = ParseBitList(val, profile.rot, 4);
+		else
+		{
+			printf("ERROR: unknown attribute '%s' in quantization profile '%s'\n", key.c_str(), spec);
+			return false;
+		}
+		if (!ok)
+		{
+			printf("ERROR: invalid value '%s' in quantization profile '%s'\n", item.c_str(), spec);
+			return false;
+		}
+	}
+	// the file decides the SH degree; all bands have to be valid
+	PackLayout layout;
+	if (!BuildPackLayout(profile, 3, layout))
+	{
+		printf("ERROR: quantization profile '%s' has invalid bit counts (0-16 each, rot=q 4-16 and not with rot=s, sh=vq up to 65536)\n", spec);
+		return false;
+	}
+	return true;
+}
+
+static bool ParseDouble(const std::string& str, double& out)
+{
+	char* end = nullptr;
+	out = strtod(str.c_str(), &end);
+	return !str.empty() && *end == 0;
+}
+
+// Size with optional k/M/G suffix
+static bool ParseSize(const std::string& str, size_t& out)
+{
+	char* end = nullptr;
+	unsigned long long v = strtoull(str.c_str(), &end, 10);
+	if (str.empty() || end == str.c_str())
+		return false;
+	switch (*end)
+	{
+	case 0: break;
+	case 'k': case 'K': v <<= 10; ++end; break;
+	case 'm': case 'M': v <<= 20; ++end; break;
+	case 'g': case 'G': v <<= 30; ++end; break;
+	default: return false;
+	}
+	if (*end != 0)
+		return false;
+	out = size_t(v);
+	return true;
+}
+
+// Compressor configs for all combinations of codecs, filters, block sizes and
+// thread counts (non-blocked configs are single threaded)
+static bool BuildCompressorMatrix(const std::vector<std::string>& codecs, const std::vector<std::string>& filters, const std::vector<std::string>& blocks, const std::vector<std::string>& threads, const std::vector<int>& levels)
+{
+	Compressor* allCodecs[] = { g_CompZstd.get(), g_CompZstdCtx.get(), g_CompZstdDict.get(), g_CompLZ4.get(), g_CompRans.get(), g_CompMeshOpt.get() };
+	FilterDesc* allFilters[] = { &g_FilterByteDelta, &g_FilterByteDelta16, &g_FilterByteDelta32, &g_FilterByteDelta64,
+		&g_FilterWordDelta, &g_FilterXorDelta, &g_FilterBitShuffle, &g_FilterPredict, &g_FilterAuto };
+	const int filterWidths[] = { 16, 16, 32, 64, 16, 16, 16, 16, 16 };
+	static_assert(std::size(allFilters) == std::size(filterWidths));
+
+	std::vector<int> threadCounts;
+	const int maxThreads = ParallelGetHardwareThreads();
+	for (const std::string& name : threads)
+	{
+		int count = 0;
+		if (name == "scale")
+		{
+			for (count = 1; count < maxThreads; count *= 2)
+				threadCounts.push_back(count);
+			threadCounts.push_back(maxThreads);
+		}
+		else if (name == "max")
+			threadCounts.push_back(maxThreads);
+		else if (ParseInt(name, count) && count > 0)
+			threadCounts.push_back(count);
+		else
+		{
+			printf("ERROR: unknown thread count '%s'\n", name.c_str());
+			return false;
+		}
+	}
+	std::sort(threadCounts.begin(), threadCounts.end());
+	threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+	for (const std::string& codecName : codecs)
+	{
+		// zstd-mt gets a compressor for each thread count below
+		const bool zstdWorkers = codecName == "zstd-mt";
+		Compressor* cmp = nullptr;
+		for (Compressor* c : allCodecs)
+		{
+			char buf[100];
+			c->PrintName(sizeof(buf), buf);
+			if (codecName == buf)
+				cmp = c;
+		}
+		if (cmp == nullptr && !zstdWorkers)
+		{
+			printf("ERROR: unknown codec '%s'\n", codecName.c_str());
+			return false;
+		}
+		for (const std::string& filterName : filters)
+		{
+			FilterDesc* filter = nullptr;
+			if (filterName != "none")
+			{
+				size_t fi = 0;
+				while (fi < std::size(allFilters) && filterName != allFilters[fi]->name + 1)
+					++fi;
+				if (fi == std::size(allFilters))
+				{
+					printf("ERROR: unknown filter '%s'\n", filterName.c_str());
+					return false;
+				}
+				if (filterWidths[fi] > SysInfoGetSimdWidth())
+				{
+					printf("- %s filter skipped, CPU does not support %i wide SIMD\n", filterName.c_str(), filterWidths[fi]);
+					continue;
+				}
+				filter = allFilters[fi];
+			}
+			for (const std::string& blockName : blocks)
+			{
+				int blockSize = 0;
+				while (blockSize < kBSizeCount && blockName != (blockSize == kBSizeNone ? "none" : kBlockSizeName[blockSize] + 1))
+					++blockSize;
+				if (blockSize == kBSizeCount)
+				{
+					printf("ERROR: unknown block size '%s'\n", blockName.c_str());
+					return false;
+				}
+				if ((blockSize == kBSizeNone && cmp && cmp->UsesDictionary()) || (blockSize != kBSizeNone && zstdWorkers))
+				{
+					printf("- %s%s skipped, %s\n", codecName.c_str(), kBlockSizeName[blockSize], zstdWorkers ? "zstd worker threads are for whole data" : "dictionary only helps small blocks");
+					continue;
+				}
+				if (zstdWorkers)
+				{
+					for (int count : threadCounts)
+					{
+						g_CompZstdWorkers.emplace_back(std::make_unique<ZstdCompressor>(kZstdWorkers, count));
+						g_Compressors.push_back({ g_CompZstdWorkers.back().get(), filter, kBSizeNone, count, levels, {} });
+					}
+					continue;
+				}
+				if (blockSize == kBSizeNone)
+				{
+					g_Compressors.push_back({ cmp, filter, kBSizeNone, 1, levels, {} });
+					continue;
+				}
+				for (int count : threadCounts)
+					g_Compressors.push_back({ cmp, filter, BlockSize(blockSize), count, levels, {} });
+			}
+		}
+	}
+
+	// stream-split configs pick from the above, except the ones that need all of the data up front
+	if (g_Options.streamSplit)
+	{
+		std::vector<CompressorConfig> candidates;
+		for (const CompressorConfig& config : g_Compressors)
+		{
+			const bool zstdWorkers = std::any_of(g_CompZstdWorkers.begin(), g_CompZstdWorkers.end(), [&](const auto& c) { return c.get() == config.cmp; });
+			const bool duplicate = std::any_of(candidates.begin(), candidates.end(), [&](const CompressorConfig& c)
+			{
+				return c.cmp == config.cmp && (c.filter ? c.filter->id : kContainerFilterNone) == (config.filter ? config.filter->id : kContainerFilterNone);
+			});
+			if (!zstdWorkers && !duplicate && !config.cmp->UsesDictionary())
+				candidates.push_back({ config.cmp, config.filter, kBSizeNone, 1, levels, {} });
+		}
+		if (candidates.empty())
+		{
+			printf("ERROR: stream-split mode has no codecs to pick from\n");
+			return false;
+		}
+		for (const std::string& blockName : blocks)
+		{
+			int blockSize = 0;
+			while (blockName != (blockSize == kBSizeNone ? "none" : kBlockSizeName[blockSize] + 1))
+				++blockSize;
+			for (int count : threadCounts)
+				g_Compressors.push_back({ nullptr, nullptr, BlockSize(blockSize), count, {}, candidates });
+		}
+	}
+	return true;
+}
+
+int main(int argc, const char** argv)
+{
+	stm_setup();
+
+	// parse command line
+	std::vector<std::string> codecs = { "lz4" }, filters = { "bd", "none" }, blocks = { "none", "1M" }, threads = { "scale" };
+	std::vector<std::string> orderNames, profileNames;
+	std::vector<int> levels;
+	std::vector<const char*> fileArgs;
+	std::deque<QuantProfile> customProfiles; // stable addresses for g_Options.profiles
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = strchr(arg, '=');
+		const std::string name = value && arg[0] == '-' ? std::string(arg, value - arg) : std::string(arg);
+		value = value ? value + 1 : "";
+		bool ok = true;
+		if (name == "--help" || name == "-h")
+		{
+			PrintUsage();
+			return 0;
+		}
+		else if (name == "--orders")
+			orderNames = SplitList(value);
+		else if (name == "--profiles")
+			profileNames = SplitList(value);
+		else if (name == "--profile")
+		{
+			QuantProfile& profile = customProfiles.emplace_back(g_Quant16);
+			profile.name = value;
+			if (!ParseQuantProfile(value, profile))
+				return 1;
+		}
+		else if (name == "--quant-chunk")
+			ok = ParseSize(value, g_Options.quantChunkSize);
+		else if (name == "--codecs")
+			codecs = SplitList(value);
+		else if (name == "--filters")
+			filters = SplitList(value);
+		else if (name == "--levels")
+		{
+			levels.clear();
+			for (const std::string& str : SplitList(value))
+			{
+				int level = 0;
+				ok &= ParseInt(str, level);
+				levels.push_back(level);
+			}
+		}
+		else if (name == "--blocks")
+			blocks = SplitList(value);
+		else if (name == "--threads")
+			threads = SplitList(value);
+		else if (name == "--runs")
+			ok = ParseInt(value, g_Options.runs) && g_Options.runs > 0;
+		else if (name == "--json")
+			g_Options.jsonPath = value;
+		else if (name == "--csv")
+			g_Options.csvPath = value;
+		else if (name == "--stream")
+			g_Options.streaming = true;
+		else if (name == "--split")
+			g_Options.streamSplit = true;
+		else if (name == "--fused")
+			g_Options.fusedDecode = true;
+		else if (name == "--verify-order")
+			g_Options.verifyOrder = true;
+		else if (name == "--kernels")
+			g_Options.kernels = true;
+		else if (name == "--tune")
+			ok = ParseDouble(value, g_Options.tuneMinDecodeSpeed) && g_Options.tuneMinDecodeSpeed >= 0;
+		else if (name == "--tune-sample")
+			ok = ParseSize(value, g_Options.tuneSampleSize) && g_Options.tuneSampleSize > 0;
+		else if (name == "--perf-counters")
+			g_Options.perfCounters = true;
+		else if (name == "--trace")
+			g_Options.tracePath = value;
+		else if (name == "--memory-cap")
+			ok = ParseSize(value, g_Options.memoryCap) && g_Options.memoryCap > 0;
+		else if (arg[0] == '-')
+		{
+			printf("ERROR: unknown option '%s'\n", arg);
+			PrintUsage();
+			return 1;
+		}
+		else
+			fileArgs.push_back(arg);
+		if (!ok)
+		{
+			printf("ERROR: invalid value in '%s'\n", arg);
+			return 1;
+		}
+	}
+	if (g_Options.kernels)
+	{
+		printf("CPU: '%s' Compiler: '%s' SIMD width: %i\n", SysInfoGetCpuName().c_str(), SysInfoGetCompilerName().c_str(), SysInfoGetSimdWidth());
+		return BenchQuantKernels() && BenchMathKernels() ? 0 : 1;
+	}
+	if (fileArgs.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (g_Options.streaming && (g_Options.streamSplit || g_Options.tuneMinDecodeSpeed >= 0))
+	{
+		printf("ERROR: stream-split and auto-tune modes are not supported when streaming\n");
+		return 1;
+	}
+
+	// "title=path", or just path
+	std::vector<TestFile> testFiles(fileArgs.size());
+	std::vector<std::string> titles(fileArgs.size());
+	for (size_t i = 0; i < fileArgs.size(); ++i)
+	{
+		const char* sep = strchr(fileArgs[i], '=');
+		titles[i] = sep ? std::string(fileArgs[i], sep - fileArgs[i]) : std::string(fileArgs[i]);
+		testFiles[i].title = titles[i].c_str();
+		testFiles[i].path = sep ? sep + 1 : fileArgs[i];
+	}
+
+	if (orderNames.empty())
+		orderNames = g_Options.streaming ? std::vector<std::string>{ "morton" } : std::vector<std::string>{ "morton", "hilbert", "tiled-morton" };
+	for (const std::string& orderName : orderNames)
+	{
+		auto it = std::find_if(std::begin(g_Orders), std::end(g_Orders), [&](const OrderDesc* o) { return orderName == o->name; });
+		if (it == std::end(g_Orders))
+		{
+			printf("ERROR: unknown spatial order '%s'\n", orderName.c_str());
+			return 1;
+		}
+		g_Options.orders.push_back(*it);
+	}
+	if (profileNames.empty() && customProfiles.empty())
+	{
+		if (g_Options.streaming)
+			profileNames.push_back(g_Quant16.name);
+		else
+		{
+			for (const QuantProfile* profile : g_QuantProfiles)
+				profileNames.push_back(profile->name);
+		}
+	}
+	for (const std::string& profileName : profileNames)
+	{
+		auto it = std::find_if(std::begin(g_QuantProfiles), std::end(g_QuantProfiles), [&](const QuantProfile* p) { return profileName == p->name; });
+		if (it == std::end(g_QuantProfiles))
+		{
+			printf("ERROR: unknown quantization profile '%s'\n", profileName.c_str());
+			return 1;
+		}
+		g_Options.profiles.push_back(*it);
+	}
+	for (const QuantProfile& profile : customProfiles)
+		g_Options.profiles.push_back(&profile);
+
+	printf("CPU: '%s' Compiler: '%s' SIMD width: %i\n", SysInfoGetCpuName().c_str(), SysInfoGetCompilerName().c_str(), SysInfoGetSimdWidth());
+	const SysInfoCpuDetails cpuDetails = SysInfoGetCpuDetails();
+	printf("CPU: %i cores, %i threads, caches L1D %zuKB L2 %zuKB L3 %zuKB\n", cpuDetails.coreCount, cpuDetails.threadCount, cpuDetails.cacheL1D / 1024, cpuDetails.cacheL2 / 1024, cpuDetails.cacheL3 / 1024);
+	if (g_Options.perfCounters && (!SysInfoPerfCountersInit() || !CheckPerfCounters()))
+		g_Options.perfCounters = false;
+	if (!BuildCompressorMatrix(codecs, filters, blocks, threads, levels))
+		return 1;
+	TraceSetEnabled(!g_Options.tracePath.empty());
+
+	if (g_Options.streaming)
+	{
+		for (auto& tf : testFiles)
+		{
+			for (const OrderDesc* orderDesc : g_Options.orders)
+			{
+				for (const QuantProfile* profile : g_Options.profiles)
+				{
+					for (const CompressorConfig& config : g_Compressors)
+					{
+						for (int level : config.GetLevels())
+						{
+							if (!StreamTestFile(tf, config, *orderDesc, *profile, level, g_Options.memoryCap))
+								return 1;
+						}
+					}
+				}
+			}
+		}
+		if (!g_Options.tracePath.empty() && !TraceWriteJson(g_Options.tracePath.c_str()))
+			return 1;
+		return 0;
+	}
+
+	// each ordering & quantization profile goes through the whole pipeline & compressor matrix separately
+	std::vector<BenchResult> results;
+	for (const OrderDesc* orderDesc : g_Options.orders)
+	{
+		for (auto& tf : testFiles)
+		{
+			if (!OpenPlyFile(tf))
+				return 1;
+			ReorderData(tf, *orderDesc);
+			PlyClose(tf.ply);
+			PrintOrderLocality(tf, *orderDesc, BuildPackLayout(*g_Options.profiles[0], tf.plyLayout.shDegree).recordSize);
+			tf.origFileData.swap(tf.fileData);
+		}
+		for (const QuantProfile* profile : g_Options.profiles)
+		{
+			printf("Spatial order: %s, quantization: %s\n", orderDesc->name, profile->name);
+			for (auto& tf : testFiles)
+			{
+				tf.fileData = tf.origFileData;
+				tf.vertexStride = kFullVertexStride;
+				NormalizeRotation(tf);
+				LinearizeData(tf);
+				CalcMinMax(tf);
+				PackData(tf, *profile);
+				if (tf.shCodebook.GetSize() != 0)
+				{
+					const size_t codebookSize = tf.shCodebook.entries.size() * sizeof(float);
+					printf("- %s: %zi bytes/splat, SH codebook %.1fKB (%.2f bytes/splat)\n", tf.title, tf.packLayout.recordSize, codebookSize / 1024.0, double(codebookSize) / tf.vertexCount);
+				}
+				else
+					printf("- %s: %zi bytes/splat\n", tf.title, tf.packLayout.recordSize);
+			}
+			if (g_Options.tuneMinDecodeSpeed >= 0)
+			{
+				TuneSettings tune;
+				tune.runs = g_Options.runs;
+				tune.minDecodeSpeed = g_Options.tuneMinDecodeSpeed;
+				tune.sampleSize = g_Options.tuneSampleSize;
+				TuneCompressors(g_Compressors, tune, testFiles.size(), testFiles.data(), orderDesc->name, profile->name, g_DecodeArenas, results);
+			}
+			else
+				TestCompressors(testFiles.size(), testFiles.data(), orderDesc->name, profile->name, results);
+			for (auto& tf : testFiles)
+			{
+				const size_t packedSize = tf.fileData.size();
+				const uint64_t t0 = stm_now();
+				UnpackData(tf);
+				const double unpackTime = stm_sec(stm_since(t0));
+				printf("- %s unpack: %.3fs (%.2f GB/s)\n", tf.title, unpackTime, packedSize / unpackTime / (1024.0 * 1024.0 * 1024.0));
+				UnlinearizeData(tf);
+				CalcErrorFromOrig(tf);
+			}
+		}
+	}
+
+	BenchRunInfo runInfo;
+	runInfo.cpu = SysInfoGetCpuName();
+	runInfo.compiler = SysInfoGetCompilerName();
+	runInfo.cpuDetails = cpuDetails;
+	runInfo.runs = g_Options.runs;
+	for (const TestFile& tf : testFiles)
+		runInfo.files.push_back(tf.title);
+	if (!g_Options.jsonPath.empty() && !BenchWriteJson(g_Options.jsonPath.c_str(), runInfo, results))
+		return 1;
+	if (!g_Options.csvPath.empty() && !BenchWriteCsv(g_Options.csvPath.c_str(), results))
+		return 1;
+	if (!g_Options.tracePath.empty() && !TraceWriteJson(g_Options.tracePath.c_str()))
+		return 1;
 	return 0;
 }
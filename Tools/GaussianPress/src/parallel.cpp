@@ -0,0 +1,45 @@
+#include "parallel.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+int ParallelGetHardwareThreads()
+{
+	return std::max(1, int(std::thread::hardware_concurrency()));
+}
+
+void ParallelFor(int threadCount, size_t jobCount, const std::function<void(size_t jobIndex, int threadIndex)>& func)
+{
+	threadCount = int(std::min<size_t>(std::max(threadCount, 1), jobCount));
+	if (threadCount <= 1)
+	{
+		for (size_t i = 0; i < jobCount; ++i)
+			func(i, 0);
+		return;
+	}
+
+	std::atomic<size_t> nextJob = 0;
+	auto worker = [&](int threadIndex)
+	{
+		if (threadIndex != 0)
+			TraceSetThreadIndex(threadIndex);
+		while (true)
+		{
+			size_t job = nextJob.fetch_add(1, std::memory_order_relaxed);
+			if (job >= jobCount)
+				break;
+			func(job, threadIndex);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (int i = 1; i < threadCount; ++i)
+		threads.emplace_back(worker, i);
+	worker(0);
+	for (auto& t : threads)
+		t.join();
+}
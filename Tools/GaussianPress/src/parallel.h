@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+
+// Number of hardware threads, at least 1.
+int ParallelGetHardwareThreads();
+
+// Runs func(jobIndex, threadIndex) for jobIndex in [0, jobCount), spread over
+// threadCount threads (the calling thread is one of them). Jobs are handed out
+// in increasing order from a shared counter, threadIndex is in [0, threadCount).
+void ParallelFor(int threadCount, size_t jobCount, const std::function<void(size_t jobIndex, int threadIndex)>& func);
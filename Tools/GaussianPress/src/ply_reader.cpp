@@ -0,0 +1,335 @@
+#include "ply_reader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static bool MapFile(const char* path, PlyFile& ply)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	ply.mapData = (const uint8_t*)data;
+	ply.mapSize = size_t(size.QuadPart);
+	ply.fileSize = ply.mapSize;
+	ply.mapHandle = mapping;
+	ply.fileHandle = file;
+	return true;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // mapping stays valid
+	if (data == MAP_FAILED)
+		return false;
+	// start reading the whole file in the background, while we parse the header etc.
+	madvise(data, size_t(st.st_size), MADV_WILLNEED);
+	ply.mapData = (const uint8_t*)data;
+	ply.mapSize = size_t(st.st_size);
+	ply.fileSize = ply.mapSize;
+	return true;
+#endif
+}
+
+static void UnmapFile(PlyFile& ply)
+{
+	if (ply.mapData == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(ply.mapData);
+	CloseHandle((HANDLE)ply.mapHandle);
+	CloseHandle((HANDLE)ply.fileHandle);
+#else
+	munmap((void*)ply.mapData, ply.mapSize);
+#endif
+	ply.mapData = nullptr;
+	ply.mapSize = 0;
+	ply.mapHandle = nullptr;
+	ply.fileHandle = nullptr;
+}
+
+// Positional reads, so that threads do not share a file position
+static bool ReadFileAt(const PlyFile& ply, uint64_t offset, size_t size, void* dst)
+{
+	uint8_t* ptr = (uint8_t*)dst;
+	while (size > 0)
+	{
+#ifdef _WIN32
+		OVERLAPPED ov = {};
+		ov.Offset = DWORD(offset);
+		ov.OffsetHigh = DWORD(offset >> 32);
+		DWORD got = 0;
+		if (!ReadFile((HANDLE)ply.fileHandle, ptr, DWORD(std::min<size_t>(size, 1u << 30)), &got, &ov) || got == 0)
+			return false;
+#else
+		const ssize_t got = pread(ply.fileDesc, ptr, size, off_t(offset));
+		if (got <= 0)
+			return false;
+#endif
+		ptr += got;
+		offset += got;
+		size -= size_t(got);
+	}
+	return true;
+}
+
+// Opens the file for ReadFileAt, and reads the start of it (enough for any sane header) into header
+static bool OpenFile(const char* path, PlyFile& ply, std::vector<uint8_t>& header)
+{
+	uint64_t fileSize = 0;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	ply.fileHandle = file;
+	fileSize = uint64_t(size.QuadPart);
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	ply.fileDesc = fd;
+	fileSize = uint64_t(st.st_size);
+#endif
+	ply.fileSize = size_t(fileSize);
+	header.resize(size_t(std::min<uint64_t>(fileSize, 1024 * 1024)));
+	return ReadFileAt(ply, 0, header.size(), header.data());
+}
+
+static void CloseFile(PlyFile& ply)
+{
+#ifdef _WIN32
+	// (a mapping's file is closed by UnmapFile)
+	if (ply.mapData == nullptr && ply.fileHandle != nullptr)
+	{
+		CloseHandle((HANDLE)ply.fileHandle);
+		ply.fileHandle = nullptr;
+	}
+#else
+	if (ply.fileDesc >= 0)
+		close(ply.fileDesc);
+	ply.fileDesc = -1;
+#endif
+}
+
+static bool ParsePropertyType(const char* name, PlyPropertyType& type, size_t& size)
+{
+	static const struct { const char* name; const char* altName; PlyPropertyType type; size_t size; } kTypes[] =
+	{
+		{"char", "int8", kPlyInt8, 1},
+		{"uchar", "uint8", kPlyUInt8, 1},
+		{"short", "int16", kPlyInt16, 2},
+		{"ushort", "uint16", kPlyUInt16, 2},
+		{"int", "int32", kPlyInt32, 4},
+		{"uint", "uint32", kPlyUInt32, 4},
+		{"float", "float32", kPlyFloat, 4},
+		{"double", "float64", kPlyDouble, 8},
+	};
+	static_assert(sizeof(kTypes) / sizeof(kTypes[0]) == kPlyTypeCount, "PLY type table size mismatch");
+	for (const auto& t : kTypes)
+	{
+		if (0 == strcmp(name, t.name) || 0 == strcmp(name, t.altName))
+		{
+			type = t.type;
+			size = t.size;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Parse the header: "ply", format, elements with properties, "end_header". Vertex data
+// is expected to be the first element. data is the start of the file (or all of it).
+static bool ParseHeader(const char* path, const uint8_t* data, size_t dataSize, PlyFile& ply)
+{
+	const char* ptr = (const char*)data;
+	const char* end = ptr + dataSize;
+	bool inVertexElement = false;
+	bool seenElement = false;
+	bool seenFormat = false;
+	char lineBuf[1024], word1[256], word2[256], word3[256];
+	while (true)
+	{
+		const char* eol = (const char*)memchr(ptr, '\n', end - ptr);
+		if (eol == nullptr)
+		{
+			printf("ERROR: PLY file %s has no end_header\n", path);
+			return false;
+		}
+		size_t len = std::min(size_t(eol - ptr), sizeof(lineBuf) - 1);
+		memcpy(lineBuf, ptr, len);
+		lineBuf[len] = 0;
+		if (len > 0 && lineBuf[len - 1] == '\r')
+			lineBuf[len - 1] = 0;
+		ptr = eol + 1;
+
+		if (0 == strcmp(lineBuf, "end_header"))
+			break;
+		word1[0] = word2[0] = word3[0] = 0;
+		int words = sscanf(lineBuf, "%255s %255s %255s", word1, word2, word3);
+		if (words <= 0 || 0 == strcmp(word1, "ply") || 0 == strcmp(word1, "comment") || 0 == strcmp(word1, "obj_info"))
+			continue;
+		if (0 == strcmp(word1, "format"))
+		{
+			if (0 != strcmp(word2, "binary_little_endian"))
+			{
+				printf("ERROR: PLY file %s is '%s', only binary_little_endian is supported\n", path, word2);
+				return false;
+			}
+			seenFormat = true;
+		}
+		else if (0 == strcmp(word1, "element"))
+		{
+			inVertexElement = 0 == strcmp(word2, "vertex");
+			if (inVertexElement)
+			{
+				if (seenElement)
+				{
+					printf("ERROR: PLY file %s does not have vertex as the first element\n", path);
+					return false;
+				}
+				ply.vertexCount = strtoull(word3, nullptr, 10);
+			}
+			seenElement = true;
+		}
+		else if (0 == strcmp(word1, "property") && inVertexElement)
+		{
+			if (0 == strcmp(word2, "list"))
+			{
+				printf("ERROR: PLY file %s has list properties in vertex element\n", path);
+				return false;
+			}
+			PlyProperty prop;
+			size_t size = 0;
+			if (!ParsePropertyType(word2, prop.type, size))
+			{
+				printf("ERROR: PLY file %s has unknown property type '%s'\n", path, word2);
+				return false;
+			}
+			prop.name = word3;
+			prop.offset = ply.vertexStride;
+			ply.vertexStride += size;
+			ply.properties.push_back(prop);
+		}
+	}
+	if (!seenFormat || ply.vertexStride == 0)
+	{
+		printf("ERROR: PLY file %s has no format or no vertex properties\n", path);
+		return false;
+	}
+
+	ply.vertexOffset = size_t(ptr - (const char*)data);
+	ply.vertexData = ply.mapData ? ply.mapData + ply.vertexOffset : nullptr;
+	size_t vertexDataSize = ply.fileSize - ply.vertexOffset;
+	if (ply.vertexCount > vertexDataSize / ply.vertexStride)
+	{
+		printf("ERROR: PLY file %s is truncated: %zi verts of %zi bytes do not fit into %zi bytes\n", path, ply.vertexCount, ply.vertexStride, vertexDataSize);
+		return false;
+	}
+	return true;
+}
+
+bool PlyOpen(const char* path, PlyFile& ply, bool mapped)
+{
+	PlyClose(ply);
+	std::vector<uint8_t> header;
+	if (mapped ? !MapFile(path, ply) : !OpenFile(path, ply, header))
+	{
+		printf("ERROR: failed to open data file %s\n", path);
+		PlyClose(ply);
+		return false;
+	}
+	if (mapped ? !ParseHeader(path, ply.mapData, ply.mapSize, ply) : !ParseHeader(path, header.data(), header.size(), ply))
+	{
+		PlyClose(ply);
+		return false;
+	}
+	return true;
+}
+
+void PlyClose(PlyFile& ply)
+{
+	CloseFile(ply);
+	UnmapFile(ply);
+	ply.vertexData = nullptr;
+	ply.vertexCount = 0;
+	ply.vertexStride = 0;
+	ply.vertexOffset = 0;
+	ply.fileSize = 0;
+	ply.properties.clear();
+}
+
+bool PlyRead(const PlyFile& ply, size_t first, size_t count, void* dst)
+{
+	if (first > ply.vertexCount || count > ply.vertexCount - first)
+		return false;
+	if (ply.vertexData != nullptr)
+	{
+		memcpy(dst, ply.vertexData + first * ply.vertexStride, count * ply.vertexStride);
+		return true;
+	}
+	return ReadFileAt(ply, ply.vertexOffset + uint64_t(first) * ply.vertexStride, count * ply.vertexStride, dst);
+}
+
+PlyFile::~PlyFile()
+{
+	PlyClose(*this);
+}
+
+int PlyFindProperty(const PlyFile& ply, const char* name)
+{
+	for (size_t i = 0; i < ply.properties.size(); ++i)
+	{
+		if (ply.properties[i].name == name)
+			return int(i);
+	}
+	return -1;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+enum PlyPropertyType
+{
+	kPlyInt8 = 0,
+	kPlyUInt8,
+	kPlyInt16,
+	kPlyUInt16,
+	kPlyInt32,
+	kPlyUInt32,
+	kPlyFloat,
+	kPlyDouble,
+	kPlyTypeCount
+};
+
+struct PlyProperty
+{
+	std::string name;
+	PlyPropertyType type = kPlyFloat;
+	size_t offset = 0; // byte offset within the vertex
+};
+
+// Binary little endian PLY file. Only the "vertex" element is exposed. When memory mapped, its
+// data is read straight from the mapping (no copies), and the mapping stays alive until PlyClose
+// or destruction. Otherwise (vertexData is null) vertices are read with PlyRead, so that memory
+// use does not depend on the file size; pages of a mapping that were touched stay resident.
+struct PlyFile
+{
+	PlyFile() = default;
+	~PlyFile();
+	PlyFile(const PlyFile&) = delete;
+	PlyFile& operator=(const PlyFile&) = delete;
+
+	const uint8_t* vertexData = nullptr;
+	size_t vertexCount = 0;
+	size_t vertexStride = 0;
+	size_t vertexOffset = 0; // in the file
+	size_t fileSize = 0;
+	std::vector<PlyProperty> properties;
+
+	// mapping, or file for PlyRead
+	const uint8_t* mapData = nullptr;
+	size_t mapSize = 0;
+	void* mapHandle = nullptr;
+	void* fileHandle = nullptr;
+	int fileDesc = -1;
+};
+
+bool PlyOpen(const char* path, PlyFile& ply, bool mapped = true);
+void PlyClose(PlyFile& ply);
+
+// Copies raw data (vertexStride bytes each) of count vertices starting at first into dst; works
+// on mapped files too. Can be called from several threads at once.
+bool PlyRead(const PlyFile& ply, size_t first, size_t count, void* dst);
+
+// index into properties, or -1 if there is none with this name
+int PlyFindProperty(const PlyFile& ply, const char* name);
+
+// read a single property value and convert to float
+inline float PlyReadValue(const uint8_t* ptr, PlyPropertyType type)
+{
+	switch (type)
+	{
+	case kPlyInt8: return float(*(const int8_t*)ptr);
+	case kPlyUInt8: return float(*(const uint8_t*)ptr);
+	case kPlyInt16: return float(*(const int16_t*)ptr);
+	case kPlyUInt16: return float(*(const uint16_t*)ptr);
+	case kPlyInt32: return float(*(const int32_t*)ptr);
+	case kPlyUInt32: return float(*(const uint32_t*)ptr);
+	case kPlyFloat: return *(const float*)ptr;
+	case kPlyDouble: return float(*(const double*)ptr);
+	default: return 0.0f;
+	}
+}
@@ -0,0 +1,112 @@
+#include "quantize.h"
+#include "simd.h"
+#include "systeminfo.h"
+
+void Quant_PackUnormScalar(const float* src, uint16_t* dst, size_t count, float vmin, float invRange, int bits)
+{
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = uint16_t(QuantPackUnorm(src[i], vmin, invRange, bits));
+}
+
+void Quant_UnpackUnormScalar(const uint16_t* src, float* dst, size_t count, float vmin, float vmax, int bits)
+{
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = QuantUnpackUnorm(src[i], vmin, vmax, bits);
+}
+
+// 8 values at a time; same math in the same order as the scalar functions
+void Quant_PackUnorm16(const float* src, uint16_t* dst, size_t count, float vmin, float invRange, int bits)
+{
+	size_t i = 0;
+#if CPU_ARCH_X64
+	const __m128 vmn = _mm_set1_ps(vmin);
+	const __m128 vinv = _mm_set1_ps(invRange);
+	const __m128 vscale = _mm_set1_ps(float((1 << bits) - 1));
+	const __m128 vzero = _mm_setzero_ps();
+	const __m128 vone = _mm_set1_ps(1.0f);
+	const __m128 vhalf = _mm_set1_ps(0.5f);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i q[2];
+		for (int k = 0; k < 2; ++k)
+		{
+			__m128 v = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(src + i + k * 4), vmn), vinv);
+			v = _mm_min_ps(_mm_max_ps(v, vzero), vone); // max gives the second operand for NaN
+			q[k] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, vscale), vhalf));
+		}
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi32(q[0], q[1]));
+	}
+#elif CPU_ARCH_ARM64
+	const float32x4_t vmn = vdupq_n_f32(vmin);
+	const float32x4_t vinv = vdupq_n_f32(invRange);
+	const float32x4_t vscale = vdupq_n_f32(float((1 << bits) - 1));
+	const float32x4_t vzero = vdupq_n_f32(0.0f);
+	const float32x4_t vone = vdupq_n_f32(1.0f);
+	const float32x4_t vhalf = vdupq_n_f32(0.5f);
+	for (; i + 8 <= count; i += 8)
+	{
+		uint16x4_t q[2];
+		for (int k = 0; k < 2; ++k)
+		{
+			float32x4_t v = vmulq_f32(vsubq_f32(vld1q_f32(src + i + k * 4), vmn), vinv);
+			v = vminq_f32(vmaxnmq_f32(v, vzero), vone); // maxnm gives the number for NaN
+			q[k] = vmovn_u32(vcvtq_u32_f32(vaddq_f32(vmulq_f32(v, vscale), vhalf)));
+		}
+		vst1q_u16(dst + i, vcombine_u16(q[0], q[1]));
+	}
+#endif
+	Quant_PackUnormScalar(src + i, dst + i, count - i, vmin, invRange, bits);
+}
+
+void Quant_UnpackUnorm16(const uint16_t* src, float* dst, size_t count, float vmin, float vmax, int bits)
+{
+	size_t i = 0;
+#if CPU_ARCH_X64
+	const __m128 vmn = _mm_set1_ps(vmin);
+	const __m128 vmx = _mm_set1_ps(vmax);
+	const __m128 vmul = _mm_set1_ps(1.0f / float((1 << bits) - 1));
+	const __m128 vone = _mm_set1_ps(1.0f);
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i u = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i u32[2] = { _mm_cvtepu16_epi32(u), _mm_cvtepu16_epi32(_mm_srli_si128(u, 8)) };
+		for (int k = 0; k < 2; ++k)
+		{
+			const __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(u32[k]), vmul);
+			_mm_storeu_ps(dst + i + k * 4, _mm_add_ps(_mm_mul_ps(vmn, _mm_sub_ps(vone, v)), _mm_mul_ps(vmx, v)));
+		}
+	}
+#elif CPU_ARCH_ARM64
+	const float32x4_t vmn = vdupq_n_f32(vmin);
+	const float32x4_t vmx = vdupq_n_f32(vmax);
+	const float32x4_t vmul = vdupq_n_f32(1.0f / float((1 << bits) - 1));
+	const float32x4_t vone = vdupq_n_f32(1.0f);
+	for (; i + 8 <= count; i += 8)
+	{
+		const uint16x8_t u = vld1q_u16(src + i);
+		const uint32x4_t u32[2] = { vmovl_u16(vget_low_u16(u)), vmovl_u16(vget_high_u16(u)) };
+		for (int k = 0; k < 2; ++k)
+		{
+			const float32x4_t v = vmulq_f32(vcvtq_f32_u32(u32[k]), vmul);
+			vst1q_f32(dst + i + k * 4, vaddq_f32(vmulq_f32(vmn, vsubq_f32(vone, v)), vmulq_f32(vmx, v)));
+		}
+	}
+#endif
+	Quant_UnpackUnormScalar(src + i, dst + i, count - i, vmin, vmax, bits);
+}
+
+void Quant_PackUnorm(const float* src, uint16_t* dst, size_t count, float vmin, float invRange, int bits)
+{
+	if (SysInfoGetSimdWidth() >= 32)
+		Quant_PackUnorm32(src, dst, count, vmin, invRange, bits);
+	else
+		Quant_PackUnorm16(src, dst, count, vmin, invRange, bits);
+}
+
+void Quant_UnpackUnorm(const uint16_t* src, float* dst, size_t count, float vmin, float vmax, int bits)
+{
+	if (SysInfoGetSimdWidth() >= 32)
+		Quant_UnpackUnorm32(src, dst, count, vmin, vmax, bits);
+	else
+		Quant_UnpackUnorm16(src, dst, count, vmin, vmax, bits);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Unorm quantization of floats within [vmin, vmax] into 1..16 bit integers, and back. Both ways
+// multiply by precomputed reciprocals instead of dividing; values outside of the range (and NaNs)
+// are clamped. The array functions work on SoA data (one attribute of many splats), and their
+// SIMD variants give exactly the same results as the scalar functions.
+//
+// Scalar functions are static, since the AVX2 translation unit includes this too (see simd.h).
+
+// 0 for an empty range, so that everything quantizes to 0
+static inline float QuantCalcInvRange(float vmin, float vmax)
+{
+	return vmax > vmin ? 1.0f / (vmax - vmin) : 0.0f;
+}
+
+// The SIMD variants do not use FMAs, so neither may this; the quantize sources are compiled with
+// FP contraction off (see CMakeLists.txt), since separate statements alone do not prevent it
+static inline uint32_t QuantPackUnorm(float v, float vmin, float invRange, int bits)
+{
+	const float scale = float((1 << bits) - 1);
+	v = (v - vmin) * invRange;
+	v = v >= 0.0f ? v : 0.0f; // NaN too
+	v = v <= 1.0f ? v : 1.0f;
+	const float scaled = v * scale;
+	return uint32_t(scaled + 0.5f);
+}
+
+static inline float QuantUnpackUnorm(uint32_t u, float vmin, float vmax, int bits)
+{
+	const float v = float(u) * (1.0f / float((1 << bits) - 1));
+	const float a = vmin * (1.0f - v);
+	const float b = vmax * v;
+	return a + b;
+}
+
+// Uses the widest SIMD variant below that the CPU supports
+void Quant_PackUnorm(const float* src, uint16_t* dst, size_t count, float vmin, float invRange, int bits);
+void Quant_UnpackUnorm(const uint16_t* src, float* dst, size_t count, float vmin, float vmax, int bits);
+
+// Specific variants of the above: scalar, 16 bytes (SSE4.1/NEON) and 32 bytes (AVX2; see SysInfoGetSimdWidth)
+void Quant_PackUnormScalar(const float* src, uint16_t* dst, size_t count, float vmin, float invRange, int bits);
+void Quant_UnpackUnormScalar(const uint16_t* src, float* dst, size_t count, float vmin, float vmax, int bits);
+void Quant_PackUnorm16(const float* src, uint16_t* dst, size_t count, float vmin, float invRange, int bits);
+void Quant_UnpackUnorm16(const uint16_t* src, float* dst, size_t count, float vmin, float vmax, int bits);
+void Quant_PackUnorm32(const float* src, uint16_t* dst, size_t count, float vmin, float invRange, int bits);
+void Quant_UnpackUnorm32(const uint16_t* src, float* dst, size_t count, float vmin, float vmax, int bits);
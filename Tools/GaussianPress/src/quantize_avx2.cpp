@@ -0,0 +1,65 @@
+#include "quantize.h"
+#include "simd.h"
+
+// No FMA (not enabled here), so the results are the same as the scalar & 16 byte ones.
+
+#if SIMD_HAS_BYTES32
+
+// 16 values at a time
+void Quant_PackUnorm32(const float* src, uint16_t* dst, size_t count, float vmin, float invRange, int bits)
+{
+	const __m256 vmn = _mm256_set1_ps(vmin);
+	const __m256 vinv = _mm256_set1_ps(invRange);
+	const __m256 vscale = _mm256_set1_ps(float((1 << bits) - 1));
+	const __m256 vzero = _mm256_setzero_ps();
+	const __m256 vone = _mm256_set1_ps(1.0f);
+	const __m256 vhalf = _mm256_set1_ps(0.5f);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i q[2];
+		for (int k = 0; k < 2; ++k)
+		{
+			__m256 v = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(src + i + k * 8), vmn), vinv);
+			v = _mm256_min_ps(_mm256_max_ps(v, vzero), vone); // max gives the second operand for NaN
+			q[k] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, vscale), vhalf));
+		}
+		// packus works within 128 bit lanes; put the 64 bit quarters back in order
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(q[0], q[1]), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i*)(dst + i), packed);
+	}
+	Quant_PackUnorm16(src + i, dst + i, count - i, vmin, invRange, bits);
+}
+
+void Quant_UnpackUnorm32(const uint16_t* src, float* dst, size_t count, float vmin, float vmax, int bits)
+{
+	const __m256 vmn = _mm256_set1_ps(vmin);
+	const __m256 vmx = _mm256_set1_ps(vmax);
+	const __m256 vmul = _mm256_set1_ps(1.0f / float((1 << bits) - 1));
+	const __m256 vone = _mm256_set1_ps(1.0f);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		for (int k = 0; k < 2; ++k)
+		{
+			const __m256i u = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i + k * 8)));
+			const __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(u), vmul);
+			_mm256_storeu_ps(dst + i + k * 8, _mm256_add_ps(_mm256_mul_ps(vmn, _mm256_sub_ps(vone, v)), _mm256_mul_ps(vmx, v)));
+		}
+	}
+	Quant_UnpackUnorm16(src + i, dst + i, count - i, vmin, vmax, bits);
+}
+
+#else
+
+void Quant_PackUnorm32(const float* src, uint16_t* dst, size_t count, float vmin, float invRange, int bits)
+{
+	Quant_PackUnorm16(src, dst, count, vmin, invRange, bits);
+}
+
+void Quant_UnpackUnorm32(const uint16_t* src, float* dst, size_t count, float vmin, float vmax, int bits)
+{
+	Quant_UnpackUnorm16(src, dst, count, vmin, vmax, bits);
+}
+
+#endif // #if SIMD_HAS_BYTES32
@@ -0,0 +1,130 @@
+#include "quat_codec.h"
+#include "simd.h"
+
+#include <math.h>
+#include <algorithm>
+
+const float kSqrt2 = 1.41421356f;
+const float kInvSqrt2 = 0.70710678f;
+
+QuatSmallest3 QuatEncodeSmallest3(const float q[4], int bits)
+{
+	int largest = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		if (fabsf(q[i]) > fabsf(q[largest]))
+			largest = i;
+	}
+	const float sign = q[largest] < 0 ? -1.0f : 1.0f;
+	const float scale = float((1 << bits) - 1);
+	uint32_t comps[3];
+	for (int i = 0, j = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+		float v = (q[i] * sign * kSqrt2) * 0.5f + 0.5f;
+		v = std::min(std::max(v, 0.0f), 1.0f);
+		comps[j++] = uint32_t(v * scale + 0.5f);
+	}
+	return { uint32_t(largest), comps[0], comps[1], comps[2] };
+}
+
+// Scalar path (for the remainder) does the same math in the same order as the SIMD one
+static void DecodeOne(const QuatSmallest3& s, float mul, float* dst)
+{
+	const float a = (float(s.a) * mul - 1.0f) * kInvSqrt2;
+	const float b = (float(s.b) * mul - 1.0f) * kInvSqrt2;
+	const float c = (float(s.c) * mul - 1.0f) * kInvSqrt2;
+	const float w = sqrtf(std::max(1.0f - (a * a + b * b + c * c), 0.0f));
+	dst[0] = s.index == 0 ? w : a;
+	dst[1] = s.index == 1 ? w : (s.index == 0 ? a : b);
+	dst[2] = s.index == 2 ? w : (s.index < 2 ? b : c);
+	dst[3] = s.index == 3 ? w : c;
+}
+
+void QuatDecodeSmallest3(const QuatSmallest3* src, size_t count, int bits, float* dst, size_t dstStride)
+{
+	static_assert(sizeof(QuatSmallest3) == 16, "smallest-three fields expected to be 16 bytes");
+	const float mul = 2.0f / float((1 << bits) - 1);
+	uint8_t* dstBytes = (uint8_t*)dst;
+	size_t i = 0;
+#if CPU_ARCH_X64
+	const __m128 vmul = _mm_set1_ps(mul);
+	const __m128 vone = _mm_set1_ps(1.0f);
+	const __m128 vzero = _mm_setzero_ps();
+	const __m128 vinv = _mm_set1_ps(kInvSqrt2);
+	for (; i + 4 <= count; i += 4)
+	{
+		// rows are (index, a, b, c) of each quaternion; transpose into index, a, b, c of 4 quaternions
+		__m128 r0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(src + i + 0)));
+		__m128 r1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(src + i + 1)));
+		__m128 r2 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(src + i + 2)));
+		__m128 r3 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(src + i + 3)));
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		__m128i index = _mm_castps_si128(r0);
+		__m128 a = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r1)), vmul), vone), vinv);
+		__m128 b = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r2)), vmul), vone), vinv);
+		__m128 c = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r3)), vmul), vone), vinv);
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c));
+		__m128 w = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(vone, sum), vzero));
+
+		__m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(0)));
+		__m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(1)));
+		__m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(2)));
+		__m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(3)));
+		__m128 o0 = _mm_blendv_ps(a, w, is0);
+		__m128 o1 = _mm_blendv_ps(_mm_blendv_ps(b, a, is0), w, is1);
+		__m128 o2 = _mm_blendv_ps(_mm_blendv_ps(c, b, _mm_or_ps(is0, is1)), w, is2);
+		__m128 o3 = _mm_blendv_ps(c, w, is3);
+
+		// back to one quaternion per register
+		_MM_TRANSPOSE4_PS(o0, o1, o2, o3);
+		_mm_storeu_ps((float*)(dstBytes + (i + 0) * dstStride), o0);
+		_mm_storeu_ps((float*)(dstBytes + (i + 1) * dstStride), o1);
+		_mm_storeu_ps((float*)(dstBytes + (i + 2) * dstStride), o2);
+		_mm_storeu_ps((float*)(dstBytes + (i + 3) * dstStride), o3);
+	}
+#elif CPU_ARCH_ARM64
+	const float32x4_t vmul = vdupq_n_f32(mul);
+	const float32x4_t vone = vdupq_n_f32(1.0f);
+	const float32x4_t vzero = vdupq_n_f32(0.0f);
+	const float32x4_t vinv = vdupq_n_f32(kInvSqrt2);
+	for (; i + 4 <= count; i += 4)
+	{
+		// de-interleaving load: index, a, b, c of 4 quaternions
+		uint32x4x4_t r = vld4q_u32((const uint32_t*)(src + i));
+		uint32x4_t index = r.val[0];
+		float32x4_t a = vmulq_f32(vsubq_f32(vmulq_f32(vcvtq_f32_u32(r.val[1]), vmul), vone), vinv);
+		float32x4_t b = vmulq_f32(vsubq_f32(vmulq_f32(vcvtq_f32_u32(r.val[2]), vmul), vone), vinv);
+		float32x4_t c = vmulq_f32(vsubq_f32(vmulq_f32(vcvtq_f32_u32(r.val[3]), vmul), vone), vinv);
+		float32x4_t sum = vaddq_f32(vaddq_f32(vmulq_f32(a, a), vmulq_f32(b, b)), vmulq_f32(c, c));
+		float32x4_t w = vsqrtq_f32(vmaxq_f32(vsubq_f32(vone, sum), vzero));
+
+		uint32x4_t is0 = vceqq_u32(index, vdupq_n_u32(0));
+		uint32x4_t is1 = vceqq_u32(index, vdupq_n_u32(1));
+		uint32x4_t is2 = vceqq_u32(index, vdupq_n_u32(2));
+		uint32x4_t is3 = vceqq_u32(index, vdupq_n_u32(3));
+		float32x4x4_t o;
+		o.val[0] = vbslq_f32(is0, w, a);
+		o.val[1] = vbslq_f32(is1, w, vbslq_f32(is0, a, b));
+		o.val[2] = vbslq_f32(is2, w, vbslq_f32(vorrq_u32(is0, is1), b, c));
+		o.val[3] = vbslq_f32(is3, w, c);
+
+		if (dstStride == 16)
+		{
+			vst4q_f32(dst + i * 4, o);
+			continue;
+		}
+		float32x4_t t0 = vzip1q_f32(o.val[0], o.val[2]);
+		float32x4_t t1 = vzip2q_f32(o.val[0], o.val[2]);
+		float32x4_t t2 = vzip1q_f32(o.val[1], o.val[3]);
+		float32x4_t t3 = vzip2q_f32(o.val[1], o.val[3]);
+		vst1q_f32((float*)(dstBytes + (i + 0) * dstStride), vzip1q_f32(t0, t2));
+		vst1q_f32((float*)(dstBytes + (i + 1) * dstStride), vzip2q_f32(t0, t2));
+		vst1q_f32((float*)(dstBytes + (i + 2) * dstStride), vzip1q_f32(t1, t3));
+		vst1q_f32((float*)(dstBytes + (i + 3) * dstStride), vzip2q_f32(t1, t3));
+	}
+#endif
+	for (; i < count; ++i)
+		DecodeOne(src[i], mul, (float*)(dstBytes + i * dstStride));
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Smallest-three quaternion encoding: the largest magnitude component is dropped (the
+// quaternion is negated if needed so that it is positive, q and -q being the same rotation),
+// and the other three, which are within [-1/sqrt(2), 1/sqrt(2)], are quantized to the
+// given number of bits each. The 2-bit index says which component was dropped.
+// E.g. 10 bits per component makes a quaternion fit into 32 bits.
+//
+// Quaternion component order is w, x, y, z; input has to be normalized.
+
+struct QuatSmallest3
+{
+	uint32_t index; // of the dropped component
+	uint32_t a, b, c; // remaining components in order
+};
+
+QuatSmallest3 QuatEncodeSmallest3(const float q[4], int bits);
+
+// Decodes count quaternions into dst (w, x, y, z floats), each next one dstStride bytes
+// further. Processes 4 quaternions at a time with SSE/NEON.
+void QuatDecodeSmallest3(const QuatSmallest3* src, size_t count, int bits, float* dst, size_t dstStride);
@@ -0,0 +1,200 @@
+#include "radix_sort.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+const int kRadixBits = 11;
+const size_t kRadixSize = 1 << kRadixBits;
+const size_t kRadixMask = kRadixSize - 1;
+const size_t kLsdMaxItems = 64 * 1024; // ranges up to this size are sorted by LSD passes (~1MB of data, fits into L2)
+const size_t kMinItemsPerThread = 64 * 1024; // for less than this, threading overhead dominates
+
+static int HighestBit(uint64_t x)
+{
+	int res = 0;
+	while (x != 0)
+	{
+		x >>= 1;
+		++res;
+	}
+	return res;
+}
+
+// Turn digit counts into output start positions; returns total count
+static size_t CountsToOffsets(size_t* counts, size_t n)
+{
+	size_t sum = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		size_t c = counts[i];
+		counts[i] = sum;
+		sum += c;
+	}
+	return sum;
+}
+
+// Sort by the low "bits" of the keys; result ends up in keys/values
+static void SortRangeLsd(uint64_t* keys, uint32_t* values, uint64_t* tmpKeys, uint32_t* tmpValues, size_t count, int bits)
+{
+	uint64_t* srcKeys = keys;
+	uint32_t* srcValues = values;
+	uint64_t* dstKeys = tmpKeys;
+	uint32_t* dstValues = tmpValues;
+	size_t offsets[kRadixSize];
+	for (int shift = 0; shift < bits; shift += kRadixBits)
+	{
+		memset(offsets, 0, sizeof(offsets));
+		for (size_t i = 0; i < count; ++i)
+			offsets[(srcKeys[i] >> shift) & kRadixMask]++;
+		CountsToOffsets(offsets, kRadixSize);
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint64_t key = srcKeys[i];
+			size_t dst = offsets[(key >> shift) & kRadixMask]++;
+			dstKeys[dst] = key;
+			dstValues[dst] = srcValues[i];
+		}
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcValues, dstValues);
+	}
+	if (srcKeys != keys)
+	{
+		memcpy(keys, srcKeys, count * sizeof(keys[0]));
+		memcpy(values, srcValues, count * sizeof(values[0]));
+	}
+}
+
+// Sort by the low "bits" of the keys; result ends up in keys/values
+static void SortRange(uint64_t* keys, uint32_t* values, uint64_t* tmpKeys, uint32_t* tmpValues, size_t count, int bits)
+{
+	if (count < 2 || bits <= 0)
+		return;
+	const uint64_t bitMask = bits >= 64 ? ~0ull : (1ull << bits) - 1;
+	uint64_t diff = 0;
+	for (size_t i = 0; i < count; ++i)
+		diff |= keys[i] ^ keys[0];
+	diff &= bitMask;
+	if (diff == 0)
+		return;
+	const int topBit = HighestBit(diff);
+	if (count <= kLsdMaxItems)
+	{
+		SortRangeLsd(keys, values, tmpKeys, tmpValues, count, topBit);
+		return;
+	}
+
+	// split by the top digit into tmp, sort each bucket there, copy back
+	const int shift = std::max(0, topBit - kRadixBits);
+	size_t offsets[kRadixSize + 1];
+	memset(offsets, 0, sizeof(offsets));
+	for (size_t i = 0; i < count; ++i)
+		offsets[(keys[i] >> shift) & kRadixMask]++;
+	CountsToOffsets(offsets, kRadixSize);
+	offsets[kRadixSize] = count;
+	size_t starts[kRadixSize + 1];
+	memcpy(starts, offsets, sizeof(starts));
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t key = keys[i];
+		size_t dst = offsets[(key >> shift) & kRadixMask]++;
+		tmpKeys[dst] = key;
+		tmpValues[dst] = values[i];
+	}
+	for (size_t digit = 0; digit < kRadixSize; ++digit)
+	{
+		const size_t start = starts[digit];
+		SortRange(tmpKeys + start, tmpValues + start, keys + start, values + start, starts[digit + 1] - start, shift);
+	}
+	memcpy(keys, tmpKeys, count * sizeof(keys[0]));
+	memcpy(values, tmpValues, count * sizeof(values[0]));
+}
+
+void RadixSort64(uint64_t* keys, uint32_t* values, size_t count, int threadCount)
+{
+	TraceZone zone("RadixSort64");
+	if (count < 2)
+		return;
+	const int chunkCount = int(std::clamp<size_t>(count / kMinItemsPerThread, 1, std::max(threadCount, 1)));
+	const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+	// which key bits differ at all
+	std::vector<uint64_t> chunkDiff(chunkCount);
+	ParallelFor(chunkCount, chunkCount, [&](size_t chunk, int)
+	{
+		const size_t start = chunk * chunkSize;
+		const size_t end = std::min(start + chunkSize, count);
+		uint64_t diff = 0;
+		for (size_t i = start; i < end; ++i)
+			diff |= keys[i] ^ keys[0];
+		chunkDiff[chunk] = diff;
+	});
+	uint64_t diff = 0;
+	for (uint64_t d : chunkDiff)
+		diff |= d;
+	if (diff == 0)
+		return;
+	const int topBit = HighestBit(diff);
+
+	std::vector<uint64_t> tmpKeys(count);
+	std::vector<uint32_t> tmpValues(count);
+	if (count <= kLsdMaxItems)
+	{
+		SortRangeLsd(keys, values, tmpKeys.data(), tmpValues.data(), count, topBit);
+		return;
+	}
+
+	// split by the top digit into tmp: per chunk histograms, that after prefix sum become
+	// per chunk output positions (for stability, each digit goes chunk after chunk)
+	const int shift = std::max(0, topBit - kRadixBits);
+	std::vector<size_t> offsets(chunkCount * kRadixSize);
+	ParallelFor(chunkCount, chunkCount, [&](size_t chunk, int)
+	{
+		size_t* hist = offsets.data() + chunk * kRadixSize;
+		const size_t start = chunk * chunkSize;
+		const size_t end = std::min(start + chunkSize, count);
+		for (size_t i = start; i < end; ++i)
+			hist[(keys[i] >> shift) & kRadixMask]++;
+	});
+	std::vector<size_t> starts(kRadixSize + 1);
+	size_t sum = 0;
+	for (size_t digit = 0; digit < kRadixSize; ++digit)
+	{
+		starts[digit] = sum;
+		for (int chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			size_t& pos = offsets[chunk * kRadixSize + digit];
+			size_t n = pos;
+			pos = sum;
+			sum += n;
+		}
+	}
+	starts[kRadixSize] = count;
+	ParallelFor(chunkCount, chunkCount, [&](size_t chunk, int)
+	{
+		size_t* pos = offsets.data() + chunk * kRadixSize;
+		const size_t start = chunk * chunkSize;
+		const size_t end = std::min(start + chunkSize, count);
+		for (size_t i = start; i < end; ++i)
+		{
+			uint64_t key = keys[i];
+			size_t dst = pos[(key >> shift) & kRadixMask]++;
+			tmpKeys[dst] = key;
+			tmpValues[dst] = values[i];
+		}
+	});
+
+	// sort the buckets independently, and put them back into place
+	ParallelFor(threadCount, kRadixSize, [&](size_t digit, int)
+	{
+		const size_t start = starts[digit];
+		const size_t n = starts[digit + 1] - start;
+		if (n == 0)
+			return;
+		SortRange(tmpKeys.data() + start, tmpValues.data() + start, keys + start, values + start, n, shift);
+		memcpy(keys + start, tmpKeys.data() + start, n * sizeof(keys[0]));
+		memcpy(values + start, tmpValues.data() + start, n * sizeof(values[0]));
+	});
+}
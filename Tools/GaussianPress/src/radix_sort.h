@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Stable radix sort of 64-bit keys, with 32-bit values moved along with them.
+//
+// First pass splits the data by the top 11 bits that differ between keys, spread over
+// threadCount threads. Resulting buckets are then sorted on their own in parallel: large
+// ones are split the same way again, ones that fit into cache get an LSD radix sort.
+// Key bits that are the same in all keys of a range are skipped.
+// Needs temporary memory of the same size as the input.
+void RadixSort64(uint64_t* keys, uint32_t* values, size_t count, int threadCount);
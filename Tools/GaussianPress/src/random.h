@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// splitmix64; small and fast, and gives the same sequence on all platforms
+static inline uint64_t RandomNext(uint64_t& state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1), from the top 24 bits of a random value
+static inline float RandomToFloat(uint64_t r)
+{
+	return float(r >> 40) / float(1 << 24);
+}
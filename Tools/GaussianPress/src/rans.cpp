@@ -0,0 +1,377 @@
+#include "rans.h"
+#include "simd.h"
+#include "systeminfo.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Each chunk: mode byte, then
+// - kModeRans: frequency table, uint32 payload size, payload = kRansLanes uint32 initial
+//   decoder states, then the uint16 renormalization words in decoding order.
+// - kModeSingle: the one symbol the whole chunk is made of.
+// - kModeStored: chunk bytes as is, when coding would not make them smaller.
+enum ChunkMode
+{
+	kModeRans = 0,
+	kModeSingle,
+	kModeStored,
+};
+
+size_t RansCompressBound(size_t srcSize)
+{
+	return srcSize + (srcSize + kRansChunkSize - 1) / kRansChunkSize;
+}
+
+// Scale counts so they sum to kRansProbScale, keeping each present symbol at least 1.
+// Rounding error goes into the most frequent symbol, unless it is too small to take it.
+static void NormalizeFreqs(const uint32_t counts[256], size_t total, uint32_t freqs[256])
+{
+	uint32_t sum = 0;
+	int maxSym = 0;
+	for (int s = 0; s < 256; ++s)
+	{
+		freqs[s] = counts[s] ? std::max<uint32_t>(uint32_t(uint64_t(counts[s]) * kRansProbScale / total), 1) : 0;
+		sum += freqs[s];
+		if (counts[s] > counts[maxSym])
+			maxSym = s;
+	}
+	if (sum <= kRansProbScale || freqs[maxSym] > sum - kRansProbScale)
+	{
+		freqs[maxSym] += kRansProbScale - sum;
+		return;
+	}
+	while (sum > kRansProbScale)
+	{
+		int largest = int(std::max_element(freqs, freqs + 256) - freqs);
+		--freqs[largest];
+		--sum;
+	}
+}
+
+// Zero frequencies are stored as runs: 0, then run length - 1
+static uint8_t* WriteFreqTable(const uint32_t freqs[256], uint8_t* dst)
+{
+	for (int s = 0; s < 256;)
+	{
+		const uint32_t f = freqs[s];
+		if (f == 0)
+		{
+			int run = 1;
+			while (s + run < 256 && freqs[s + run] == 0)
+				++run;
+			*dst++ = 0;
+			*dst++ = uint8_t(run - 1);
+			s += run;
+			continue;
+		}
+		if (f < 128)
+			*dst++ = uint8_t(f);
+		else
+		{
+			*dst++ = uint8_t((f & 127) | 128);
+			*dst++ = uint8_t(f >> 7);
+		}
+		++s;
+	}
+	return dst;
+}
+
+static const uint8_t* ReadFreqTable(const uint8_t* src, const uint8_t* srcEnd, uint32_t freqs[256])
+{
+	for (int s = 0; s < 256;)
+	{
+		if (src >= srcEnd)
+			return nullptr;
+		uint32_t f = *src++;
+		if (f == 0)
+		{
+			if (src >= srcEnd)
+				return nullptr;
+			const int run = *src++ + 1;
+			if (s + run > 256)
+				return nullptr;
+			for (int i = 0; i < run; ++i)
+				freqs[s++] = 0;
+			continue;
+		}
+		if (f & 128)
+		{
+			if (src >= srcEnd)
+				return nullptr;
+			f = (f & 127) | (uint32_t(*src++) << 7);
+		}
+		freqs[s++] = f;
+	}
+	return src;
+}
+
+// words: scratch space of at least size uint16s. Returns chunk size written to dst
+// (at most size + 1, falling back to storing the chunk as is).
+static size_t CompressChunk(const uint8_t* src, size_t size, uint8_t* dst, std::vector<uint16_t>& words)
+{
+	uint32_t counts[256] = {};
+	for (size_t i = 0; i < size; ++i)
+		counts[src[i]]++;
+	if (counts[src[0]] == size)
+	{
+		dst[0] = kModeSingle;
+		dst[1] = src[0];
+		return 2;
+	}
+
+	uint32_t freqs[256];
+	NormalizeFreqs(counts, size, freqs);
+	uint32_t starts[256];
+	uint32_t start = 0;
+	for (int s = 0; s < 256; ++s)
+	{
+		starts[s] = start;
+		start += freqs[s];
+	}
+
+	// encode backwards, so that the decoder reads everything forwards
+	uint32_t states[kRansLanes];
+	for (uint32_t& x : states)
+		x = kRansL;
+	uint16_t* wordsEnd = words.data() + words.size();
+	uint16_t* w = wordsEnd;
+	for (size_t i = size; i-- > 0;)
+	{
+		const uint8_t sym = src[i];
+		const uint32_t freq = freqs[sym];
+		uint32_t x = states[i % kRansLanes];
+		if (x >= ((kRansL >> kRansProbBits) << 16) * freq)
+		{
+			*--w = uint16_t(x);
+			x >>= 16;
+		}
+		states[i % kRansLanes] = ((x / freq) << kRansProbBits) + (x % freq) + starts[sym];
+	}
+
+	const size_t wordCount = wordsEnd - w;
+	const size_t payloadSize = sizeof(states) + wordCount * sizeof(uint16_t);
+	uint8_t tableBuf[512];
+	const size_t tableSize = WriteFreqTable(freqs, tableBuf) - tableBuf;
+	const size_t codedSize = 1 + tableSize + sizeof(uint32_t) + payloadSize;
+	if (codedSize >= size + 1)
+	{
+		dst[0] = kModeStored;
+		memcpy(dst + 1, src, size);
+		return size + 1;
+	}
+	uint8_t* d = dst;
+	*d++ = kModeRans;
+	memcpy(d, tableBuf, tableSize);
+	d += tableSize;
+	const uint32_t payloadSize32 = uint32_t(payloadSize);
+	memcpy(d, &payloadSize32, sizeof(payloadSize32));
+	d += sizeof(payloadSize32);
+	memcpy(d, states, sizeof(states));
+	d += sizeof(states);
+	memcpy(d, w, wordCount * sizeof(uint16_t));
+	return codedSize;
+}
+
+size_t RansCompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity)
+{
+	std::vector<uint16_t> words(std::min(srcSize, kRansChunkSize));
+	std::vector<uint8_t> chunkBuf(kRansChunkSize + 1);
+	size_t dstSize = 0;
+	for (size_t offset = 0; offset < srcSize; offset += kRansChunkSize)
+	{
+		const size_t size = std::min(kRansChunkSize, srcSize - offset);
+		const size_t chunkSize = CompressChunk(src + offset, size, chunkBuf.data(), words);
+		if (dstSize + chunkSize > dstCapacity)
+			return 0;
+		memcpy(dst + dstSize, chunkBuf.data(), chunkSize);
+		dstSize += chunkSize;
+	}
+	return dstSize;
+}
+
+// Decoding table entry for each slot of the probability range: frequency (12 bits),
+// slot - symbol start (12 bits), symbol (8 bits)
+static bool BuildDecodeTable(const uint32_t freqs[256], uint32_t table[kRansProbScale])
+{
+	uint32_t start = 0;
+	for (uint32_t s = 0; s < 256; ++s)
+	{
+		const uint32_t freq = freqs[s];
+		if (freq == 0)
+			continue;
+		if (freq >= kRansProbScale || start + freq > kRansProbScale)
+			return false;
+		for (uint32_t i = 0; i < freq; ++i)
+			table[start + i] = freq | (i << 12) | (s << 24);
+		start += freq;
+	}
+	return start == kRansProbScale;
+}
+
+static inline uint32_t DecodeStep(uint32_t x, const uint32_t* table, uint8_t& outSym)
+{
+	const uint32_t e = table[x & (kRansProbScale - 1)];
+	outSym = uint8_t(e >> 24);
+	return (e & 0xFFF) * (x >> kRansProbBits) + ((e >> 12) & 0xFFF);
+}
+
+#if CPU_ARCH_X64
+// For each mask of lanes that need a renormalization word, shuffle that moves the next words
+// (in lane order) into the low 16 bits of those lanes
+struct RenormShuffles
+{
+	__m128i shuffles[16];
+	uint8_t counts[16];
+	RenormShuffles()
+	{
+		for (int mask = 0; mask < 16; ++mask)
+		{
+			alignas(16) int8_t bytes[16];
+			int k = 0;
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				const bool need = (mask >> lane) & 1;
+				bytes[lane * 4 + 0] = need ? int8_t(k * 2) : -1;
+				bytes[lane * 4 + 1] = need ? int8_t(k * 2 + 1) : -1;
+				bytes[lane * 4 + 2] = -1;
+				bytes[lane * 4 + 3] = -1;
+				k += need;
+			}
+			shuffles[mask] = _mm_load_si128((const __m128i*)bytes);
+			counts[mask] = uint8_t(k);
+		}
+	}
+};
+static const RenormShuffles s_RenormShuffles;
+
+static inline __m128i DecodeStep4(__m128i x, const uint32_t* table, __m128i& outSyms)
+{
+	const __m128i slots = _mm_and_si128(x, _mm_set1_epi32(kRansProbScale - 1));
+	const __m128i e = _mm_setr_epi32(table[_mm_extract_epi32(slots, 0)], table[_mm_extract_epi32(slots, 1)], table[_mm_extract_epi32(slots, 2)], table[_mm_extract_epi32(slots, 3)]);
+	const __m128i freq = _mm_and_si128(e, _mm_set1_epi32(0xFFF));
+	const __m128i bias = _mm_and_si128(_mm_srli_epi32(e, 12), _mm_set1_epi32(0xFFF));
+	outSyms = _mm_srli_epi32(e, 24);
+	return _mm_add_epi32(_mm_mullo_epi32(freq, _mm_srli_epi32(x, kRansProbBits)), bias);
+}
+
+static inline __m128i Renorm4(__m128i x, const uint16_t*& w)
+{
+	const __m128i need = _mm_cmpeq_epi32(_mm_srli_epi32(x, 16), _mm_setzero_si128());
+	const int mask = _mm_movemask_ps(_mm_castsi128_ps(need));
+	const __m128i words = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*)w), s_RenormShuffles.shuffles[mask]);
+	w += s_RenormShuffles.counts[mask];
+	return _mm_blendv_epi8(x, _mm_or_si128(_mm_slli_epi32(x, 16), words), need);
+}
+
+size_t Rans_DecodeSteps16(uint32_t states[kRansLanes], const uint16_t*& w, const uint16_t* wEnd, const uint32_t* table, uint8_t* dst, size_t size)
+{
+	// a step reads at most kRansLanes words; each group of 4 lanes reads (but may not use) 4 words
+	static_assert(kRansLanes % 16 == 0, "symbols are stored 16 at a time");
+	const int kGroups = kRansLanes / 4;
+	__m128i x[kGroups];
+	for (int g = 0; g < kGroups; ++g)
+		x[g] = _mm_loadu_si128((const __m128i*)(states + g * 4));
+	size_t i = 0;
+	for (; i + kRansLanes <= size && wEnd - w >= kRansLanes; i += kRansLanes)
+	{
+		__m128i syms[kGroups];
+		for (int g = 0; g < kGroups; ++g)
+			x[g] = DecodeStep4(x[g], table, syms[g]);
+		for (int g = 0; g < kGroups; ++g)
+			x[g] = Renorm4(x[g], w);
+		for (int g = 0; g < kGroups; g += 4)
+		{
+			const __m128i syms16a = _mm_packus_epi32(syms[g], syms[g + 1]);
+			const __m128i syms16b = _mm_packus_epi32(syms[g + 2], syms[g + 3]);
+			_mm_storeu_si128((__m128i*)(dst + i + g * 4), _mm_packus_epi16(syms16a, syms16b));
+		}
+	}
+	for (int g = 0; g < kGroups; ++g)
+		_mm_storeu_si128((__m128i*)(states + g * 4), x[g]);
+	return i;
+}
+#else
+size_t Rans_DecodeSteps16(uint32_t states[kRansLanes], const uint16_t*& w, const uint16_t* wEnd, const uint32_t* table, uint8_t* dst, size_t size)
+{
+	return 0;
+}
+#endif
+
+static bool DecompressRansChunk(const uint8_t* payload, size_t payloadSize, const uint32_t* table, uint8_t* dst, size_t size)
+{
+	uint32_t states[kRansLanes];
+	if (payloadSize < sizeof(states) || (payloadSize - sizeof(states)) % 2 != 0)
+		return false;
+	memcpy(states, payload, sizeof(states));
+	const uint16_t* w = (const uint16_t*)(payload + sizeof(states));
+	const uint16_t* wEnd = (const uint16_t*)(payload + payloadSize);
+
+	size_t i;
+	if (SysInfoGetSimdWidth() >= 32)
+		i = Rans_DecodeSteps32(states, w, wEnd, table, dst, size);
+	else
+		i = Rans_DecodeSteps16(states, w, wEnd, table, dst, size);
+	for (; i < size; ++i)
+	{
+		uint32_t& x = states[i % kRansLanes];
+		x = DecodeStep(x, table, dst[i]);
+		if (x < kRansL)
+		{
+			if (w >= wEnd)
+				return false;
+			x = (x << 16) | *w++;
+		}
+	}
+	// encoder started from these
+	for (uint32_t x : states)
+	{
+		if (x != kRansL)
+			return false;
+	}
+	return w == wEnd;
+}
+
+size_t RansDecompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+	const uint8_t* srcEnd = src + srcSize;
+	uint32_t table[kRansProbScale]; // 16KB, on the stack so that decoding does not allocate
+	for (size_t offset = 0; offset < dstSize; offset += kRansChunkSize)
+	{
+		const size_t size = std::min(kRansChunkSize, dstSize - offset);
+		if (src >= srcEnd)
+			return 0;
+		const uint8_t mode = *src++;
+		if (mode == kModeSingle)
+		{
+			if (src >= srcEnd)
+				return 0;
+			memset(dst + offset, *src++, size);
+		}
+		else if (mode == kModeStored)
+		{
+			if (size_t(srcEnd - src) < size)
+				return 0;
+			memcpy(dst + offset, src, size);
+			src += size;
+		}
+		else if (mode == kModeRans)
+		{
+			uint32_t freqs[256];
+			src = ReadFreqTable(src, srcEnd, freqs);
+			uint32_t payloadSize;
+			if (src == nullptr || size_t(srcEnd - src) < sizeof(payloadSize))
+				return 0;
+			memcpy(&payloadSize, src, sizeof(payloadSize));
+			src += sizeof(payloadSize);
+			if (size_t(srcEnd - src) < payloadSize || !BuildDecodeTable(freqs, table))
+				return 0;
+			if (!DecompressRansChunk(src, payloadSize, table, dst + offset, size))
+				return 0;
+			src += payloadSize;
+		}
+		else
+			return 0;
+	}
+	return src == srcEnd ? dstSize : 0;
+}
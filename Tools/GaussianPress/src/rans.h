@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Order-0 rANS entropy coder for bytes, for data that is mostly a skewed symbol
+// distribution without long matches (e.g. byte delta filter residuals).
+//
+// Data is split into kRansChunkSize chunks, each with its own static frequency table
+// (normalized to 12 bits). Each chunk is coded by kRansLanes interleaved 32-bit states
+// that share one stream of 16-bit renormalization words (Giesen, "Interleaved entropy
+// coders", 2014), so that the decoder can step all lanes with SIMD: 8 lanes at a time
+// with AVX2 (table lookups with gathers), 4 with SSE4.1, scalar elsewhere.
+
+const size_t kRansChunkSize = 16 * 1024;
+const int kRansLanes = 32;
+const int kRansProbBits = 12;
+const uint32_t kRansProbScale = 1 << kRansProbBits;
+const uint32_t kRansL = 1 << 16; // lower bound of normalized states; states are in [L, 2^32)
+
+size_t RansCompressBound(size_t srcSize);
+
+// Returns compressed size, or 0 if it does not fit into dstCapacity
+size_t RansCompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+
+// dstSize has to be the original data size; returns it, or 0 if the data is malformed
+size_t RansDecompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+// SIMD part of decoding one chunk, for specific SIMD widths: 16 bytes (SSE4.1; nothing elsewhere)
+// and 32 bytes (AVX2; see SysInfoGetSimdWidth). Decodes whole steps of kRansLanes symbols while
+// there are enough words left for any step, updating states and w; returns the count of symbols decoded.
+// table has an entry for each slot of the probability range: frequency (12 bits), slot - symbol
+// start (12 bits), symbol (8 bits).
+size_t Rans_DecodeSteps16(uint32_t states[kRansLanes], const uint16_t*& w, const uint16_t* wEnd, const uint32_t* table, uint8_t* dst, size_t size);
+size_t Rans_DecodeSteps32(uint32_t states[kRansLanes], const uint16_t*& w, const uint16_t* wEnd, const uint32_t* table, uint8_t* dst, size_t size);
@@ -0,0 +1,86 @@
+#include "rans.h"
+#include "simd.h"
+
+#if SIMD_HAS_BYTES32
+
+// For each mask of 8 lanes that need a renormalization word, permutation that moves the next words
+// (in lane order) into those lanes. Built at compile time, so that no AVX2 code runs at startup.
+struct RenormPerms
+{
+	alignas(32) uint32_t perms[256][8];
+	uint8_t counts[256];
+	constexpr RenormPerms() : perms(), counts()
+	{
+		for (int mask = 0; mask < 256; ++mask)
+		{
+			int k = 0;
+			for (int lane = 0; lane < 8; ++lane)
+			{
+				perms[mask][lane] = uint32_t(k & 7);
+				k += (mask >> lane) & 1;
+			}
+			counts[mask] = uint8_t(k);
+		}
+	}
+};
+static constexpr RenormPerms s_RenormPerms;
+
+static inline __m256i DecodeStep8(__m256i x, const uint32_t* table, __m256i& outSyms)
+{
+	const __m256i slots = _mm256_and_si256(x, _mm256_set1_epi32(kRansProbScale - 1));
+	const __m256i e = _mm256_i32gather_epi32((const int*)table, slots, 4);
+	const __m256i freq = _mm256_and_si256(e, _mm256_set1_epi32(0xFFF));
+	const __m256i bias = _mm256_and_si256(_mm256_srli_epi32(e, 12), _mm256_set1_epi32(0xFFF));
+	outSyms = _mm256_srli_epi32(e, 24);
+	return _mm256_add_epi32(_mm256_mullo_epi32(freq, _mm256_srli_epi32(x, kRansProbBits)), bias);
+}
+
+static inline __m256i Renorm8(__m256i x, const uint16_t*& w)
+{
+	const __m256i need = _mm256_cmpeq_epi32(_mm256_srli_epi32(x, 16), _mm256_setzero_si256());
+	const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(need));
+	const __m256i words = _mm256_permutevar8x32_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)w)), _mm256_load_si256((const __m256i*)s_RenormPerms.perms[mask]));
+	w += s_RenormPerms.counts[mask];
+	return _mm256_blendv_epi8(x, _mm256_or_si256(_mm256_slli_epi32(x, 16), words), need);
+}
+
+size_t Rans_DecodeSteps32(uint32_t states[kRansLanes], const uint16_t*& w, const uint16_t* wEnd, const uint32_t* table, uint8_t* dst, size_t size)
+{
+	// a step reads at most kRansLanes words; each group of 8 lanes reads (but may not use) 8 words.
+	// Independent gathers of all groups first, to hide their latency.
+	static_assert(kRansLanes % 32 == 0, "symbols are stored 32 at a time");
+	const int kGroups = kRansLanes / 8;
+	__m256i x[kGroups];
+	for (int g = 0; g < kGroups; ++g)
+		x[g] = _mm256_loadu_si256((const __m256i*)(states + g * 8));
+	// packs work within 128 bit lanes; puts the 32 bit quarters back in order
+	const __m256i unpermute = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	size_t i = 0;
+	for (; i + kRansLanes <= size && wEnd - w >= kRansLanes; i += kRansLanes)
+	{
+		__m256i syms[kGroups];
+		for (int g = 0; g < kGroups; ++g)
+			x[g] = DecodeStep8(x[g], table, syms[g]);
+		for (int g = 0; g < kGroups; ++g)
+			x[g] = Renorm8(x[g], w);
+		for (int g = 0; g < kGroups; g += 4)
+		{
+			const __m256i syms16a = _mm256_packus_epi32(syms[g], syms[g + 1]);
+			const __m256i syms16b = _mm256_packus_epi32(syms[g + 2], syms[g + 3]);
+			const __m256i syms8 = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(syms16a, syms16b), unpermute);
+			_mm256_storeu_si256((__m256i*)(dst + i + g * 8), syms8);
+		}
+	}
+	for (int g = 0; g < kGroups; ++g)
+		_mm256_storeu_si256((__m256i*)(states + g * 8), x[g]);
+	return i;
+}
+
+#else
+
+size_t Rans_DecodeSteps32(uint32_t states[kRansLanes], const uint16_t*& w, const uint16_t* wEnd, const uint32_t* table, uint8_t* dst, size_t size)
+{
+	return Rans_DecodeSteps16(states, w, wEnd, table, dst, size);
+}
+
+#endif // #if SIMD_HAS_BYTES32
@@ -0,0 +1,62 @@
+#include "scratch_arena.h"
+
+static uint8_t* AlignUp(uint8_t* ptr)
+{
+	return (uint8_t*)((uintptr_t(ptr) + ScratchArena::kAlignment - 1) & ~uintptr_t(ScratchArena::kAlignment - 1));
+}
+
+ScratchArena::~ScratchArena()
+{
+	Reset();
+	delete[] m_Memory;
+}
+
+void ScratchArena::Reserve(size_t size)
+{
+	Reset();
+	if (size <= m_Capacity)
+		return;
+	delete[] m_Memory;
+	m_Memory = new uint8_t[size + kAlignment - 1];
+	m_Data = AlignUp(m_Memory);
+	m_Capacity = size;
+}
+
+uint8_t* ScratchArena::Alloc(size_t size)
+{
+	size = ScratchArenaAllocSize(size);
+	if (m_Capacity - m_Used >= size)
+	{
+		uint8_t* res = m_Data + m_Used;
+		m_Used += size;
+		return res;
+	}
+	uint8_t* memory = new uint8_t[size + kAlignment - 1];
+	m_Overflow.push_back(memory);
+	m_OverflowSize += size;
+	return AlignUp(memory);
+}
+
+void ScratchArena::Reset()
+{
+	m_Used = 0;
+	if (m_Overflow.empty())
+		return;
+	for (uint8_t* memory : m_Overflow)
+		delete[] memory;
+	m_Overflow.clear();
+	const size_t size = m_Capacity + m_OverflowSize;
+	m_OverflowSize = 0;
+	Reserve(size);
+}
+
+void ScratchArenas::Prepare(int threadCount, size_t threadSize, size_t sharedSize)
+{
+	shared.Reserve(sharedSize);
+	while (m_Threads.size() < size_t(threadCount))
+		m_Threads.emplace_back(std::make_unique<ScratchArena>());
+	for (auto& arena : m_Threads)
+		arena->Reset();
+	for (int i = 0; i < threadCount; ++i)
+		m_Threads[i]->Reserve(threadSize);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+// Bump allocator for scratch memory that is kept between uses. Reset frees everything
+// at once; once an arena has grown to what a job needs, doing such a job again does
+// not touch the heap.
+//
+//   arena.Reset();
+//   uint8_t* buffer = arena.Alloc(blockSize);
+struct ScratchArena
+{
+	ScratchArena() = default;
+	~ScratchArena();
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	// Frees everything, and makes sure size bytes (in any number of allocations, with
+	// their alignment padding) fit without growing
+	void Reserve(size_t size);
+	// 64 byte aligned. When it does not fit, gets separate memory that is valid until
+	// Reset, at which point the arena grows to hold all of it next time.
+	uint8_t* Alloc(size_t size);
+	void Reset();
+
+	size_t GetCapacity() const { return m_Capacity; }
+
+	static const size_t kAlignment = 64;
+
+private:
+	uint8_t* m_Memory = nullptr; // as allocated; m_Data is aligned
+	uint8_t* m_Data = nullptr;
+	size_t m_Capacity = 0;
+	size_t m_Used = 0;
+	std::vector<uint8_t*> m_Overflow;
+	size_t m_OverflowSize = 0;
+};
+
+// Arena of each ParallelFor thread (by threadIndex), plus a shared one for data that
+// lives for a whole call
+struct ScratchArenas
+{
+	ScratchArena shared;
+
+	// Resets all the arenas, and reserves threadSize in each of threadCount thread arenas
+	void Prepare(int threadCount, size_t threadSize, size_t sharedSize = 0);
+	ScratchArena& Get(int threadIndex) { return *m_Threads[threadIndex]; }
+
+private:
+	std::vector<std::unique_ptr<ScratchArena>> m_Threads;
+};
+
+// Size of a ScratchArena allocation including its alignment padding, for sizing Reserve
+inline size_t ScratchArenaAllocSize(size_t size)
+{
+	return (size + ScratchArena::kAlignment - 1) & ~(ScratchArena::kAlignment - 1);
+}
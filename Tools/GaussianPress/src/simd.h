@@ -1,5 +1,10 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
+
+// Note: all functions here are static, since some translation units are compiled with
+// wider instruction sets (AVX2, AVX-512); the linker must never pick those versions
+// of the functions for the regular code paths.
 
 #if defined(__x86_64__) || defined(_M_X64)
 #	define CPU_ARCH_X64 1
@@ -16,27 +21,27 @@
 
 #if CPU_ARCH_X64
 typedef __m128i Bytes16;
-inline Bytes16 SimdZero() { return _mm_setzero_si128(); }
-inline Bytes16 SimdSet1(uint8_t v) { return _mm_set1_epi8(v); }
-inline Bytes16 SimdLoad(const void* ptr) { return _mm_loadu_si128((const __m128i*)ptr); }
-inline Bytes16 SimdLoadA(const void* ptr) { return _mm_load_si128((const __m128i*)ptr); }
-inline void SimdStore(void* ptr, Bytes16 x) { _mm_storeu_si128((__m128i*)ptr, x); }
-inline void SimdStoreA(void* ptr, Bytes16 x) { _mm_store_si128((__m128i*)ptr, x); }
+static inline Bytes16 SimdZero() { return _mm_setzero_si128(); }
+static inline Bytes16 SimdSet1(uint8_t v) { return _mm_set1_epi8(v); }
+static inline Bytes16 SimdLoad(const void* ptr) { return _mm_loadu_si128((const __m128i*)ptr); }
+static inline Bytes16 SimdLoadA(const void* ptr) { return _mm_load_si128((const __m128i*)ptr); }
+static inline void SimdStore(void* ptr, Bytes16 x) { _mm_storeu_si128((__m128i*)ptr, x); }
+static inline void SimdStoreA(void* ptr, Bytes16 x) { _mm_store_si128((__m128i*)ptr, x); }
 
-template<int lane> inline uint8_t SimdGetLane(Bytes16 x) { return _mm_extract_epi8(x, lane); }
-template<int lane> inline Bytes16 SimdSetLane(Bytes16 x, uint8_t v) { return _mm_insert_epi8(x, v, lane); }
-template<int index> inline Bytes16 SimdConcat(Bytes16 hi, Bytes16 lo) { return _mm_alignr_epi8(hi, lo, index); }
+template<int lane> static inline uint8_t SimdGetLane(Bytes16 x) { return _mm_extract_epi8(x, lane); }
+template<int lane> static inline Bytes16 SimdSetLane(Bytes16 x, uint8_t v) { return _mm_insert_epi8(x, v, lane); }
+template<int index> static inline Bytes16 SimdConcat(Bytes16 hi, Bytes16 lo) { return _mm_alignr_epi8(hi, lo, index); }
 
-inline Bytes16 SimdAdd(Bytes16 a, Bytes16 b) { return _mm_add_epi8(a, b); }
-inline Bytes16 SimdSub(Bytes16 a, Bytes16 b) { return _mm_sub_epi8(a, b); }
+static inline Bytes16 SimdAdd(Bytes16 a, Bytes16 b) { return _mm_add_epi8(a, b); }
+static inline Bytes16 SimdSub(Bytes16 a, Bytes16 b) { return _mm_sub_epi8(a, b); }
 
-inline Bytes16 SimdShuffle(Bytes16 x, Bytes16 table) { return _mm_shuffle_epi8(x, table); }
-inline Bytes16 SimdInterleaveL(Bytes16 a, Bytes16 b) { return _mm_unpacklo_epi8(a, b); }
-inline Bytes16 SimdInterleaveR(Bytes16 a, Bytes16 b) { return _mm_unpackhi_epi8(a, b); }
-inline Bytes16 SimdInterleave4L(Bytes16 a, Bytes16 b) { return _mm_unpacklo_epi32(a, b); }
-inline Bytes16 SimdInterleave4R(Bytes16 a, Bytes16 b) { return _mm_unpackhi_epi32(a, b); }
+static inline Bytes16 SimdShuffle(Bytes16 x, Bytes16 table) { return _mm_shuffle_epi8(x, table); }
+static inline Bytes16 SimdInterleaveL(Bytes16 a, Bytes16 b) { return _mm_unpacklo_epi8(a, b); }
+static inline Bytes16 SimdInterleaveR(Bytes16 a, Bytes16 b) { return _mm_unpackhi_epi8(a, b); }
+static inline Bytes16 SimdInterleave4L(Bytes16 a, Bytes16 b) { return _mm_unpacklo_epi32(a, b); }
+static inline Bytes16 SimdInterleave4R(Bytes16 a, Bytes16 b) { return _mm_unpackhi_epi32(a, b); }
 
-inline Bytes16 SimdPrefixSum(Bytes16 x)
+static inline Bytes16 SimdPrefixSum(Bytes16 x)
 {
     // Sklansky-style sum from https://gist.github.com/rygorous/4212be0cd009584e4184e641ca210528
     x = _mm_add_epi8(x, _mm_slli_epi64(x, 8));
@@ -46,30 +51,80 @@ inline Bytes16 SimdPrefixSum(Bytes16 x)
     return x;
 }
 
+static inline Bytes16 SimdConcatLast(Bytes16 hi, Bytes16 lo) { return SimdConcat<15>(hi, lo); }
+static inline Bytes16 SimdBroadcastLast(Bytes16 x) { return _mm_shuffle_epi8(x, _mm_set1_epi8(15)); }
+
+static inline void SimdPrefetch(const void* ptr) { _mm_prefetch((const char*)ptr, _MM_HINT_T0); }
+
+static inline Bytes16 SimdXor(Bytes16 a, Bytes16 b) { return _mm_xor_si128(a, b); }
+static inline Bytes16 SimdPrefixXor(Bytes16 x)
+{
+    x = _mm_xor_si128(x, _mm_slli_si128(x, 1));
+    x = _mm_xor_si128(x, _mm_slli_si128(x, 2));
+    x = _mm_xor_si128(x, _mm_slli_si128(x, 4));
+    x = _mm_xor_si128(x, _mm_slli_si128(x, 8));
+    return x;
+}
+
+// 16-bit lanes
+static inline Bytes16 SimdAdd16(Bytes16 a, Bytes16 b) { return _mm_add_epi16(a, b); }
+static inline Bytes16 SimdSub16(Bytes16 a, Bytes16 b) { return _mm_sub_epi16(a, b); }
+static inline Bytes16 SimdPrefixSum16(Bytes16 x)
+{
+    x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+    x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+    return x;
+}
+static inline Bytes16 SimdBroadcastLast16(Bytes16 x) { return _mm_shuffle_epi8(x, _mm_set1_epi16(0x0F0E)); }
+// signed -> unsigned with small magnitudes staying small: 0, -1, 1, -2, 2, ... -> 0, 1, 2, 3, 4, ...
+static inline Bytes16 SimdZigZag16(Bytes16 x) { return _mm_xor_si128(_mm_slli_epi16(x, 1), _mm_srai_epi16(x, 15)); }
+static inline Bytes16 SimdUnZigZag16(Bytes16 x) { return _mm_xor_si128(_mm_srli_epi16(x, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(x, _mm_set1_epi16(1)))); }
+
+// Even bytes of a then b into even, odd bytes of a then b into odd (inverse of SimdInterleaveL/R)
+static inline void SimdDeinterleave(Bytes16 a, Bytes16 b, Bytes16& even, Bytes16& odd)
+{
+    const __m128i table = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    a = _mm_shuffle_epi8(a, table);
+    b = _mm_shuffle_epi8(b, table);
+    even = _mm_unpacklo_epi64(a, b);
+    odd = _mm_unpackhi_epi64(a, b);
+}
+
+// Given bit of each byte, as a 16 bit mask; and the inverse (just that bit set in each byte)
+static inline uint32_t SimdBitPlane(Bytes16 x, int bit) { return _mm_movemask_epi8(_mm_sll_epi16(x, _mm_cvtsi32_si128(7 - bit))); }
+static inline Bytes16 SimdFromBitPlane(uint32_t plane, int bit)
+{
+    const __m128i weights = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i v = _mm_shuffle_epi8(_mm_cvtsi32_si128(plane), _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1));
+    v = _mm_cmpeq_epi8(_mm_and_si128(v, weights), weights);
+    return _mm_and_si128(v, _mm_set1_epi8(char(1 << bit)));
+}
+
 #elif CPU_ARCH_ARM64
 typedef uint8x16_t Bytes16;
-inline Bytes16 SimdZero() { return vdupq_n_u8(0); }
-inline Bytes16 SimdSet1(uint8_t v) { return vdupq_n_u8(v); }
-inline Bytes16 SimdLoad(const void* ptr) { return vld1q_u8((const uint8_t*)ptr); }
-inline Bytes16 SimdLoadA(const void* ptr) { return vld1q_u8((const uint8_t*)ptr); }
-inline void SimdStore(void* ptr, Bytes16 x) { vst1q_u8((uint8_t*)ptr, x); }
-inline void SimdStoreA(void* ptr, Bytes16 x) { vst1q_u8((uint8_t*)ptr, x); }
+static inline Bytes16 SimdZero() { return vdupq_n_u8(0); }
+static inline Bytes16 SimdSet1(uint8_t v) { return vdupq_n_u8(v); }
+static inline Bytes16 SimdLoad(const void* ptr) { return vld1q_u8((const uint8_t*)ptr); }
+static inline Bytes16 SimdLoadA(const void* ptr) { return vld1q_u8((const uint8_t*)ptr); }
+static inline void SimdStore(void* ptr, Bytes16 x) { vst1q_u8((uint8_t*)ptr, x); }
+static inline void SimdStoreA(void* ptr, Bytes16 x) { vst1q_u8((uint8_t*)ptr, x); }
 
-template<int lane> inline uint8_t SimdGetLane(Bytes16 x) { return vgetq_lane_u8(x, lane); }
-template<int lane> inline Bytes16 SimdSetLane(Bytes16 x, uint8_t v) { return vsetq_lane_u8(v, x, lane); }
-template<int index> inline Bytes16 SimdConcat(Bytes16 hi, Bytes16 lo) { return vextq_u8(lo, hi, index); }
+template<int lane> static inline uint8_t SimdGetLane(Bytes16 x) { return vgetq_lane_u8(x, lane); }
+template<int lane> static inline Bytes16 SimdSetLane(Bytes16 x, uint8_t v) { return vsetq_lane_u8(v, x, lane); }
+template<int index> static inline Bytes16 SimdConcat(Bytes16 hi, Bytes16 lo) { return vextq_u8(lo, hi, index); }
 
-inline Bytes16 SimdAdd(Bytes16 a, Bytes16 b) { return vaddq_u8(a, b); }
-inline Bytes16 SimdSub(Bytes16 a, Bytes16 b) { return vsubq_u8(a, b); }
+static inline Bytes16 SimdAdd(Bytes16 a, Bytes16 b) { return vaddq_u8(a, b); }
+static inline Bytes16 SimdSub(Bytes16 a, Bytes16 b) { return vsubq_u8(a, b); }
 
-inline Bytes16 SimdShuffle(Bytes16 x, Bytes16 table) { return vqtbl1q_u8(x, table); }
-inline Bytes16 SimdInterleaveL(Bytes16 a, Bytes16 b) { return vzip1q_u8(a, b); }
-inline Bytes16 SimdInterleaveR(Bytes16 a, Bytes16 b) { return vzip2q_u8(a, b); }
-inline Bytes16 SimdInterleave4L(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u32(vzip1q_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b))); }
-inline Bytes16 SimdInterleave4R(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u32(vzip2q_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b))); }
+static inline Bytes16 SimdShuffle(Bytes16 x, Bytes16 table) { return vqtbl1q_u8(x, table); }
+static inline Bytes16 SimdInterleaveL(Bytes16 a, Bytes16 b) { return vzip1q_u8(a, b); }
+static inline Bytes16 SimdInterleaveR(Bytes16 a, Bytes16 b) { return vzip2q_u8(a, b); }
+static inline Bytes16 SimdInterleave4L(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u32(vzip1q_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b))); }
+static inline Bytes16 SimdInterleave4R(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u32(vzip2q_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b))); }
 
 
-inline Bytes16 SimdPrefixSum(Bytes16 x)
+static inline Bytes16 SimdPrefixSum(Bytes16 x)
 {
     // Kogge-Stone-style like commented out part of https://gist.github.com/rygorous/4212be0cd009584e4184e641ca210528
     Bytes16 zero = vdupq_n_u8(0);
@@ -80,4 +135,190 @@ inline Bytes16 SimdPrefixSum(Bytes16 x)
     return x;
 }
 
+static inline Bytes16 SimdConcatLast(Bytes16 hi, Bytes16 lo) { return SimdConcat<15>(hi, lo); }
+static inline Bytes16 SimdBroadcastLast(Bytes16 x) { return vdupq_laneq_u8(x, 15); }
+
+#if defined(_MSC_VER) && !defined(__clang__)
+static inline void SimdPrefetch(const void* ptr) { __prefetch(ptr); }
+#else
+static inline void SimdPrefetch(const void* ptr) { __builtin_prefetch(ptr); }
+#endif
+
+static inline Bytes16 SimdXor(Bytes16 a, Bytes16 b) { return veorq_u8(a, b); }
+static inline Bytes16 SimdPrefixXor(Bytes16 x)
+{
+    Bytes16 zero = vdupq_n_u8(0);
+    x = veorq_u8(x, vextq_u8(zero, x, 16 - 1));
+    x = veorq_u8(x, vextq_u8(zero, x, 16 - 2));
+    x = veorq_u8(x, vextq_u8(zero, x, 16 - 4));
+    x = veorq_u8(x, vextq_u8(zero, x, 16 - 8));
+    return x;
+}
+
+// 16-bit lanes
+static inline Bytes16 SimdAdd16(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u16(vaddq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b))); }
+static inline Bytes16 SimdSub16(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u16(vsubq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b))); }
+static inline Bytes16 SimdPrefixSum16(Bytes16 x)
+{
+    Bytes16 zero = vdupq_n_u8(0);
+    x = SimdAdd16(x, vextq_u8(zero, x, 16 - 2));
+    x = SimdAdd16(x, vextq_u8(zero, x, 16 - 4));
+    x = SimdAdd16(x, vextq_u8(zero, x, 16 - 8));
+    return x;
+}
+static inline Bytes16 SimdBroadcastLast16(Bytes16 x) { return vreinterpretq_u8_u16(vdupq_laneq_u16(vreinterpretq_u16_u8(x), 7)); }
+// signed -> unsigned with small magnitudes staying small: 0, -1, 1, -2, 2, ... -> 0, 1, 2, 3, 4, ...
+static inline Bytes16 SimdZigZag16(Bytes16 x)
+{
+    int16x8_t v = vreinterpretq_s16_u8(x);
+    return vreinterpretq_u8_s16(veorq_s16(vshlq_n_s16(v, 1), vshrq_n_s16(v, 15)));
+}
+static inline Bytes16 SimdUnZigZag16(Bytes16 x)
+{
+    uint16x8_t v = vreinterpretq_u16_u8(x);
+    int16x8_t sign = vnegq_s16(vreinterpretq_s16_u16(vandq_u16(v, vdupq_n_u16(1))));
+    return vreinterpretq_u8_u16(veorq_u16(vshrq_n_u16(v, 1), vreinterpretq_u16_s16(sign)));
+}
+
+// Even bytes of a then b into even, odd bytes of a then b into odd (inverse of SimdInterleaveL/R)
+static inline void SimdDeinterleave(Bytes16 a, Bytes16 b, Bytes16& even, Bytes16& odd)
+{
+    even = vuzp1q_u8(a, b);
+    odd = vuzp2q_u8(a, b);
+}
+
+// Given bit of each byte, as a 16 bit mask; and the inverse (just that bit set in each byte)
+static inline uint32_t SimdBitPlane(Bytes16 x, int bit)
+{
+    const uint8x16_t weights = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t v = vandq_u8(vtstq_u8(x, vdupq_n_u8(uint8_t(1 << bit))), weights);
+    return vaddv_u8(vget_low_u8(v)) | (uint32_t(vaddv_u8(vget_high_u8(v))) << 8);
+}
+static inline Bytes16 SimdFromBitPlane(uint32_t plane, int bit)
+{
+    const uint8x16_t weights = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t v = vcombine_u8(vdup_n_u8(uint8_t(plane)), vdup_n_u8(uint8_t(plane >> 8)));
+    return vandq_u8(vtstq_u8(v, weights), vdupq_n_u8(uint8_t(1 << bit)));
+}
+
 #endif
+
+
+// Wider vectors: only available in translation units compiled with AVX2 / AVX-512 enabled.
+// Arithmetic, shuffles and interleaves work within each 16-byte lane (just like the
+// underlying instructions do); SimdConcatLast, SimdBroadcastLast and SimdPrefixSum
+// work across the whole vector. "Lanes" load/store functions gather/scatter each
+// 16-byte lane from/to memory laneStride bytes apart.
+#if CPU_ARCH_X64 && defined(__AVX2__)
+#	include <immintrin.h>
+#	define SIMD_HAS_BYTES32 1
+
+typedef __m256i Bytes32;
+static inline Bytes32 Simd32Zero() { return _mm256_setzero_si256(); }
+static inline Bytes32 Simd32Set1(uint8_t v) { return _mm256_set1_epi8(v); }
+static inline Bytes32 Simd32Load(const void* ptr) { return _mm256_loadu_si256((const __m256i*)ptr); }
+static inline Bytes32 Simd32LoadLanes(const void* ptr, size_t laneStride)
+{
+    const uint8_t* p = (const uint8_t*)ptr;
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)), _mm_loadu_si128((const __m128i*)(p + laneStride)), 1);
+}
+static inline void SimdStore(void* ptr, Bytes32 x) { _mm256_storeu_si256((__m256i*)ptr, x); }
+static inline void SimdStoreLanes(void* ptr, size_t laneStride, Bytes32 x)
+{
+    uint8_t* p = (uint8_t*)ptr;
+    _mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(x));
+    _mm_storeu_si128((__m128i*)(p + laneStride), _mm256_extracti128_si256(x, 1));
+}
+
+static inline Bytes32 SimdAdd(Bytes32 a, Bytes32 b) { return _mm256_add_epi8(a, b); }
+static inline Bytes32 SimdSub(Bytes32 a, Bytes32 b) { return _mm256_sub_epi8(a, b); }
+static inline Bytes32 SimdShuffle(Bytes32 x, Bytes32 table) { return _mm256_shuffle_epi8(x, table); }
+static inline Bytes32 SimdInterleaveL(Bytes32 a, Bytes32 b) { return _mm256_unpacklo_epi8(a, b); }
+static inline Bytes32 SimdInterleaveR(Bytes32 a, Bytes32 b) { return _mm256_unpackhi_epi8(a, b); }
+
+// last byte of lo, followed by first 31 bytes of hi
+static inline Bytes32 SimdConcatLast(Bytes32 hi, Bytes32 lo)
+{
+    return _mm256_alignr_epi8(hi, _mm256_permute2x128_si256(lo, hi, 0x21), 15);
+}
+static inline Bytes32 SimdBroadcastLast(Bytes32 x)
+{
+    Bytes32 t = _mm256_shuffle_epi8(x, _mm256_set1_epi8(15));
+    return _mm256_permute2x128_si256(t, t, 0x11);
+}
+static inline Bytes32 SimdPrefixSum(Bytes32 x)
+{
+    // same as the 16-wide one within each lane, then add low lane total to the high lane
+    x = _mm256_add_epi8(x, _mm256_slli_epi64(x, 8));
+    x = _mm256_add_epi8(x, _mm256_slli_epi64(x, 16));
+    x = _mm256_add_epi8(x, _mm256_slli_epi64(x, 32));
+    x = _mm256_add_epi8(x, _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+        -1,-1,-1,-1,-1,-1,-1,-1,7,7,7,7,7,7,7,7,
+        -1,-1,-1,-1,-1,-1,-1,-1,7,7,7,7,7,7,7,7)));
+    Bytes32 t = _mm256_shuffle_epi8(x, _mm256_set1_epi8(15));
+    x = _mm256_add_epi8(x, _mm256_permute2x128_si256(t, t, 0x08));
+    return x;
+}
+#endif // #if CPU_ARCH_X64 && defined(__AVX2__)
+
+
+#if CPU_ARCH_X64 && defined(__AVX512F__) && defined(__AVX512BW__)
+#	define SIMD_HAS_BYTES64 1
+
+typedef __m512i Bytes64;
+static inline Bytes64 Simd64Zero() { return _mm512_setzero_si512(); }
+static inline Bytes64 Simd64Set1(uint8_t v) { return _mm512_set1_epi8(v); }
+static inline Bytes64 Simd64Load(const void* ptr) { return _mm512_loadu_si512(ptr); }
+static inline Bytes64 Simd64LoadLanes(const void* ptr, size_t laneStride)
+{
+    const uint8_t* p = (const uint8_t*)ptr;
+    Bytes64 x = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)p));
+    x = _mm512_inserti32x4(x, _mm_loadu_si128((const __m128i*)(p + laneStride)), 1);
+    x = _mm512_inserti32x4(x, _mm_loadu_si128((const __m128i*)(p + laneStride * 2)), 2);
+    x = _mm512_inserti32x4(x, _mm_loadu_si128((const __m128i*)(p + laneStride * 3)), 3);
+    return x;
+}
+static inline void SimdStore(void* ptr, Bytes64 x) { _mm512_storeu_si512(ptr, x); }
+static inline void SimdStoreLanes(void* ptr, size_t laneStride, Bytes64 x)
+{
+    uint8_t* p = (uint8_t*)ptr;
+    _mm_storeu_si128((__m128i*)p, _mm512_castsi512_si128(x));
+    _mm_storeu_si128((__m128i*)(p + laneStride), _mm512_extracti32x4_epi32(x, 1));
+    _mm_storeu_si128((__m128i*)(p + laneStride * 2), _mm512_extracti32x4_epi32(x, 2));
+    _mm_storeu_si128((__m128i*)(p + laneStride * 3), _mm512_extracti32x4_epi32(x, 3));
+}
+
+static inline Bytes64 SimdAdd(Bytes64 a, Bytes64 b) { return _mm512_add_epi8(a, b); }
+static inline Bytes64 SimdSub(Bytes64 a, Bytes64 b) { return _mm512_sub_epi8(a, b); }
+static inline Bytes64 SimdShuffle(Bytes64 x, Bytes64 table) { return _mm512_shuffle_epi8(x, table); }
+static inline Bytes64 SimdInterleaveL(Bytes64 a, Bytes64 b) { return _mm512_unpacklo_epi8(a, b); }
+static inline Bytes64 SimdInterleaveR(Bytes64 a, Bytes64 b) { return _mm512_unpackhi_epi8(a, b); }
+
+// last byte of lo, followed by first 63 bytes of hi
+static inline Bytes64 SimdConcatLast(Bytes64 hi, Bytes64 lo)
+{
+    // lanes: lo.3, hi.0, hi.1, hi.2
+    return _mm512_alignr_epi8(hi, _mm512_alignr_epi64(hi, lo, 6), 15);
+}
+static inline Bytes64 SimdBroadcastLast(Bytes64 x)
+{
+    Bytes64 t = _mm512_shuffle_epi8(x, _mm512_set1_epi8(15));
+    return _mm512_shuffle_i64x2(t, t, 0xFF);
+}
+static inline Bytes64 SimdPrefixSum(Bytes64 x)
+{
+    // same as the 16-wide one within each lane, then add up totals of preceding lanes
+    x = _mm512_add_epi8(x, _mm512_slli_epi64(x, 8));
+    x = _mm512_add_epi8(x, _mm512_slli_epi64(x, 16));
+    x = _mm512_add_epi8(x, _mm512_slli_epi64(x, 32));
+    const Bytes64 hi8 = _mm512_broadcast_i32x4(_mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,7,7,7,7,7,7,7,7));
+    x = _mm512_add_epi8(x, _mm512_shuffle_epi8(x, hi8));
+    const Bytes64 zero = _mm512_setzero_si512();
+    Bytes64 t = _mm512_shuffle_epi8(x, _mm512_set1_epi8(15)); // lane totals: t0, t1, t2, t3
+    Bytes64 s = _mm512_alignr_epi64(t, zero, 6); // 0, t0, t1, t2
+    x = _mm512_add_epi8(x, s);
+    t = _mm512_add_epi8(t, s); // t0, t0+t1, t1+t2, t2+t3
+    x = _mm512_add_epi8(x, _mm512_alignr_epi64(t, zero, 4)); // 0, 0, t0, t0+t1
+    return x;
+}
+#endif // #if CPU_ARCH_X64 && defined(__AVX512F__) && defined(__AVX512BW__)
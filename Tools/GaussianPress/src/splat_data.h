@@ -0,0 +1,158 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "ply_reader.h"
+
+// Splats as they go through the benchmark: PLY vertices become FullVertex, which get quantized
+// into packed records (see PackLayout); TestFile holds a scene and its data in whichever stage.
+
+struct FullVertex
+{
+	float px, py, pz;
+	float nx, ny, nz;
+	float dcr, dcg, dcb;
+	float shr[15];
+	float shg[15];
+	float shb[15];
+	float opacity;
+	float sx, sy, sz;
+	float rw, rx, ry, rz;
+};
+constexpr size_t kFullVertexStride = 248;
+constexpr size_t kFullVertexFloats = kFullVertexStride / 4;
+static_assert(sizeof(FullVertex) == kFullVertexStride);
+
+// Where each FullVertex float comes from in the PLY vertex data
+struct PlyVertexLayout
+{
+	int shDegree = 0;
+	bool isFullVertex = false; // PLY vertex is exactly FullVertex, can be copied as is
+	bool present[kFullVertexFloats] = {}; // not present ones are zero
+	PlyPropertyType type[kFullVertexFloats] = {};
+	size_t offset[kFullVertexFloats] = {};
+};
+
+// Packed vertex record: bits for each FullVertex float, packed tightly in
+// FullVertex order (LSB first), then SH codebook index, smallest-three
+// rotation and meshopt quaternion rotation if used, record padded to whole bytes.
+// Floats that use meshopt exponential filter store their mantissa bits, with the
+// 8 bit exponent of their vector before the first one.
+constexpr size_t kPackRotSmallest3 = kFullVertexFloats; // PackLayout::bits index of smallest-three rotation bits
+constexpr size_t kPackShIndex = kFullVertexFloats + 1; // PackLayout::bits index of SH codebook index bits
+constexpr size_t kPackRotQuat = kFullVertexFloats + 2; // PackLayout::bits index of meshopt quaternion filter bits
+constexpr size_t kPackScaleExp = kFullVertexFloats + 3; // PackLayout::bits index of flag: scale uses meshopt exponential filter
+constexpr size_t kPackShExp = kFullVertexFloats + 4; // PackLayout::bits index of flag: SH coefficients use meshopt exponential filter
+constexpr size_t kPackAttributeCount = kFullVertexFloats + 5;
+struct PackLayout
+{
+	const char* name = nullptr;
+	uint8_t bits[kPackAttributeCount] = {};
+	size_t recordSize = 0;
+};
+
+constexpr int kFloatShStart = offsetof(FullVertex, shr) / sizeof(float);
+constexpr int kFloatScaleStart = offsetof(FullVertex, sx) / sizeof(float);
+
+// Start of the meshopt exponential filter vector that float j is in, or -1 if it does not use the filter
+inline int GetExpVectorStart(const PackLayout& layout, int j)
+{
+	if (layout.bits[kPackScaleExp] && j >= kFloatScaleStart && j < kFloatScaleStart + 3)
+		return kFloatScaleStart;
+	if (layout.bits[kPackShExp] && j >= kFloatShStart && j < kFloatShStart + 45)
+		return j - (j - kFloatShStart) % 15;
+	return -1;
+}
+
+// Sets recordSize from the bits
+inline void CalcPackRecordSize(PackLayout& layout)
+{
+	size_t totalBits = layout.bits[kPackShIndex];
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+	{
+		totalBits += layout.bits[j];
+		if (layout.bits[j] && GetExpVectorStart(layout, j) == int(j))
+			totalBits += 8;
+	}
+	if (layout.bits[kPackRotSmallest3])
+		totalBits += 2 + layout.bits[kPackRotSmallest3] * 3;
+	if (layout.bits[kPackRotQuat])
+		totalBits += 2 + layout.bits[kPackRotQuat] * 3;
+	layout.recordSize = (totalBits + 7) / 8;
+}
+
+// Bit fields of packed records, LSB first; acc holds accBits bits that are not written/read yet
+inline void WriteBits(uint32_t value, int bits, uint64_t& acc, int& accBits, uint8_t*& dst)
+{
+	acc |= uint64_t(value) << accBits;
+	accBits += bits;
+	while (accBits >= 8)
+	{
+		*dst++ = uint8_t(acc);
+		acc >>= 8;
+		accBits -= 8;
+	}
+}
+
+inline uint32_t ReadBits(int bits, uint64_t& acc, int& accBits, const uint8_t*& src)
+{
+	while (accBits < bits)
+	{
+		acc |= uint64_t(*src++) << accBits;
+		accBits += 8;
+	}
+	uint32_t value = uint32_t(acc & ((1u << bits) - 1));
+	acc >>= bits;
+	accBits -= bits;
+	return value;
+}
+
+// SH vector quantization codebook; each entry has coeffCount coefficients of R, then G, then B
+struct ShCodebook
+{
+	size_t coeffCount = 0;
+	std::vector<float> entries;
+
+	size_t GetDim() const { return coeffCount * 3; }
+	size_t GetSize() const { return coeffCount ? entries.size() / GetDim() : 0; }
+};
+
+// Codebook entries in memory that is not owned, e.g. of a parsed container
+struct ShCodebookView
+{
+	const float* entries = nullptr;
+	size_t size = 0;
+	size_t coeffCount = 0;
+
+	ShCodebookView() = default;
+	ShCodebookView(const float* entries_, size_t size_, size_t coeffCount_) : entries(entries_), size(size_), coeffCount(coeffCount_) {}
+	ShCodebookView(const ShCodebook& cb) : entries(cb.entries.data()), size(cb.GetSize()), coeffCount(cb.coeffCount) {}
+};
+
+struct TestFile
+{
+	const char* title = nullptr;
+	const char* path = nullptr;
+	PlyFile ply;
+	PlyVertexLayout plyLayout;
+	std::vector<uint32_t> order; // spatial order of PLY vertices, when streaming
+	bool streaming = false; // PLY file is not mapped; vertices are read into fixed size buffers
+	size_t streamPeakMemory = 0; // resident memory while streaming blocks, sampled after each batch
+	std::vector<uint8_t> origFileData;
+	std::vector<uint8_t> fileData;
+	size_t vertexCount = 0;
+	size_t vertexStride = 0;
+
+	FullVertex valMin;
+	FullVertex valMax;
+	PackLayout packLayout; // of packed data
+	ShCodebook shCodebook; // when packed data uses SH codebook
+	size_t quantChunkSize = 0; // when not zero, chunkMin/chunkMax has bounds for each chunk of this many vertices
+	std::vector<FullVertex> chunkMin;
+	std::vector<FullVertex> chunkMax;
+	FullVertex errMax;
+	FullVertex errAvg;
+	float approxErrOpacity = 0; // SIMD exp/log approximation part of the error, see UnlinearizeData
+	float approxErrScale = 0;
+};
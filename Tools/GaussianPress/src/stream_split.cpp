@@ -0,0 +1,438 @@
+#include "stream_split.h"
+#include "compressor_config.h"
+#include "parallel.h"
+#include "trace.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include "../libs/sokol_time.h"
+
+static const char* kPackStreamNames[] = { "pos", "nrm", "col", "sh", "opa", "scl", "rot" };
+static_assert(std::size(kPackStreamNames) == kStreamCount);
+
+// Stream each PackLayout attribute goes into in stream-split mode
+static PackStream GetPackStream(size_t attribute)
+{
+	if (attribute == kPackShIndex || attribute == kPackShExp)
+		return kStreamSh;
+	if (attribute == kPackScaleExp)
+		return kStreamScale;
+	if (attribute == kPackRotSmallest3 || attribute == kPackRotQuat)
+		return kStreamRotation;
+	const size_t offset = attribute * sizeof(float);
+	if (offset < offsetof(FullVertex, nx)) return kStreamPosition;
+	if (offset < offsetof(FullVertex, dcr)) return kStreamNormal;
+	if (offset < offsetof(FullVertex, shr)) return kStreamColor;
+	if (offset < offsetof(FullVertex, opacity)) return kStreamSh;
+	if (offset < offsetof(FullVertex, sx)) return kStreamOpacity;
+	if (offset < offsetof(FullVertex, rw)) return kStreamScale;
+	return kStreamRotation;
+}
+
+PackLayout BuildReducedLayout(const PackLayout& layout, uint32_t streamMask)
+{
+	PackLayout res = layout;
+	for (size_t j = 0; j < kPackAttributeCount; ++j)
+	{
+		if (!(streamMask & (1u << GetPackStream(j))))
+			res.bits[j] = 0;
+	}
+	CalcPackRecordSize(res);
+	return res;
+}
+
+// Bit fields of a packed record in the order they are written (see PackData), and their streams
+struct PackField
+{
+	uint8_t stream;
+	uint8_t bits;
+};
+constexpr size_t kPackMaxFields = kPackAttributeCount + 10; // rotations are 4 fields each, plus 4 exponential filter exponents
+
+static size_t GetPackFields(const PackLayout& layout, PackField* fields)
+{
+	size_t count = 0;
+	for (size_t j = 0; j < kFullVertexFloats; ++j)
+	{
+		if (layout.bits[j] == 0)
+			continue;
+		if (GetExpVectorStart(layout, int(j)) == int(j))
+			fields[count++] = { uint8_t(GetPackStream(j)), 8 };
+		fields[count++] = { uint8_t(GetPackStream(j)), layout.bits[j] };
+	}
+	if (layout.bits[kPackShIndex] != 0)
+		fields[count++] = { kStreamSh, layout.bits[kPackShIndex] };
+	for (size_t rot : { kPackRotSmallest3, kPackRotQuat })
+	{
+		if (const uint8_t rotBits = layout.bits[rot])
+		{
+			fields[count++] = { kStreamRotation, 2 };
+			for (int i = 0; i < 3; ++i)
+				fields[count++] = { kStreamRotation, rotBits };
+		}
+	}
+	return count;
+}
+
+// Moves the bit fields of packed records [first, first+count) into records of their streams, each
+// laid out as BuildReducedLayout with just that stream. Streams that are null are skipped.
+static void SplitPackedStreams(const uint8_t* src, size_t first, size_t count, const PackLayout& layout, uint8_t* const streams[kStreamCount])
+{
+	PackField fields[kPackMaxFields];
+	const size_t fieldCount = GetPackFields(layout, fields);
+	size_t strides[kStreamCount];
+	for (int k = 0; k < kStreamCount; ++k)
+		strides[k] = BuildReducedLayout(layout, 1u << k).recordSize;
+	for (size_t i = first; i < first + count; ++i)
+	{
+		const uint8_t* s = src + i * layout.recordSize;
+		uint64_t acc = 0;
+		int accBits = 0;
+		uint8_t* d[kStreamCount];
+		uint64_t dstAcc[kStreamCount] = {};
+		int dstAccBits[kStreamCount] = {};
+		for (int k = 0; k < kStreamCount; ++k)
+			d[k] = streams[k] ? streams[k] + i * strides[k] : nullptr;
+		for (size_t f = 0; f < fieldCount; ++f)
+		{
+			const int k = fields[f].stream;
+			const uint32_t value = ReadBits(fields[f].bits, acc, accBits, s);
+			if (d[k])
+				WriteBits(value, fields[f].bits, dstAcc[k], dstAccBits[k], d[k]);
+		}
+		for (int k = 0; k < kStreamCount; ++k)
+		{
+			if (d[k] && dstAccBits[k] > 0)
+				*d[k] = uint8_t(dstAcc[k]);
+		}
+	}
+}
+
+// Inverse of SplitPackedStreams: records in dst are laid out as BuildReducedLayout of the streams
+// that are not null, i.e. attributes of null streams are left out (and decode as zero)
+static void MergePackedStreams(const uint8_t* const streams[kStreamCount], size_t first, size_t count, const PackLayout& layout, uint8_t* dst)
+{
+	PackField fields[kPackMaxFields];
+	const size_t fieldCount = GetPackFields(layout, fields);
+	size_t strides[kStreamCount];
+	uint32_t presentMask = 0;
+	for (int k = 0; k < kStreamCount; ++k)
+	{
+		strides[k] = BuildReducedLayout(layout, 1u << k).recordSize;
+		presentMask |= streams[k] ? (1u << k) : 0;
+	}
+	const size_t dstStride = BuildReducedLayout(layout, presentMask).recordSize;
+	for (size_t i = first; i < first + count; ++i)
+	{
+		uint8_t* d = dst + i * dstStride;
+		uint64_t acc = 0;
+		int accBits = 0;
+		const uint8_t* s[kStreamCount];
+		uint64_t srcAcc[kStreamCount] = {};
+		int srcAccBits[kStreamCount] = {};
+		for (int k = 0; k < kStreamCount; ++k)
+			s[k] = streams[k] ? streams[k] + i * strides[k] : nullptr;
+		for (size_t f = 0; f < fieldCount; ++f)
+		{
+			const int k = fields[f].stream;
+			if (s[k])
+				WriteBits(ReadBits(fields[f].bits, srcAcc[k], srcAccBits[k], s[k]), fields[f].bits, acc, accBits, d);
+		}
+		if (accBits > 0)
+			*d = uint8_t(acc);
+	}
+}
+
+// Candidate & level that compress a sample of the data (a few runs of items spread over it) smallest
+static const CompressorConfig& SelectStreamCandidate(const std::vector<CompressorConfig>& candidates, const uint8_t* data, size_t elemCount, size_t elemStride, int& outLevel)
+{
+	TraceZone zone("SelectStreamCandidate");
+	const size_t kSampleBytes = 1024 * 1024;
+	const size_t kSampleRuns = 4;
+	const size_t sampleElems = std::min(elemCount, std::max<size_t>(kSampleBytes / elemStride, 1));
+	std::vector<uint8_t> sample(sampleElems * elemStride);
+	GatherSampleRuns(data, elemCount, elemStride, sampleElems, kSampleRuns, sample.data());
+
+	std::vector<uint8_t> filterBuffer(sample.size());
+	const CompressorConfig* best = &candidates[0];
+	size_t bestSize = SIZE_MAX;
+	outLevel = 0;
+	for (const CompressorConfig& candidate : candidates)
+	{
+		for (int level : candidate.GetLevels())
+		{
+			size_t size = 0;
+			ContainerBlock block;
+			delete[] candidate.CompressBlock(level, sample.data(), sampleElems, elemStride, filterBuffer.data(), size, block);
+			if (size < bestSize)
+			{
+				best = &candidate;
+				bestSize = size;
+				outLevel = level;
+			}
+		}
+	}
+	return *best;
+}
+
+uint8_t* CompressorConfig::CompressStreams(const TestFile& tf, size_t& outCompressedSize) const
+{
+	TraceZone zone("CompressStreams", tf.title);
+	const PackLayout& layout = tf.packLayout;
+	assert(tf.vertexStride == layout.recordSize);
+	struct StreamData
+	{
+		PackStream kind = kStreamCount;
+		PackLayout layout;
+		std::vector<uint8_t> data;
+		CompressorConfig config = {};
+		int level = 0;
+		ContainerHeader header;
+		std::vector<ContainerBlock> blocks;
+		std::vector<uint8_t*> blockCmp;
+	};
+
+	// split the records; streams without any bits (e.g. normals) are left out
+	std::vector<StreamData> streams;
+	uint8_t* streamPtrs[kStreamCount] = {};
+	for (int k = 0; k < kStreamCount; ++k)
+	{
+		PackLayout streamLayout = BuildReducedLayout(layout, 1u << k);
+		if (streamLayout.recordSize == 0)
+			continue;
+		StreamData& stream = streams.emplace_back();
+		stream.kind = PackStream(k);
+		stream.layout = streamLayout;
+		stream.data.resize(tf.vertexCount * streamLayout.recordSize);
+		streamPtrs[k] = stream.data.data();
+	}
+	const size_t kChunkVerts = 16 * 1024;
+	const size_t chunkCount = (tf.vertexCount + kChunkVerts - 1) / kChunkVerts;
+	{
+		TraceZone splitZone("SplitStreams");
+		ParallelFor(threadCount, chunkCount, [&](size_t chunk, int)
+		{
+			const size_t start = chunk * kChunkVerts;
+			SplitPackedStreams(tf.fileData.data(), start, std::min(kChunkVerts, tf.vertexCount - start), layout, streamPtrs);
+		});
+	}
+
+	// pick codec for each stream, and set up its container
+	ParallelFor(threadCount, streams.size(), [&](size_t streamIndex, int)
+	{
+		StreamData& stream = streams[streamIndex];
+		const CompressorConfig& best = SelectStreamCandidate(streamCandidates, stream.data.data(), tf.vertexCount, stream.layout.recordSize, stream.level);
+		stream.config = { best.cmp, best.filter, blockSizeEnum, 1, {}, {} };
+	});
+	struct BlockJob
+	{
+		uint32_t stream;
+		uint32_t block;
+	};
+	std::vector<BlockJob> jobs;
+	for (size_t i = 0; i < streams.size(); ++i)
+	{
+		StreamData& stream = streams[i];
+		const size_t blockElems = stream.config.GetBlockElemCount(tf.vertexCount, stream.layout.recordSize);
+		stream.header = stream.config.MakeContainerHeader(stream.level, tf.vertexCount, stream.layout.recordSize, blockElems, tf.quantChunkSize);
+		if (stream.kind == kStreamSh)
+		{
+			stream.header.codebookCount = uint32_t(tf.shCodebook.GetSize());
+			stream.header.codebookDim = uint32_t(tf.shCodebook.GetDim());
+		}
+		stream.blocks.resize(stream.header.blockCount);
+		stream.blockCmp.resize(stream.header.blockCount);
+		for (uint32_t ib = 0; ib < stream.header.blockCount; ++ib)
+			jobs.push_back({ uint32_t(i), ib });
+	}
+
+	// filter & compress blocks of all streams
+	std::vector<std::vector<uint8_t>> filterBuffers(threadCount);
+	ParallelFor(threadCount, jobs.size(), [&](size_t jobIndex, int threadIndex)
+	{
+		StreamData& stream = streams[jobs[jobIndex].stream];
+		const size_t blockIndex = jobs[jobIndex].block;
+		const size_t stride = stream.layout.recordSize;
+		const size_t blockElems = stream.header.blockElemCount;
+		const size_t start = blockIndex * blockElems;
+		const size_t count = std::min(blockElems, tf.vertexCount - start);
+		std::vector<uint8_t>& filterBuffer = filterBuffers[threadIndex];
+		if (stream.config.filter && filterBuffer.size() < blockElems * stride)
+			filterBuffer.resize(blockElems * stride);
+		size_t cmpSize = 0;
+		stream.blockCmp[blockIndex] = stream.config.CompressBlock(stream.level, stream.data.data() + start * stride, count, stride, filterBuffer.data(), cmpSize, stream.blocks[blockIndex]);
+		stream.blocks[blockIndex].size = uint32_t(cmpSize);
+		stream.blocks[blockIndex].elemCount = uint32_t(count);
+	});
+
+	// stream containers go after the stream table, 8 byte aligned
+	ContainerStreamsHeader streamsHeader;
+	streamsHeader.streamCount = uint32_t(streams.size());
+	std::vector<ContainerStream> table(streams.size());
+	size_t cmpOffset = ContainerCalcStreamsPrefixSize(streamsHeader.streamCount);
+	for (size_t i = 0; i < streams.size(); ++i)
+	{
+		table[i].offset = cmpOffset;
+		table[i].size = CompressorConfig::LayoutContainerBlocks(streams[i].header, streams[i].blocks);
+		table[i].kind = streams[i].kind;
+		cmpOffset = (cmpOffset + table[i].size + 7) & ~size_t(7);
+	}
+	uint8_t* compressed = new uint8_t[cmpOffset];
+	ContainerWriteStreamsPrefix(compressed, streamsHeader, table.data());
+	const std::vector<uint8_t> noDictionary;
+	for (size_t i = 0; i < streams.size(); ++i)
+	{
+		const size_t end = table[i].offset + table[i].size;
+		memset(compressed + end, 0, (i + 1 < streams.size() ? table[i + 1].offset : cmpOffset) - end);
+		WriteContainer(compressed + table[i].offset, streams[i].header, tf, streams[i].layout, noDictionary, streams[i].blocks, streams[i].blockCmp);
+	}
+	outCompressedSize = cmpOffset;
+	return compressed;
+}
+
+size_t CompressorConfig::DecompressStreams(const TestFile& tf, const uint8_t* compressed, size_t compressedSize, uint32_t streamMask, uint8_t* dst, ScratchArenas& arenas) const
+{
+	TraceZone zone("DecompressStreams", tf.title);
+	ContainerStreamsInfo info;
+	if (!ContainerParseStreams(compressed, compressedSize, info))
+		return 0;
+	struct StreamData
+	{
+		ContainerInfo info;
+		std::unique_ptr<Compressor> cmp;
+		CompressorConfig config = {};
+		uint32_t kind = 0;
+		uint8_t* data = nullptr;
+	};
+
+	// set up decoding of just the requested streams; everything needed comes from their containers
+	std::vector<StreamData> streams;
+	streams.reserve(info.header.streamCount);
+	uint32_t presentMask = 0;
+	size_t dataSize = 0, scratchSize = 0;
+	for (uint32_t i = 0; i < info.header.streamCount; ++i)
+	{
+		const ContainerStream& entry = info.streams[i];
+		if (entry.kind < kStreamCount && !(streamMask & (1u << entry.kind)))
+			continue;
+		StreamData& stream = streams.emplace_back();
+		if (!ContainerParse(info.data + entry.offset, entry.size, stream.info))
+			return 0;
+		const ContainerHeader& header = stream.info.header;
+		const PackLayout expected = entry.kind < kStreamCount ? BuildReducedLayout(tf.packLayout, 1u << entry.kind) : PackLayout();
+		stream.cmp.reset(CreateCompressor(CompressorKind(header.codecKind), CompressionFormat(header.codecFormat)));
+		FilterDesc* filter = FindFilter(ContainerFilter(header.filter));
+		if (entry.kind >= kStreamCount || (presentMask & (1u << entry.kind)) || stream.cmp == nullptr || (filter == nullptr && header.filter != kContainerFilterNone) ||
+			header.elemCount != tf.vertexCount || header.elemStride != expected.recordSize || header.attributeCount != kPackAttributeCount ||
+			memcmp(stream.info.attributeBits, expected.bits, kPackAttributeCount) != 0 || !stream.cmp->SetDictionary(stream.info.dictionary, header.dictionarySize))
+		{
+			printf("ERROR: stream %u of %s has unsupported or mismatching data (kind %u, codec %i/%i filter %i, %llu items of %u bytes)\n", i, tf.title,
+				entry.kind, header.codecKind, header.codecFormat, header.filter, (unsigned long long)header.elemCount, header.elemStride);
+			return 0;
+		}
+		presentMask |= 1u << entry.kind;
+		stream.config = { stream.cmp.get(), filter, kBSizeNone, 1, {}, {} };
+		stream.kind = entry.kind;
+		dataSize += ScratchArenaAllocSize(tf.vertexCount * header.elemStride);
+		scratchSize = std::max(scratchSize, stream.config.CalcDecodeScratchSize(header));
+	}
+	const PackLayout dstLayout = BuildReducedLayout(tf.packLayout, presentMask);
+	if (dstLayout.recordSize != BuildReducedLayout(tf.packLayout, streamMask).recordSize)
+	{
+		printf("ERROR: %s is missing some of the requested streams\n", tf.title);
+		return 0;
+	}
+	arenas.Prepare(threadCount, scratchSize, dataSize);
+	const uint8_t* streamPtrs[kStreamCount] = {};
+	for (StreamData& stream : streams)
+	{
+		stream.data = arenas.shared.Alloc(tf.vertexCount * stream.info.header.elemStride);
+		streamPtrs[stream.kind] = stream.data;
+	}
+
+	// decompress blocks of all streams, then interleave the streams back into records
+	struct BlockJob
+	{
+		uint32_t stream;
+		uint32_t block;
+	};
+	std::vector<BlockJob> jobs;
+	for (size_t i = 0; i < streams.size(); ++i)
+	{
+		for (uint32_t ib = 0; ib < streams[i].info.header.blockCount; ++ib)
+			jobs.push_back({ uint32_t(i), ib });
+	}
+	std::atomic<bool> ok = true;
+	ParallelFor(threadCount, jobs.size(), [&](size_t jobIndex, int threadIndex)
+	{
+		StreamData& stream = streams[jobs[jobIndex].stream];
+		const ContainerHeader& header = stream.info.header;
+		const size_t blockIndex = jobs[jobIndex].block;
+		const size_t blockSize = size_t(header.blockElemCount) * header.elemStride;
+		if (!stream.config.DecompressContainerBlock(stream.info, blockIndex, arenas.Get(threadIndex), stream.data + blockIndex * blockSize))
+			ok = false;
+	});
+	if (!ok)
+	{
+		printf("ERROR: stream blocks of %s did not decompress to their size in the block table\n", tf.title);
+		return 0;
+	}
+	const size_t kChunkVerts = 16 * 1024;
+	const size_t chunkCount = (tf.vertexCount + kChunkVerts - 1) / kChunkVerts;
+	TraceZone mergeZone("MergeStreams");
+	ParallelFor(threadCount, chunkCount, [&](size_t chunk, int)
+	{
+		const size_t start = chunk * kChunkVerts;
+		MergePackedStreams(streamPtrs, start, std::min(kChunkVerts, tf.vertexCount - start), tf.packLayout, dst);
+	});
+	return dstLayout.recordSize;
+}
+
+void PrintStreamSummary(const CompressorConfig& config, const TestFile& tf, const uint8_t* compressed, size_t compressedSize, ScratchArenas& arenas)
+{
+	ContainerStreamsInfo info;
+	if (!ContainerParseStreams(compressed, compressedSize, info))
+		return;
+	printf("\n  %s streams:", tf.title);
+	for (uint32_t i = 0; i < info.header.streamCount; ++i)
+	{
+		const ContainerStream& entry = info.streams[i];
+		ContainerHeader header;
+		memcpy(&header, info.data + entry.offset, sizeof(header));
+		std::unique_ptr<Compressor> cmp(CreateCompressor(CompressorKind(header.codecKind), CompressionFormat(header.codecFormat)));
+		const FilterDesc* filter = FindFilter(ContainerFilter(header.filter));
+		char name[100] = "?";
+		if (cmp)
+			cmp->PrintName(sizeof(name), name);
+		printf(" %s %s%s_%i %.1fKB", entry.kind < kStreamCount ? kPackStreamNames[entry.kind] : "?", name, filter ? filter->name : "", header.level, entry.size / 1024.0);
+		// which filters the blocks picked
+		ContainerInfo streamInfo;
+		if (filter == &g_FilterAuto && ContainerParse(info.data + entry.offset, entry.size, streamInfo))
+		{
+			uint32_t counts[kContainerFilterCount] = {};
+			for (uint32_t b = 0; b < streamInfo.header.blockCount; ++b)
+				counts[streamInfo.blocks[b].filter]++;
+			const char* sep = " (";
+			for (int f = 0; f < kContainerFilterCount; ++f)
+			{
+				if (counts[f] == 0)
+					continue;
+				const FilterDesc* blockFilter = FindFilter(ContainerFilter(f));
+				printf("%s%s %u", sep, blockFilter ? blockFilter->name + 1 : "none", counts[f]);
+				sep = ", ";
+			}
+			printf(")");
+		}
+		printf(";");
+	}
+	std::vector<uint8_t> preview(tf.fileData.size());
+	uint64_t t0 = stm_now();
+	const size_t previewStride = config.DecompressStreams(tf, compressed, compressedSize, kStreamMaskAll & ~(1u << kStreamSh), preview.data(), arenas);
+	if (previewStride == 0)
+		return;
+	printf("\n  %s without SH: %zi bytes/splat, decoded in %.3fs\n", tf.title, previewStride, stm_sec(stm_since(t0)));
+}
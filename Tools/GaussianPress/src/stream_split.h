@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "splat_data.h"
+
+struct CompressorConfig;
+struct ScratchArenas;
+
+// Stream-split mode: packed records are split into attribute streams, which are compressed as separate
+// containers, each with whichever codec suits it best (see CompressorConfig::CompressStreams).
+
+// Attribute streams of stream-split data; stored in containers (ContainerStream::kind), do not renumber
+enum PackStream
+{
+	kStreamPosition = 0,
+	kStreamNormal,
+	kStreamColor,
+	kStreamSh, // SH coefficients or SH codebook index
+	kStreamOpacity,
+	kStreamScale,
+	kStreamRotation,
+	kStreamCount
+};
+const uint32_t kStreamMaskAll = (1u << kStreamCount) - 1;
+
+// Layout with just the attributes of streams in streamMask; the others are not stored
+PackLayout BuildReducedLayout(const PackLayout& layout, uint32_t streamMask);
+
+// Codec picked for each stream of stream-split data, and time to decode all but the SH streams
+// (e.g. for a preview)
+void PrintStreamSummary(const CompressorConfig& config, const TestFile& tf, const uint8_t* compressed, size_t compressedSize, ScratchArenas& arenas);
@@ -1,12 +1,29 @@
 ﻿#include "systeminfo.h"
 
+#include <stdio.h>
+#include <string.h>
+
 #ifdef _WIN32
 #include <intrin.h>
 #include <windows.h>
+#include <psapi.h>
 #endif
 #ifdef __APPLE__
+#include <mach/mach.h>
 #include <sys/sysctl.h>
 #endif
+#ifdef __linux__
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <set>
+#include <utility>
+#endif
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 static std::string TrimRight(std::string s)
 {
@@ -42,6 +59,29 @@ std::string SysInfoGetCpuName()
 	sysctlbyname("machdep.cpu.brand_string", &buffer, &bufferLen, NULL, 0);
 	return TrimRight(buffer);
 
+#	elif defined(__linux__)
+	// Linux: "model name" on x64; many ARM kernels only have "Hardware" (if anything)
+	std::string name;
+	if (FILE* f = fopen("/proc/cpuinfo", "rb"))
+	{
+		char line[1024];
+		while (fgets(line, sizeof(line), f))
+		{
+			const char* colon = strchr(line, ':');
+			if (colon == nullptr)
+				continue;
+			const bool isModel = strncmp(line, "model name", 10) == 0;
+			if (isModel || (name.empty() && strncmp(line, "Hardware", 8) == 0))
+			{
+				name = TrimRight(colon + 1 + strspn(colon + 1, " \t"));
+				if (isModel)
+					break;
+			}
+		}
+		fclose(f);
+	}
+	return name.empty() ? "Unknown CPU" : name;
+
 #	else
 #	error Unknown platform
 #	endif
@@ -100,11 +140,183 @@ std::string SysInfoGetCompilerName()
 #	else
 	return "MSVC Unknown";
 #	endif
+#elif defined __GNUC__
+	// GCC
+	char buf[256];
+	snprintf(buf, sizeof(buf), "GCC %i.%i", __GNUC__, __GNUC_MINOR__);
+	return buf;
 #else
 #	error Unknown compiler
 #endif
 }
 
+#if defined(__linux__)
+static size_t ReadSysFileSize(const char* path)
+{
+	size_t size = 0;
+	if (FILE* f = fopen(path, "rb"))
+	{
+		char buf[64] = {};
+		if (fgets(buf, sizeof(buf), f))
+		{
+			char* end = nullptr;
+			size = strtoull(buf, &end, 10);
+			if (*end == 'K')
+				size *= 1024;
+			else if (*end == 'M')
+				size *= 1024 * 1024;
+		}
+		fclose(f);
+	}
+	return size;
+}
+
+static std::string ReadSysFileString(const char* path)
+{
+	std::string res;
+	if (FILE* f = fopen(path, "rb"))
+	{
+		char buf[64] = {};
+		if (fgets(buf, sizeof(buf), f))
+			res = TrimRight(buf);
+		fclose(f);
+	}
+	return res;
+}
+#endif
+
+SysInfoCpuDetails SysInfoGetCpuDetails()
+{
+	SysInfoCpuDetails res;
+#	if defined(_WIN32)
+	// Windows:
+	DWORD size = 0;
+	GetLogicalProcessorInformation(nullptr, &size);
+	std::string buffer(size, 0);
+	SYSTEM_LOGICAL_PROCESSOR_INFORMATION* infos = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION*)buffer.data();
+	if (size != 0 && GetLogicalProcessorInformation(infos, &size))
+	{
+		for (size_t i = 0; i < size / sizeof(infos[0]); ++i)
+		{
+			const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& info = infos[i];
+			if (info.Relationship == RelationProcessorCore)
+			{
+				res.coreCount++;
+				for (ULONG_PTR mask = info.ProcessorMask; mask != 0; mask &= mask - 1)
+					res.threadCount++;
+			}
+			else if (info.Relationship == RelationCache)
+			{
+				const CACHE_DESCRIPTOR& cache = info.Cache;
+				if (cache.Level == 1 && cache.Type == CacheData && res.cacheL1D == 0)
+					res.cacheL1D = cache.Size;
+				else if (cache.Level == 2 && res.cacheL2 == 0)
+					res.cacheL2 = cache.Size;
+				else if (cache.Level == 3 && res.cacheL3 == 0)
+					res.cacheL3 = cache.Size;
+			}
+		}
+	}
+
+#	elif defined(__APPLE__)
+	// macOS:
+	auto getInt = [](const char* name) -> int64_t
+	{
+		int64_t value = 0;
+		size_t len = sizeof(value);
+		if (sysctlbyname(name, &value, &len, NULL, 0) != 0)
+			return 0;
+		return len == sizeof(int32_t) ? int64_t(int32_t(value)) : value;
+	};
+	res.coreCount = int(getInt("hw.physicalcpu"));
+	res.threadCount = int(getInt("hw.logicalcpu"));
+	res.cacheL1D = size_t(getInt("hw.l1dcachesize"));
+	res.cacheL2 = size_t(getInt("hw.l2cachesize"));
+	res.cacheL3 = size_t(getInt("hw.l3cachesize"));
+
+#	elif defined(__linux__)
+	// Linux: threads from sysconf, cores by unique package+core IDs, caches of CPU 0 from sysfs
+	res.threadCount = int(sysconf(_SC_NPROCESSORS_ONLN));
+	std::set<std::pair<std::string, std::string>> cores;
+	char path[256];
+	for (int cpu = 0; cpu < res.threadCount; ++cpu)
+	{
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%i/topology/physical_package_id", cpu);
+		std::string package = ReadSysFileString(path);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%i/topology/core_id", cpu);
+		std::string core = ReadSysFileString(path);
+		if (!core.empty())
+			cores.insert({ package, core });
+	}
+	res.coreCount = cores.empty() ? res.threadCount : int(cores.size());
+	for (int index = 0; ; ++index)
+	{
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%i/level", index);
+		std::string level = ReadSysFileString(path);
+		if (level.empty())
+			break;
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%i/type", index);
+		std::string type = ReadSysFileString(path);
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%i/size", index);
+		size_t size = ReadSysFileSize(path);
+		if (level == "1" && type == "Data")
+			res.cacheL1D = size;
+		else if (level == "2")
+			res.cacheL2 = size;
+		else if (level == "3")
+			res.cacheL3 = size;
+	}
+#	endif
+	return res;
+}
+
+#if defined(_M_X64) || defined(__x86_64__)
+#	if defined(_WIN32)
+// whether OS saves/restores the given XCR0 state components (e.g. 0x6 = XMM+YMM)
+static bool CpuOsSupportsState(uint64_t mask)
+{
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 1);
+	const bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+	return osxsave && ((_xgetbv(0) & mask) == mask);
+}
+#	endif
+
+bool SysInfoCpuHasAVX2()
+{
+#	if defined(_WIN32)
+	int cpuInfo[4];
+	__cpuidex(cpuInfo, 7, 0);
+	const bool avx2 = (cpuInfo[1] & (1 << 5)) != 0;
+	return avx2 && CpuOsSupportsState(0x6);
+#	else
+	return __builtin_cpu_supports("avx2");
+#	endif
+}
+
+bool SysInfoCpuHasAVX512()
+{
+#	if defined(_WIN32)
+	int cpuInfo[4];
+	__cpuidex(cpuInfo, 7, 0);
+	const bool avx512f = (cpuInfo[1] & (1 << 16)) != 0;
+	const bool avx512bw = (cpuInfo[1] & (1 << 30)) != 0;
+	return avx512f && avx512bw && CpuOsSupportsState(0xE6);
+#	else
+	return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#	endif
+}
+#else
+bool SysInfoCpuHasAVX2() { return false; }
+bool SysInfoCpuHasAVX512() { return false; }
+#endif
+
+int SysInfoGetSimdWidth()
+{
+	static const int width = SysInfoCpuHasAVX512() ? 64 : (SysInfoCpuHasAVX2() ? 32 : 16);
+	return width;
+}
+
 const size_t kCacheFlushDataSize = 128 * 1024 * 1024;
 static uint64_t s_CacheFlushArray[kCacheFlushDataSize / 8];
 static uint64_t s_CacheFlushScramble;
@@ -120,3 +332,136 @@ void SysInfoFlushCaches()
 	}
 	s_CacheFlushScramble = s_CacheFlushArray[kCacheFlushDataSize / 137];
 }
+
+size_t SysInfoGetPeakMemory()
+{
+#	if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters = {};
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+#	else
+	struct rusage usage = {};
+	getrusage(RUSAGE_SELF, &usage);
+#		if defined(__APPLE__)
+	return size_t(usage.ru_maxrss); // bytes on macOS
+#		else
+	return size_t(usage.ru_maxrss) * 1024; // kilobytes elsewhere
+#		endif
+#	endif
+}
+
+size_t SysInfoGetCurrentMemory()
+{
+#	if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters = {};
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.WorkingSetSize;
+#	elif defined(__APPLE__)
+	mach_task_basic_info_data_t info = {};
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+		return 0;
+	return size_t(info.resident_size);
+#	elif defined(__linux__)
+	// second value is resident pages
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f == nullptr)
+		return 0;
+	unsigned long long pages = 0, resident = 0;
+	const bool ok = fscanf(f, "%llu %llu", &pages, &resident) == 2;
+	fclose(f);
+	return ok ? size_t(resident) * size_t(sysconf(_SC_PAGESIZE)) : 0;
+#	else
+	return 0;
+#	endif
+}
+
+#if defined(__linux__)
+enum PerfCounterIndex
+{
+	kPerfCycles,
+	kPerfInstructions,
+	kPerfCacheMisses,
+	kPerfBranchMisses,
+	kPerfCount
+};
+// separate (not grouped) counters, since group reads do not work together with inherit
+static int s_PerfFds[kPerfCount] = { -1, -1, -1, -1 };
+// counts at start; counts of exited inherited threads stay in the value even after PERF_EVENT_IOC_RESET
+static uint64_t s_PerfStart[kPerfCount] = {};
+
+static uint64_t ReadPerfCounter(int fd)
+{
+	uint64_t count = 0;
+	if (read(fd, &count, sizeof(count)) != sizeof(count))
+		return 0;
+	return count;
+}
+
+bool SysInfoPerfCountersInit()
+{
+	if (s_PerfFds[0] >= 0)
+		return true;
+	static const uint64_t kConfigs[kPerfCount] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+	for (int i = 0; i < kPerfCount; ++i)
+	{
+		perf_event_attr attr = {};
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = kConfigs[i];
+		attr.disabled = 1;
+		attr.inherit = 1; // count threads started while counting too
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		s_PerfFds[i] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		if (s_PerfFds[i] < 0)
+		{
+			printf("WARN: perf counters not available (perf_event_open failed: %s); check /proc/sys/kernel/perf_event_paranoid\n", strerror(errno));
+			for (int j = 0; j < i; ++j)
+			{
+				close(s_PerfFds[j]);
+				s_PerfFds[j] = -1;
+			}
+			s_PerfFds[i] = -1;
+			return false;
+		}
+	}
+	return true;
+}
+
+void SysInfoPerfCountersStart()
+{
+	for (int i = 0; i < kPerfCount; ++i)
+	{
+		if (s_PerfFds[i] < 0)
+			return;
+		s_PerfStart[i] = ReadPerfCounter(s_PerfFds[i]);
+		ioctl(s_PerfFds[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+void SysInfoPerfCountersStop(SysInfoPerfCounters& values)
+{
+	uint64_t counts[kPerfCount] = {};
+	for (int i = 0; i < kPerfCount; ++i)
+	{
+		if (s_PerfFds[i] < 0)
+			return;
+		ioctl(s_PerfFds[i], PERF_EVENT_IOC_DISABLE, 0);
+		const uint64_t count = ReadPerfCounter(s_PerfFds[i]);
+		counts[i] = count > s_PerfStart[i] ? count - s_PerfStart[i] : 0;
+	}
+	values.cycles += counts[kPerfCycles];
+	values.instructions += counts[kPerfInstructions];
+	values.cacheMisses += counts[kPerfCacheMisses];
+	values.branchMisses += counts[kPerfBranchMisses];
+}
+#else
+bool SysInfoPerfCountersInit()
+{
+	printf("WARN: perf counters are only supported on Linux\n");
+	return false;
+}
+void SysInfoPerfCountersStart() {}
+void SysInfoPerfCountersStop(SysInfoPerfCounters& values) {}
+#endif
@@ -1,8 +1,48 @@
 ﻿#pragma once
 
+#include <stdint.h>
 #include <string>
 
 std::string SysInfoGetCpuName();
 std::string SysInfoGetCompilerName();
 
+// CPU core counts and cache sizes (of one core, in bytes); zero when not known
+struct SysInfoCpuDetails
+{
+	int coreCount = 0; // physical cores
+	int threadCount = 0; // hardware threads
+	size_t cacheL1D = 0;
+	size_t cacheL2 = 0;
+	size_t cacheL3 = 0;
+};
+SysInfoCpuDetails SysInfoGetCpuDetails();
+
+// x64 instruction set support (AVX-512 here means at least F and BW); always false on other CPUs
+bool SysInfoCpuHasAVX2();
+bool SysInfoCpuHasAVX512();
+// Widest SIMD vectors the CPU supports, in bytes: 64 (AVX-512), 32 (AVX2) or 16. The wider code paths
+// (in *_avx2.cpp, *_avx512.cpp files compiled for them) may only run when this is at least their width;
+// builds that do not compile them in at all have them fall back to the 16 byte ones.
+int SysInfoGetSimdWidth();
+
 void SysInfoFlushCaches();
+
+// Peak resident memory (working set) of the process so far, in bytes
+size_t SysInfoGetPeakMemory();
+// Resident memory (working set) of the process right now, in bytes; zero when not known
+size_t SysInfoGetCurrentMemory();
+
+// Hardware performance counters (Linux perf_event_open only). Counting covers the calling
+// thread and threads it starts while counting (when they exit before counting stops).
+struct SysInfoPerfCounters
+{
+	uint64_t cycles = 0;
+	uint64_t instructions = 0;
+	uint64_t cacheMisses = 0;
+	uint64_t branchMisses = 0;
+};
+// Opens the counters; false (with a message) when the platform or permissions do not allow it
+bool SysInfoPerfCountersInit();
+void SysInfoPerfCountersStart();
+// Adds counts since the last start to values
+void SysInfoPerfCountersStop(SysInfoPerfCounters& values);
@@ -0,0 +1,137 @@
+#include "trace.h"
+#include "../libs/sokol_time.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+bool g_TraceEnabled = false;
+
+struct TraceEvent
+{
+	const char* name;
+	std::string detail;
+	uint64_t start;
+	uint64_t end;
+};
+
+// Buffers live until the end, even after their thread is gone; worker threads only
+// live for one ParallelFor call
+struct TraceThreadBuffer
+{
+	int threadIndex = 0;
+	std::vector<TraceEvent> events;
+};
+
+static std::mutex s_BuffersMutex;
+static std::vector<std::unique_ptr<TraceThreadBuffer>> s_Buffers;
+static thread_local TraceThreadBuffer* t_Buffer = nullptr;
+static thread_local int t_ThreadIndex = 0;
+static uint64_t s_StartTicks = 0;
+
+void TraceSetEnabled(bool enabled)
+{
+	if (enabled && s_StartTicks == 0)
+		s_StartTicks = stm_now();
+	g_TraceEnabled = enabled;
+}
+
+void TraceSetThreadIndex(int index)
+{
+	t_ThreadIndex = index;
+	if (t_Buffer)
+		t_Buffer->threadIndex = index;
+}
+
+uint64_t TraceNow()
+{
+	return stm_now();
+}
+
+void TraceAddZone(const char* name, const char* detail, uint64_t startTicks)
+{
+	const uint64_t endTicks = stm_now();
+	if (t_Buffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(s_BuffersMutex);
+		s_Buffers.emplace_back(std::make_unique<TraceThreadBuffer>());
+		t_Buffer = s_Buffers.back().get();
+		t_Buffer->threadIndex = t_ThreadIndex;
+	}
+	t_Buffer->events.push_back({ name, detail ? detail : "", startTicks, endTicks });
+}
+
+static void WriteJsonString(FILE* f, const char* str)
+{
+	fputc('"', f);
+	for (; *str; ++str)
+	{
+		const char c = *str;
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if ((unsigned char)c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+bool TraceWriteJson(const char* path)
+{
+	FILE* f = fopen(path, "wb");
+	if (f == nullptr)
+	{
+		printf("ERROR: failed to write trace to %s\n", path);
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(s_BuffersMutex);
+
+	// thread names first; complete ("X") events with microsecond times after
+	fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	fprintf(f, "{\"ph\": \"M\", \"pid\": 1, \"name\": \"process_name\", \"args\": {\"name\": \"GaussianPress\"}}");
+	int maxThreadIndex = 0;
+	for (const auto& buf : s_Buffers)
+		maxThreadIndex = std::max(maxThreadIndex, buf->threadIndex);
+	for (int i = 0; i <= maxThreadIndex; ++i)
+	{
+		char name[32];
+		if (i == 0)
+			snprintf(name, sizeof(name), "main");
+		else
+			snprintf(name, sizeof(name), "worker %i", i);
+		fprintf(f, ",\n{\"ph\": \"M\", \"pid\": 1, \"tid\": %i, \"name\": \"thread_name\", \"args\": {\"name\": \"%s\"}}", i, name);
+	}
+	size_t eventCount = 0;
+	for (const auto& buf : s_Buffers)
+	{
+		for (const TraceEvent& ev : buf->events)
+		{
+			const double ts = stm_us(stm_diff(ev.start, s_StartTicks));
+			const double dur = stm_us(stm_diff(ev.end, ev.start));
+			fprintf(f, ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": %i, \"ts\": %.3f, \"dur\": %.3f, \"name\": ", buf->threadIndex, ts, dur);
+			WriteJsonString(f, ev.name);
+			if (!ev.detail.empty())
+			{
+				fprintf(f, ", \"args\": {\"detail\": ");
+				WriteJsonString(f, ev.detail.c_str());
+				fputc('}', f);
+			}
+			fputc('}', f);
+			++eventCount;
+		}
+	}
+	fprintf(f, "\n]}\n");
+	const bool ok = ferror(f) == 0;
+	fclose(f);
+	if (!ok)
+	{
+		printf("ERROR: failed to write trace to %s\n", path);
+		return false;
+	}
+	printf("Trace with %zi zones written to %s\n", eventCount, path);
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+// Scoped zone instrumentation, written out as Chrome trace event JSON (open in
+// ui.perfetto.dev or chrome://tracing). Zones are only recorded while tracing is
+// enabled; otherwise creating one is a check of a global flag.
+//
+// Each thread records into its own buffer. Zones go into per thread rows in the
+// trace: "main" for the main thread, and "worker N" for ParallelFor thread N.
+//
+//   TraceZone zone("PackData", tf.title);
+//
+// Zone name is not copied and has to be a string literal; detail (optional) is
+// copied when the zone ends.
+
+extern bool g_TraceEnabled;
+
+void TraceSetEnabled(bool enabled);
+
+// Row that zones of the calling thread go into; 0 is the main thread
+void TraceSetThreadIndex(int index);
+
+uint64_t TraceNow();
+void TraceAddZone(const char* name, const char* detail, uint64_t startTicks);
+
+struct TraceZone
+{
+	TraceZone(const char* name, const char* detail = nullptr)
+	{
+		if (g_TraceEnabled)
+		{
+			m_Name = name;
+			m_Detail = detail;
+			m_Start = TraceNow();
+		}
+	}
+	~TraceZone()
+	{
+		if (m_Name)
+			TraceAddZone(m_Name, m_Detail, m_Start);
+	}
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+
+	const char* m_Name = nullptr;
+	const char* m_Detail = nullptr;
+	uint64_t m_Start = 0;
+};
+
+// Writes all zones recorded so far
+bool TraceWriteJson(const char* path);
@@ -0,0 +1,167 @@
+#include "tuner.h"
+#include "alloc_stats.h"
+#include "systeminfo.h"
+#include "trace.h"
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "../libs/sokol_time.h"
+
+void TuneCompressors(std::vector<CompressorConfig>& configs, const TuneSettings& settings, size_t testFileCount, TestFile* testFiles,
+	const char* orderName, const char* profileName, ScratchArenas& arenas, std::vector<BenchResult>& outResults)
+{
+	const int runs = settings.runs;
+	const size_t kSampleRuns = 8;
+	const double oneMB = 1024.0 * 1024.0;
+	const double oneGB = oneMB * 1024.0;
+	for (size_t tfi = 0; tfi < testFileCount; ++tfi)
+	{
+		const TestFile& tf = testFiles[tfi];
+		TraceZone zone("TuneCompressors", tf.title);
+
+		// sample has the same packing & bounds as the whole file
+		TestFile sample;
+		sample.title = tf.title;
+		sample.path = tf.path;
+		sample.plyLayout = tf.plyLayout;
+		sample.vertexCount = std::min(tf.vertexCount, std::max<size_t>(settings.sampleSize / tf.vertexStride, 1));
+		sample.vertexStride = tf.vertexStride;
+		sample.valMin = tf.valMin;
+		sample.valMax = tf.valMax;
+		sample.packLayout = tf.packLayout;
+		sample.shCodebook = tf.shCodebook;
+		sample.quantChunkSize = tf.quantChunkSize;
+		sample.chunkMin = tf.chunkMin;
+		sample.chunkMax = tf.chunkMax;
+		sample.fileData.resize(sample.vertexCount * sample.vertexStride);
+		GatherSampleRuns(tf.fileData.data(), tf.vertexCount, tf.vertexStride, sample.vertexCount, kSampleRuns, sample.fileData.data());
+		const double sampleSize = double(sample.fileData.size());
+		printf("Tuning %s on %.1fMB sample of %.1fMB, %zi configs:\n", tf.title, sampleSize / oneMB, tf.fileData.size() / oneMB, configs.size());
+
+		struct Point
+		{
+			const CompressorConfig* config = nullptr;
+			std::string name;
+			int level = 0;
+			size_t size = 0;
+			std::vector<double> cmpTimes;
+			std::vector<double> decTimes;
+			uint64_t decAllocs = 0; // sums over runs
+			uint64_t decAllocBytes = 0;
+			double decSpeed = 0;
+			bool pareto = false;
+		};
+		std::vector<Point> points;
+		std::vector<uint8_t> decompressed(sample.fileData.size());
+		for (CompressorConfig& config : configs)
+		{
+			const std::vector<int> levels = config.GetLevels();
+			for (int level : levels)
+			{
+				Point& pt = points.emplace_back();
+				pt.config = &config;
+				pt.name = GetConfigLevelName(config, levels.size(), level);
+				pt.level = level;
+				for (int ir = 0; ir < runs; ++ir)
+				{
+					SysInfoFlushCaches();
+					uint64_t t0 = stm_now();
+					size_t compressedSize = 0;
+					uint8_t* compressed = config.Compress(sample, level, compressedSize);
+					pt.cmpTimes.push_back(stm_sec(stm_since(t0)));
+
+					memset(decompressed.data(), 0, decompressed.size());
+					SysInfoFlushCaches();
+					const AllocStats alloc0 = AllocStatsGet();
+					t0 = stm_now();
+					if (!config.Decompress(sample, compressed, compressedSize, decompressed.data(), arenas))
+					{
+						printf("  ERROR, %s failed to decompress %s\n", pt.name.c_str(), tf.path);
+						exit(1);
+					}
+					pt.decTimes.push_back(stm_sec(stm_since(t0)));
+					const AllocStats alloc1 = AllocStatsGet();
+					pt.decAllocs += alloc1.count - alloc0.count;
+					pt.decAllocBytes += alloc1.bytes - alloc0.bytes;
+					if (memcmp(sample.fileData.data(), decompressed.data(), decompressed.size()) != 0)
+					{
+						printf("  ERROR, %s did not decompress back to input on %s\n", pt.name.c_str(), tf.path);
+						exit(1);
+					}
+					pt.size = compressedSize;
+					delete[] compressed;
+				}
+				const double decTime = BenchCalcStats(pt.decTimes).median;
+				pt.decSpeed = decTime > 0 ? sampleSize / decTime / oneGB : DBL_MAX;
+				printf(".");
+			}
+		}
+		printf("\n");
+
+		// frontier: no other config is at least as small and as fast, and better in one of them
+		for (Point& pt : points)
+		{
+			pt.pareto = std::none_of(points.begin(), points.end(), [&](const Point& o)
+			{
+				return o.size <= pt.size && o.decSpeed >= pt.decSpeed && (o.size < pt.size || o.decSpeed > pt.decSpeed);
+			});
+		}
+		const Point* chosen = nullptr;
+		for (const Point& pt : points)
+		{
+			if (pt.decSpeed >= settings.minDecodeSpeed && (chosen == nullptr || pt.size < chosen->size || (pt.size == chosen->size && pt.decSpeed > chosen->decSpeed)))
+				chosen = &pt;
+		}
+		if (chosen == nullptr)
+		{
+			chosen = &*std::max_element(points.begin(), points.end(), [](const Point& a, const Point& b) { return a.decSpeed < b.decSpeed; });
+			printf("  WARN: no config decodes at %.2f GB/s, picking the fastest one\n", settings.minDecodeSpeed);
+		}
+
+		std::vector<const Point*> frontier;
+		for (const Point& pt : points)
+		{
+			if (pt.pareto)
+				frontier.push_back(&pt);
+		}
+		std::sort(frontier.begin(), frontier.end(), [](const Point* a, const Point* b) { return a->size < b->size; });
+		printf("  Size vs decode speed Pareto frontier%s:\n", runs > 1 ? " (median of runs)" : "");
+		printf("  %-24s   Ratio   CGB/s   DGB/s\n", "Compressor");
+		for (const Point* pt : frontier)
+		{
+			printf("%c %-24s %7.3f %7.3f %7.3f\n", pt == chosen ? '*' : ' ', pt->name.c_str(), sampleSize / pt->size,
+				sampleSize / BenchCalcStats(pt->cmpTimes).median / oneGB, pt->decSpeed);
+		}
+		printf("  Chosen for %s with decode >= %.2f GB/s: %s (ratio %.3f, decode %.3f GB/s)\n", tf.title, settings.minDecodeSpeed, chosen->name.c_str(),
+			sampleSize / chosen->size, chosen->decSpeed);
+
+		for (const Point& pt : points)
+		{
+			const CompressorConfig& config = *pt.config;
+			BenchResult br;
+			br.order = orderName;
+			br.profile = profileName;
+			br.name = pt.name;
+			br.codec = config.GetCodecName();
+			br.filter = config.IsStreamSplit() ? "auto" : config.filter ? config.filter->name + 1 : "none";
+			br.blockSize = kBlockSizeToActualSize[config.blockSizeEnum];
+			br.threads = config.threadCount;
+			br.level = pt.level;
+			br.fullSize = sample.vertexCount * kFullVertexStride;
+			br.packedSize = sample.fileData.size();
+			br.compressedSize = pt.size;
+			br.cmpTimes = pt.cmpTimes;
+			br.decTimes = pt.decTimes;
+			br.decAllocs = double(pt.decAllocs) / runs;
+			br.decAllocBytes = double(pt.decAllocBytes) / runs;
+			br.tuned = true;
+			br.file = tf.title;
+			br.pareto = pt.pareto;
+			br.chosen = &pt == chosen;
+			outResults.push_back(br);
+		}
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "bench_report.h"
+#include "compressor_config.h"
+
+struct TuneSettings
+{
+	int runs = 1;
+	double minDecodeSpeed = 0; // GB/s
+	size_t sampleSize = 32 * 1024 * 1024; // bytes of packed data measured of each file
+};
+
+// Auto-tune mode: measures each compressor config (and each of its levels) on a sample of each test
+// file, settings.runs times. Prints the compressed size vs decode speed Pareto frontier, and picks the
+// smallest config that decodes at least settings.minDecodeSpeed GB/s on its thread count (or the
+// fastest one, if none does). All measurements go into outResults, marked as tuned.
+void TuneCompressors(std::vector<CompressorConfig>& configs, const TuneSettings& settings, size_t testFileCount, TestFile* testFiles,
+	const char* orderName, const char* profileName, ScratchArenas& arenas, std::vector<BenchResult>& outResults);